@@ -687,6 +687,9 @@ void gather_settings()
 
 	/* Support slash fx */
 	Client_setup.settings[5] = (refresh_char_aux) ? TRUE : FALSE;
+
+	/* Protocol extensions we understand */
+	Client_setup.settings[14] = CAPS_DELTA_ROWS | CAPS_DEFLATE;
 }
 
 
@@ -67,7 +67,7 @@ void cleanup_network_client()
 	first_connection = NULL;
 	e_release_all(first_caller, 0, 1);
 	first_caller = NULL;
-	e_release_all(first_timer, 0, 1);
+	release_timers(first_timer);
 	first_timer = NULL;
 }
 
@@ -77,7 +77,7 @@ void network_loop()
 	//first_listener = handle_listeners(first_listener);
 	first_connection = handle_connections(first_connection);
 	first_caller = handle_callers(first_caller);
-	first_timer = handle_timers(first_timer, static_timer(0));
+	first_timer = handle_timers(first_timer);
 
 	network_pause(1000); /* 0.001 ms "sleep" */
 }
@@ -1331,6 +1331,7 @@ int recv_stream(connection_type *ct) {
 	u16b	cols, y = 0;
 	s16b	*line;
 	byte	addr, id;
+	bool	delta;
 	cave_view_type	*dest;
 
 	stream_type	*stream;
@@ -1351,6 +1352,10 @@ int recv_stream(connection_type *ct) {
 		read_stream_char(id, addr, (stream->flag & SF_TRANSPARENT), !(stream->flag & SF_OVERLAYED),
 		((y >> 8) & 0x007F), (y & 0xFF));
 
+	/* Row-delta, applied on top of what we already have */
+	delta = (y & STREAM_DELTA_ROW) ? TRUE : FALSE;
+	y &= ~STREAM_DELTA_ROW;
+
 	if (verify_stream_y(id, y)) return -1;
 
 	cols = p_ptr->stream_wid[id];
@@ -1360,14 +1365,16 @@ int recv_stream(connection_type *ct) {
 	/* Decode the secondary attr/char stream */
 	if ((stream->flag & SF_TRANSPARENT))
 	{
-		if (cq_scanc(&ct->rbuf, stream->rle, p_ptr->trn_info[y], cols) < cols) return 0;
+		if (delta && cq_scand(&ct->rbuf, p_ptr->trn_info[y], cols) < cols) return 0;
+		if (!delta && cq_scanc(&ct->rbuf, stream->rle, p_ptr->trn_info[y], cols) < cols) return 0;
 	}
 	/* OR clear it ! */ 
 	else if (stream->flag & SF_OVERLAYED)
 		caveclr(p_ptr->trn_info[y], cols);
 
 	/* Decode the attr/char stream */
-	if (cq_scanc(&ct->rbuf, stream->rle, dest, cols) < cols) return 0;
+	if (delta && cq_scand(&ct->rbuf, dest, cols) < cols) return 0;
+	if (!delta && cq_scanc(&ct->rbuf, stream->rle, dest, cols) < cols) return 0;
 
 	/* Check the min/max line count */
 	if ((*line) < y)
@@ -1709,6 +1716,16 @@ int recv_cursor(connection_type *ct) {
 	return 1;
 }
 
+int recv_deflate(connection_type *ct) {
+	/* Server is compressing everything that follows */
+	if (decompress_connection(ct) < 0)
+	{
+		plog("Unable to decompress server output");
+		return -1;
+	}
+	return 1;
+}
+
 int recv_target_info(connection_type *ct) {
 	char buf[MAX_CHARS], *s;
 	byte win, x, y;
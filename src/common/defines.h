@@ -129,6 +129,12 @@
 #define MAX_O_IDX	32768 /* Max size for "o_list[]" */
 #define MAX_M_IDX	32768 /* Max size for "m_list[]" */
 
+/*
+ * Number of "u32b" words in a bit set of N entries (see "vis_has()")
+ */
+#define VIS_SIZE(N)	(((N) + 31) / 32)
+#define MAX_DETECTED	512 /* Max monsters detected by one player at once */
+
 #define MAX_FLVR_IDX	330 /* Max size for flv_x_char[]/attr[] */
 
 /*
@@ -170,6 +176,11 @@
  */
 #define MAX_SPECIAL_LEVELS 10
 
+/*
+ * Number of freed levels kept around for reuse (see "generate.c")
+ */
+#define MAX_LEVEL_POOL	16
+
 /*
  * Maximum size of the "lite" array (see "cave.c")
  * Note that the "lite radius" will NEVER exceed 5, and even if the "lite"
@@ -246,6 +257,18 @@
 #define RLE_LARGE 2
 #define RLE_COLOR 3
 
+/*
+ * Stream line with this bit set in it's row number is a row-delta
+ * (see "cq_printd") against the client's current copy of that row
+ */
+#define STREAM_DELTA_ROW 0x4000
+
+/*
+ * Client capabilities (sent in client setting "14")
+ */
+#define CAPS_DELTA_ROWS 	0x0001	/* Can decode row-delta stream lines */
+#define CAPS_DEFLATE    	0x0002	/* Can inflate compressed stream (PKT_DEFLATE) */
+
 /*
  * Party commands
  */
@@ -53,6 +53,7 @@
 #include <arpa/inet.h>
 
 #include <sys/errno.h>
+#include <sys/uio.h>
 #include <sys/unistd.h>
 #include <sys/time.h>
 #include <sys/fcntl.h>
@@ -61,18 +62,135 @@
 #define closesocket close
 #endif
 
+/* Use epoll(7) for readiness notification, when available */
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#define EPOLL_MAX_EVENTS 256
+#endif
+
+/* Network thread (see "thread_connection"), needs pthreads and GCC atomics */
+#if defined(HAVE_PTHREAD_CREATE) && defined(HAVE_PTHREAD_H) && defined(HAVE_POLL_H) && defined(__GNUC__) && !defined(WINDOWS)
+#define USE_IO_THREAD
+#include <pthread.h>
+#include <poll.h>
+#endif
+
+/* Stream compression (see "compress_connection") */
+#include "../client/lupng/miniz.h"
 
 fd_set rd;
 fd_set wd;
+fd_set rd_all; /* All the sockets we're reading from */
+fd_set wd_all; /* All the sockets we're waiting to write to */
 int nfds;
 int cnfds;
 int lnfds;
 int crfds;
 int refds;
 
-fd_set* get_fd_set() { return &rd; }
+#ifdef USE_EPOLL
+int epfd = -1;
+#endif
+
+/* Connections are also kept in a table, indexed by socket */
+static connection_type **conn_slots = NULL;
+static int conn_slots_max = 0;
+
+/* Timers are kept in a binary min-heap, ordered by deadline */
+static timer_type **timer_heap = NULL;
+static int timer_heap_num = 0;
+static int timer_heap_max = 0;
+
+fd_set* get_fd_set() { return &rd_all; }
 int* get_fd_counter() { return &refds; }
 
+/*
+ * Readiness notification.
+ *
+ * Each watched socket has a "ready" flag, which is raised by "network_pause"
+ * when the socket has something for us. With epoll, the kernel hands us
+ * pointers to those flags directly, so we never scan idle sockets. With
+ * select, the flag is combined with the resulting "rd"/"wd" sets.
+ *
+ * Sockets are always watched for reading, and for writing only when
+ * asked to (see "watch_fd_write").
+ */
+#define NET_READ	0x01
+#define NET_WRITE	0x02
+static void watch_fd(int fd, int *ready)
+{
+	/* Hack -- poke new sockets once, there might be data already */
+	*ready = NET_READ;
+#ifdef USE_EPOLL
+	{
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = ready;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+	}
+#endif
+	FD_SET(fd, &rd_all);
+}
+static void watch_fd_write(int fd, int *ready, bool on)
+{
+#ifdef USE_EPOLL
+	{
+		struct epoll_event ev;
+		ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+		ev.data.ptr = ready;
+		epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+	}
+#endif
+	if (on) FD_SET(fd, &wd_all);
+	else FD_CLR(fd, &wd_all);
+}
+static void unwatch_fd(int fd)
+{
+#ifdef USE_EPOLL
+	{
+		struct epoll_event ev; /* Ignored, but must be non-NULL on old kernels */
+		epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+	}
+#endif
+	FD_CLR(fd, &rd_all);
+	FD_CLR(fd, &wd_all);
+}
+/* Test (and reset) socket readiness for "mode" (NET_READ or NET_WRITE) */
+static int fd_ready(int fd, int *ready, int mode)
+{
+	int was_ready = (*ready & mode);
+	*ready &= ~mode;
+#if defined(USE_EPOLL)
+	return was_ready;
+#elif defined(HAVE_SELECT)
+	return (was_ready || FD_ISSET(fd, (mode == NET_WRITE ? &wd : &rd)));
+#else
+	return 1;
+#endif
+}
+
+/* Write up to two chunks of memory into a socket, with a single call.
+ * Returns number of bytes written or -1 on error. */
+static int sendv(int fd, char *buf1, int len1, char *buf2, int len2)
+{
+#ifdef WINDOWS
+	WSABUF iov[2];
+	DWORD sent = 0;
+	int i = 0;
+	if (len1) { iov[i].buf = buf1; iov[i].len = len1; i++; }
+	if (len2) { iov[i].buf = buf2; iov[i].len = len2; i++; }
+	if (WSASend(fd, iov, i, &sent, 0, NULL, NULL) != 0) return -1;
+	return (int)sent;
+#else
+	struct iovec iov[2];
+	int i = 0;
+	if (len1) { iov[i].iov_base = buf1; iov[i].iov_len = len1; i++; }
+	if (len2) { iov[i].iov_base = buf2; iov[i].iov_len = len2; i++; }
+	return writev(fd, iov, i);
+#endif
+}
+
 struct sender_type {
 	struct sockaddr_in addr;
 	int send_fd;
@@ -212,10 +330,44 @@ eptr add_listener(eptr root, int port, callback cb) {
 	new_l->accept_cb = cb;
 	new_l->listen_fd = listenfd;
 
+	watch_fd(listenfd, &new_l->ready);
+	lnfds = MATH_MAX(listenfd, lnfds);
+
 	/* Add to list */
 	return e_add(root, NULL, new_l);
 }
 
+/* Put connection "ct" into the slot table, growing it as needed */
+static void conn_slot_set(connection_type *ct) {
+	int fd = ct->conn_fd;
+	if (fd >= conn_slots_max) {
+		connection_type **old_slots = conn_slots;
+		int old_max = conn_slots_max;
+		conn_slots_max = MAX(old_max * 2, 64);
+		while (fd >= conn_slots_max) conn_slots_max *= 2;
+		conn_slots = C_ZNEW(conn_slots_max, connection_type*);
+		if (old_slots) {
+			C_COPY(conn_slots, old_slots, old_max, connection_type*);
+			FREE(old_slots);
+		}
+	}
+	conn_slots[fd] = ct;
+}
+
+/* Take connection "ct" out of the slot table, and, if it had the
+ * highest socket, find the next highest one. */
+static void conn_slot_clear(connection_type *ct) {
+	conn_slots[ct->conn_fd] = NULL;
+	if (ct->conn_fd != cnfds) return;
+	while (cnfds > 0 && !conn_slots[cnfds]) cnfds--;
+}
+
+/* Find connection by it's socket */
+connection_type* connection_by_fd(int fd) {
+	if (fd < 0 || fd >= conn_slots_max) return NULL;
+	return conn_slots[fd];
+}
+
 eptr add_connection(eptr root, int fd, callback read, callback close) {
 	struct connection_type *new_c;
 	struct sockaddr_in sin;
@@ -229,7 +381,16 @@ eptr add_connection(eptr root, int fd, callback read, callback close) {
 	new_c->send_cb = NULL;
 	new_c->close_cb = close;
 	new_c->close = 0;
+	new_c->wblock = 0;
+	new_c->cork = new_c->push = 0;
+	new_c->wframe = 0;
+	new_c->whead_len = new_c->whead_pos = 0;
 	new_c->uptr = NULL;
+	new_c->zout = new_c->zin = NULL;
+	new_c->zflush = 0;
+	new_c->z_plain = new_c->z_wire = new_c->z_usec = 0;
+	new_c->wsent = 0;
+	new_c->io = NULL;
 	cq_init(&new_c->wbuf, PD_LARGE_BUFFER);
 	cq_init(&new_c->rbuf, PD_LARGE_BUFFER);
 
@@ -242,12 +403,71 @@ eptr add_connection(eptr root, int fd, callback read, callback close) {
 #endif
 	}
 
+	watch_fd(fd, &new_c->ready);
+	conn_slot_set(new_c);
 	cnfds = MAX(cnfds, new_c->conn_fd);
 
 	/* Add to list */
 	return e_add(root, NULL, new_c);
 }
 
+/* Timer heap helpers */
+static void heap_swap(int a, int b) {
+	timer_type *tmp = timer_heap[a];
+	timer_heap[a] = timer_heap[b];
+	timer_heap[b] = tmp;
+	timer_heap[a]->heap_pos = a;
+	timer_heap[b]->heap_pos = b;
+}
+static void heap_sift_up(int i) {
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (timer_heap[parent]->deadline <= timer_heap[i]->deadline) break;
+		heap_swap(i, parent);
+		i = parent;
+	}
+}
+static void heap_sift_down(int i) {
+	while (1) {
+		int left = i * 2 + 1;
+		int right = left + 1;
+		int least = i;
+		if (left < timer_heap_num
+		 && timer_heap[left]->deadline < timer_heap[least]->deadline) least = left;
+		if (right < timer_heap_num
+		 && timer_heap[right]->deadline < timer_heap[least]->deadline) least = right;
+		if (least == i) break;
+		heap_swap(i, least);
+		i = least;
+	}
+}
+static void heap_push(timer_type *timer) {
+	/* Grow */
+	if (timer_heap_num >= timer_heap_max) {
+		timer_type **old_heap = timer_heap;
+		timer_heap_max = MAX(8, timer_heap_max * 2);
+		timer_heap = C_ZNEW(timer_heap_max, timer_type*);
+		if (old_heap) {
+			C_COPY(timer_heap, old_heap, timer_heap_num, timer_type*);
+			FREE(old_heap);
+		}
+	}
+	timer->heap_pos = timer_heap_num;
+	timer_heap[timer_heap_num++] = timer;
+	heap_sift_up(timer->heap_pos);
+}
+static void heap_remove(timer_type *timer) {
+	int i = timer->heap_pos;
+	timer->heap_pos = -1;
+	timer_heap_num--;
+	if (i != timer_heap_num) {
+		timer_heap[i] = timer_heap[timer_heap_num];
+		timer_heap[i]->heap_pos = i;
+		heap_sift_up(i);
+		heap_sift_down(timer_heap[i]->heap_pos);
+	}
+}
+
 eptr add_timer(eptr root, int interval, callback timeout) {
 	struct timer_type *new_t;
 
@@ -255,41 +475,663 @@ eptr add_timer(eptr root, int interval, callback timeout) {
 	new_t = (struct timer_type*) RNEW(struct timer_type);
 
 	new_t->interval = interval;
-	new_t->delay = interval;
+	new_t->deadline = monotonic_timer() + interval;
 	new_t->timeout_cb = timeout;
+	timer_reset_stats(new_t);
+
+	/* Schedule */
+	heap_push(new_t);
 
 	/* Add to list */
 	return e_add(root, NULL, new_t);
 }
 
+/* Unschedule and delete all timers from "root" */
+void release_timers(eptr root) {
+	eptr next = NULL;
+	for (; root; root = next) {
+		struct timer_type *timer = (struct timer_type *)root->data2;
+		next = root->next;
+		if (timer->heap_pos >= 0) heap_remove(timer);
+		FREE(timer);
+		e_free_aux(root);
+	}
+	/* Nothing is left to fire */
+	if (!timer_heap_num && timer_heap) {
+		KILL(timer_heap);
+		timer_heap_max = 0;
+	}
+}
+
+/* Forget observed lateness of a timer */
+void timer_reset_stats(timer_type *timer) {
+	timer->fired = 0;
+	timer->late_last = 0;
+	timer->late_max = 0;
+	timer->late_total = 0;
+}
+
+/*
+ * Network thread.
+ *
+ * Optionally, sockets of established connections can be handed over to
+ * a separate thread ("thread_connection"), so that a slow game turn does
+ * not delay network I/O, and vice versa. Each such connection gets a pair
+ * of single-producer/single-consumer byte rings: the network thread
+ * receives into "in" and sends from "out", while the game thread moves
+ * data between those and "rbuf"/"wbuf" in "handle_connections". Nothing
+ * else is shared, and the game thread never touches those sockets again.
+ *
+ * Both threads sleep in poll/select, and wake each other with a byte
+ * written to a pipe. A flag makes sure there's at most one such byte
+ * in flight, no matter how much data moves.
+ */
+#ifdef USE_IO_THREAD
+
+#define IO_RING_SIZE	65536	/* Must be a power of two */
+#define IO_CTL_SIZE 	256 	/* Ditto */
+
+/* States of "io_conn" */
+#define IO_OPEN   	0
+#define IO_DEAD   	1	/* Set by network thread: EOF or error */
+#define IO_CLOSING	2	/* Set by game thread: flush, close and forget */
+
+typedef struct io_ring io_ring;
+struct io_ring {
+	char buf[IO_RING_SIZE];
+	unsigned int head; /* Advanced by producer only */
+	unsigned int tail; /* Advanced by consumer only */
+};
+
+typedef struct io_conn io_conn;
+struct io_conn {
+	int fd;
+	int state;
+	int want_space; /* Game thread is waiting for room in "out" */
+	io_ring in;
+	io_ring out;
+};
+
+static pthread_t io_thread;
+static int io_running = 0;
+static int io_quit = 0;
+static int io_wake_thread[2] = { -1, -1 }; /* Game -> network thread */
+static int io_wake_game[2] = { -1, -1 }; /* Network thread -> game */
+static int io_thread_signalled = 0;
+static int io_game_signalled = 0;
+static int io_game_ready = 0;
+
+/* New connections, passed from game thread to network thread */
+static io_conn *io_ctl[IO_CTL_SIZE];
+static unsigned int io_ctl_head = 0;
+static unsigned int io_ctl_tail = 0;
+
+#define IO_LOAD(V) __atomic_load_n(&(V), __ATOMIC_ACQUIRE)
+#define IO_STORE(V, X) __atomic_store_n(&(V), (X), __ATOMIC_RELEASE)
+
+static int ring_len(io_ring *r)
+{
+	return (int)(IO_LOAD(r->head) - IO_LOAD(r->tail));
+}
+static int ring_space(io_ring *r)
+{
+	return IO_RING_SIZE - ring_len(r);
+}
+/* Copy up to "len" bytes into ring (producer side) */
+static int ring_write(io_ring *r, char *src, int len)
+{
+	unsigned int head = r->head;
+	int n = MIN(len, IO_RING_SIZE - (int)(head - IO_LOAD(r->tail)));
+	int off = head & (IO_RING_SIZE - 1);
+	int first = MIN(n, IO_RING_SIZE - off);
+	memcpy(&r->buf[off], src, first);
+	memcpy(r->buf, src + first, n - first);
+	IO_STORE(r->head, head + n);
+	return n;
+}
+/* Copy up to "len" bytes out of ring (consumer side) */
+static int ring_read(io_ring *r, char *dst, int len)
+{
+	unsigned int tail = r->tail;
+	int n = MIN(len, (int)(IO_LOAD(r->head) - tail));
+	int off = tail & (IO_RING_SIZE - 1);
+	int first = MIN(n, IO_RING_SIZE - off);
+	memcpy(dst, &r->buf[off], first);
+	memcpy(dst + first, r->buf, n - first);
+	IO_STORE(r->tail, tail + n);
+	return n;
+}
+
+/* Wake the other thread, unless it was already woken */
+static void io_signal(int *signalled, int fd)
+{
+	char c = 0;
+	if (!__atomic_exchange_n(signalled, 1, __ATOMIC_ACQ_REL))
+	{
+		if (write(fd, &c, 1) < 0) { /* Pipe is full, so it's awake anyway */ }
+	}
+}
+/* Acknowledge wake up (drain the pipe, then allow new signals) */
+static void io_drain(int *signalled, int fd)
+{
+	char buf[64];
+	while (read(fd, buf, sizeof(buf)) > 0) ;
+	IO_STORE(*signalled, 0);
+}
+
+/* Network thread: flush what we can of the output, close and forget */
+static void io_close(io_conn *c)
+{
+	char buf[IO_RING_SIZE];
+	int n = ring_read(&c->out, buf, IO_RING_SIZE);
+	if (n > 0 && send(c->fd, buf, n, 0) < 0) { /* Nobody to tell */ }
+	closesocket(c->fd);
+	FREE(c);
+}
+
+/* Network thread: main loop */
+static void* io_thread_main(void *unused)
+{
+	io_conn **list;
+	struct pollfd *pfd;
+	int num = 0, max = 64;
+	int i, n, wake;
+
+	list = malloc(max * sizeof(io_conn*));
+	pfd = malloc((max + 1) * sizeof(struct pollfd));
+
+	while (!IO_LOAD(io_quit))
+	{
+		/* Pick up new connections */
+		while (io_ctl_tail != IO_LOAD(io_ctl_head))
+		{
+			if (num == max)
+			{
+				max *= 2;
+				list = realloc(list, max * sizeof(io_conn*));
+				pfd = realloc(pfd, (max + 1) * sizeof(struct pollfd));
+			}
+			list[num++] = io_ctl[io_ctl_tail & (IO_CTL_SIZE - 1)];
+			IO_STORE(io_ctl_tail, io_ctl_tail + 1);
+		}
+
+		/* Forget closed connections, and see what the rest are waiting for */
+		pfd[0].fd = io_wake_thread[0];
+		pfd[0].events = POLLIN;
+		for (i = 0; i < num; i++)
+		{
+			io_conn *c = list[i];
+			int state = IO_LOAD(c->state);
+			if (state == IO_CLOSING)
+			{
+				io_close(c);
+				list[i--] = list[--num];
+				continue;
+			}
+			/* Dead ones are ignored until the game thread lets go */
+			pfd[i + 1].fd = (state == IO_OPEN ? c->fd : -1);
+			pfd[i + 1].events = 0;
+			if (state == IO_OPEN && ring_space(&c->in)) pfd[i + 1].events |= POLLIN;
+			if (state == IO_OPEN && ring_len(&c->out)) pfd[i + 1].events |= POLLOUT;
+		}
+
+		poll(pfd, num + 1, -1);
+
+		if (pfd[0].revents) io_drain(&io_thread_signalled, io_wake_thread[0]);
+
+		/* Move data */
+		wake = 0;
+		for (i = 0; i < num; i++)
+		{
+			io_conn *c = list[i];
+			short ev = pfd[i + 1].revents;
+			if (!ev) continue;
+			if ((ev & (POLLIN | POLLHUP | POLLERR)) && (pfd[i + 1].events & POLLIN))
+			{
+				io_ring *r = &c->in;
+				int off = r->head & (IO_RING_SIZE - 1);
+				n = MIN(ring_space(r), IO_RING_SIZE - off);
+				n = recv(c->fd, &r->buf[off], n, 0);
+				if (n > 0) IO_STORE(r->head, r->head + n);
+				else if (n == 0 || sockerr != EWOULDBLOCK)
+				{
+					int open = IO_OPEN;
+					__atomic_compare_exchange_n(&c->state, &open, IO_DEAD, FALSE,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+				}
+				wake = 1;
+			}
+			if (ev & POLLOUT)
+			{
+				io_ring *r = &c->out;
+				int off = r->tail & (IO_RING_SIZE - 1);
+				n = MIN(ring_len(r), IO_RING_SIZE - off);
+				n = send(c->fd, &r->buf[off], n, 0);
+				if (n > 0) IO_STORE(r->tail, r->tail + n);
+				else if (n < 0 && sockerr != EWOULDBLOCK)
+				{
+					int open = IO_OPEN;
+					__atomic_compare_exchange_n(&c->state, &open, IO_DEAD, FALSE,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+					wake = 1;
+				}
+				if (n > 0 && IO_LOAD(c->want_space))
+				{
+					IO_STORE(c->want_space, 0);
+					wake = 1;
+				}
+			}
+		}
+		if (wake) io_signal(&io_game_signalled, io_wake_game[1]);
+	}
+
+	/* Bail out */
+	for (i = 0; i < num; i++) io_close(list[i]);
+	free(list);
+	free(pfd);
+	return NULL;
+}
+
+/* Game thread: receive from the network thread */
+static int io_receive(connection_type *ct)
+{
+	io_conn *c = (io_conn*)ct->io;
+	cq *in = (ct->zin ? &ct->zrbuf : &ct->rbuf);
+	int full = !ring_space(&c->in);
+	int n = ring_read(&c->in, &in->buf[in->len], cq_space(in));
+
+	in->len += n;
+
+	/* Network thread stopped reading, restart it */
+	if (n && full) io_signal(&io_thread_signalled, io_wake_thread[1]);
+
+	/* Got everything there was, and there won't be any more */
+	if (!n && !ring_len(&c->in) && IO_LOAD(c->state) == IO_DEAD) return -1;
+
+	return n;
+}
+
+/* Game thread: send via the network thread. Returns bytes taken, like
+ * "sendv" would (0 if there's no room), or -1 if the peer is gone. */
+static int io_send(connection_type *ct, char *buf1, int len1, char *buf2, int len2)
+{
+	io_conn *c = (io_conn*)ct->io;
+	int n;
+
+	if (IO_LOAD(c->state) != IO_OPEN) return -1;
+
+	/* All or nothing for the header */
+	if (len1 > ring_space(&c->out)) return 0;
+	n = ring_write(&c->out, buf1, len1);
+	n += ring_write(&c->out, buf2, len2);
+
+	if (n) io_signal(&io_thread_signalled, io_wake_thread[1]);
+	return n;
+}
+
+/* Game thread: ask network thread to tell us when there's room to send */
+static void io_want_space(connection_type *ct)
+{
+	io_conn *c = (io_conn*)ct->io;
+	IO_STORE(c->want_space, 1);
+	/* It might have drained the ring already */
+	if (ring_space(&c->out)) io_signal(&io_game_signalled, io_wake_game[1]);
+}
+
+/* Game thread: let go of the connection */
+static void io_release(connection_type *ct)
+{
+	io_conn *c = (io_conn*)ct->io;
+	IO_STORE(c->state, IO_CLOSING);
+	io_signal(&io_thread_signalled, io_wake_thread[1]);
+	ct->io = NULL;
+}
+
+static int io_pipe(int fds[2])
+{
+	if (pipe(fds) < 0) return -1;
+	unblockfd(fds[0]);
+	unblockfd(fds[1]);
+	return 0;
+}
+
+/* Start the network thread. Returns 0 on success, -1 on error. */
+int network_thread_start(void) {
+	if (io_running) return 0;
+	if (io_pipe(io_wake_thread) < 0 || io_pipe(io_wake_game) < 0) return -1;
+	io_quit = 0;
+	if (pthread_create(&io_thread, NULL, io_thread_main, NULL) != 0) return -1;
+	io_running = 1;
+
+	/* Listen for wake ups */
+	watch_fd(io_wake_game[0], &io_game_ready);
+	return 0;
+}
+
+/* Stop the network thread, closing all the connections it handles */
+void network_thread_stop(void) {
+	if (!io_running) return;
+	IO_STORE(io_quit, 1);
+	io_signal(&io_thread_signalled, io_wake_thread[1]);
+	pthread_join(io_thread, NULL);
+	unwatch_fd(io_wake_game[0]);
+	close(io_wake_thread[0]); close(io_wake_thread[1]);
+	close(io_wake_game[0]); close(io_wake_game[1]);
+	io_running = 0;
+}
+
+/* Hand connection's socket over to the network thread.
+ * Returns 0 on success, -1 if there's no network thread. */
+int thread_connection(connection_type *ct) {
+	io_conn *c;
+
+	if (!io_running || ct->io) return -1;
+
+	/* No room in the queue (XXX unlikely, 256 logins in one pass) */
+	if (io_ctl_head - IO_LOAD(io_ctl_tail) >= IO_CTL_SIZE) return -1;
+
+	c = (io_conn*)RNEW(io_conn);
+	c->fd = ct->conn_fd;
+	c->state = IO_OPEN;
+	c->want_space = 0;
+	c->in.head = c->in.tail = 0;
+	c->out.head = c->out.tail = 0;
+
+	/* We're not watching this socket anymore */
+	unwatch_fd(ct->conn_fd);
+	ct->wblock = 0;
+	ct->io = c;
+
+	io_ctl[io_ctl_head & (IO_CTL_SIZE - 1)] = c;
+	IO_STORE(io_ctl_head, io_ctl_head + 1);
+	io_signal(&io_thread_signalled, io_wake_thread[1]);
+	return 0;
+}
+
+#else /* USE_IO_THREAD */
+
+/* No threads, no-ops */
+static int io_receive(connection_type *ct) { return -1; }
+static int io_send(connection_type *ct, char *buf1, int len1, char *buf2, int len2) { return -1; }
+static void io_want_space(connection_type *ct) { }
+static void io_release(connection_type *ct) { }
+int network_thread_start(void) { return -1; }
+void network_thread_stop(void) { }
+int thread_connection(connection_type *ct) { return -1; }
+
+#endif /* USE_IO_THREAD */
+
+/* Write to connection's socket (or the network thread) */
+static int connection_write(connection_type *ct, char *buf1, int len1, char *buf2, int len2)
+{
+	if (ct->io) return io_send(ct, buf1, len1, buf2, len2);
+	return sendv(ct->conn_fd, buf1, len1, buf2, len2);
+}
+
+/* Bytes of output connection "ct" has yet to send */
+static int connection_pending(connection_type *ct)
+{
+	int n = cq_len(&ct->wbuf);
+	if (ct->zout) n += cq_len(&ct->zwbuf) + ct->zflush;
+	return n;
+}
+
+/* Compress pending output of connection "ct" into "zwbuf", ending with
+ * a sync flush, so the peer can inflate everything sent so far without
+ * waiting for more. If "zwbuf" is too small, the rest is left for later.
+ * Returns number of compressed bytes produced, -1 on error. */
+static int connection_deflate(connection_type *ct)
+{
+	mz_streamp zs = (mz_streamp)ct->zout;
+	int in, out, err;
+	s64b start;
+
+	/* Nothing to compress */
+	if (!cq_len(&ct->wbuf) && !ct->zflush) return 0;
+
+	cq_slide(&ct->zwbuf);
+	out = cq_space(&ct->zwbuf);
+	if (out <= 0) return 0;
+	in = cq_len(&ct->wbuf);
+
+	zs->next_in = (unsigned char*)CQ_PEEK(&ct->wbuf);
+	zs->avail_in = in;
+	zs->next_out = (unsigned char*)&ct->zwbuf.buf[ct->zwbuf.len];
+	zs->avail_out = out;
+
+	start = monotonic_timer();
+	err = mz_deflate(zs, MZ_SYNC_FLUSH);
+	ct->z_usec += monotonic_timer() - start;
+
+	/* "MZ_BUF_ERROR" just means there was nothing to do */
+	if (err != MZ_OK && err != MZ_BUF_ERROR) return -1;
+
+	in -= zs->avail_in;
+	out -= zs->avail_out;
+	ct->wbuf.pos += in;
+	ct->wsent += in;
+	if (cq_len(&ct->wbuf)) cq_slide(&ct->wbuf);
+	else CQ_CLEAR(&ct->wbuf);
+	ct->zwbuf.len += out;
+
+	ct->z_plain += in;
+	ct->z_wire += out;
+
+	/* Ran out of room before the flush was complete */
+	ct->zflush = (zs->avail_out == 0 ? 1 : 0);
+
+	return out;
+}
+
+/* Inflate compressed input of connection "ct" into it's read buffer.
+ * Note: this can be called from inside "receive_cb", so the read buffer
+ * is appended to, but never slid.
+ * Returns number of bytes inflated, -1 on error. */
+static int connection_inflate(connection_type *ct)
+{
+	mz_streamp zs = (mz_streamp)ct->zin;
+	int in, out, err;
+	s64b start;
+
+	in = cq_len(&ct->zrbuf);
+	out = cq_space(&ct->rbuf);
+	if (!in || out <= 0) return 0;
+
+	zs->next_in = (unsigned char*)CQ_PEEK(&ct->zrbuf);
+	zs->avail_in = in;
+	zs->next_out = (unsigned char*)&ct->rbuf.buf[ct->rbuf.len];
+	zs->avail_out = out;
+
+	start = monotonic_timer();
+	err = mz_inflate(zs, MZ_SYNC_FLUSH);
+	ct->z_usec += monotonic_timer() - start;
+
+	if (err != MZ_OK && err != MZ_BUF_ERROR) return -1;
+
+	in -= zs->avail_in;
+	out -= zs->avail_out;
+	ct->zrbuf.pos += in;
+	if (cq_len(&ct->zrbuf)) cq_slide(&ct->zrbuf);
+	else CQ_CLEAR(&ct->zrbuf);
+	ct->rbuf.len += out;
+
+	ct->z_plain += out;
+	ct->z_wire += in;
+
+	return out;
+}
+
+/* Release compression state of connection "ct" */
+static void connection_free_z(connection_type *ct)
+{
+	if (ct->zout)
+	{
+		mz_deflateEnd((mz_streamp)ct->zout);
+		FREE(ct->zout);
+		cq_free(&ct->zwbuf);
+	}
+	if (ct->zin)
+	{
+		mz_inflateEnd((mz_streamp)ct->zin);
+		FREE(ct->zin);
+		cq_free(&ct->zrbuf);
+	}
+}
+
+/* Compress and send pending output of connection "ct". Output is deflated
+ * in chunks that fit "zwbuf", so keep going until the socket is full or
+ * there's nothing left.
+ * Returns number of bytes sent, 0 if socket is full, -1 on error. */
+static int connection_send_z(connection_type *ct)
+{
+	int n, sent = 0;
+
+	while (1)
+	{
+		if (connection_deflate(ct) < 0) return -1;
+		if (!cq_len(&ct->zwbuf)) break;
+
+		n = connection_write(ct, NULL, 0, CQ_PEEK(&ct->zwbuf), cq_len(&ct->zwbuf));
+
+		/* Error while sending */
+		if (n < 0) return (sockerr == EWOULDBLOCK ? sent : -1);
+
+		sent += n;
+		ct->zwbuf.pos += n;
+
+		/* Partial write, socket is full */
+		if (cq_len(&ct->zwbuf))
+		{
+			cq_slide(&ct->zwbuf);
+			break;
+		}
+		CQ_CLEAR(&ct->zwbuf);
+	}
+
+	return sent;
+}
+
+/* Send pending output of connection "ct" straight from it's write buffer.
+ * Connection wrappers ("send_cb") are asked to prepare a header for each
+ * new frame, which is then sent along with the frame body.
+ * Returns number of bytes sent, 0 if socket is full, -1 on error. */
+static int connection_send(connection_type *ct)
+{
+	int n, head, body;
+
+	/* Compressed stream */
+	if (ct->zout) return connection_send_z(ct);
+
+	/* Hack -- call connection wrapper (if any) to start a new frame */
+	if (ct->send_cb && !ct->wframe && ct->whead_pos == ct->whead_len)
+	{
+		ct->whead_pos = ct->whead_len = 0;
+		ct->wframe = ct->send_cb(cq_len(&ct->wbuf), ct);
+		if (ct->wframe < 0) return -1;
+	}
+
+	head = ct->whead_len - ct->whead_pos;
+	body = (ct->send_cb ? ct->wframe : cq_len(&ct->wbuf));
+
+	n = connection_write(ct, &ct->whead[ct->whead_pos], head, CQ_PEEK(&ct->wbuf), body);
+
+	/* Error while sending */
+	if (n < 0) return (sockerr == EWOULDBLOCK ? 0 : -1);
+
+	/* Advance past whatever was sent */
+	if (n < head)
+	{
+		ct->whead_pos += n;
+		return n;
+	}
+	ct->whead_pos = ct->whead_len;
+	body = n - head;
+	ct->wbuf.pos += body;
+	ct->wsent += body;
+	if (ct->send_cb) ct->wframe -= body;
+
+	/* Partial write, keep the rest at the start of the buffer */
+	if (cq_len(&ct->wbuf)) cq_slide(&ct->wbuf);
+	else CQ_CLEAR(&ct->wbuf);
+
+	return n;
+}
+
+/* Send as much of pending output as the socket would take, and
+ * watch for writability if some of it is left over. */
+static void connection_flush(connection_type *ct)
+{
+	int n = connection_send(ct);
+
+	/* Error while sending */
+	if (n < 0)
+	{
+		ct->close = 1;
+		return;
+	}
+
+	/* Everything went out */
+	n = connection_pending(ct);
+	if (!n) ct->push = 0;
+
+	/* Socket is full, ask to be notified when it's writable */
+	if (!ct->wblock != !n)
+	{
+		ct->wblock = (n ? 1 : 0);
+		/* Network thread has it's own socket to watch */
+		if (ct->io)
+		{
+			if (ct->wblock) io_want_space(ct);
+		}
+		else watch_fd_write(ct->conn_fd, &ct->ready, ct->wblock);
+	}
+}
+
 eptr handle_connections(eptr root) {
-	char mesg[PD_LARGE_BUFFER];
 	eptr iter;
 	int connfd, n, to_close = 0;
 	struct connection_type *ct;
 
+#ifdef USE_IO_THREAD
+	/* Network thread woke us up, whatever it brought is in the rings */
+	if (io_running && fd_ready(io_wake_game[0], &io_game_ready, NET_READ))
+	{
+		io_drain(&io_game_signalled, io_wake_game[0]);
+	}
+#endif
+
 	for (iter=root; iter; iter=iter->next) {
 		ct = (connection_type*)iter->data2;
 		connfd = ct->conn_fd;
 
-		FD_SET(connfd, &rd);
-
-		/* /Connection is not yet closed/ */
-		if (!ct->close)
+		/* Connection is handled by the network thread */
+		if (ct->io)
+		{
+			if (!ct->close && io_receive(ct) < 0) ct->close = 1;
+		}
+		/* /Connection is not yet closed/ and has something for us */
+		else if (!ct->close && fd_ready(connfd, &ct->ready, NET_READ))
 		{
-			/* Receive */
-			n = PD_LARGE_BUFFER;/* Paranoia */
-			n = MAX(1, MIN(cq_space(&ct->rbuf), PD_LARGE_BUFFER)); /* n = [1=>"bytes left in buffer"=>PD_LARGE_BUFFER] */
-			n = recvfrom(connfd, mesg, n, 0, NULL, 0);
+			/* Receive directly into the read buffer (or the
+			 * compressed one, it will be inflated below) */
+			cq *in = (ct->zin ? &ct->zrbuf : &ct->rbuf);
+			n = cq_space(in);
 			if (n > 0)
 			{
+				n = recvfrom(connfd, &in->buf[in->len], n, 0, NULL, 0);
 				/* Got 'n' bytes */
-				n = cq_nwrite(&ct->rbuf, mesg, n);
-				/* Error while filling buffer */
-				if (n <= 0) ct->close = 1;
+				if (n > 0) in->len += n;
+				/* Error while receiving */
+				else if (n == 0 || sockerr != EWOULDBLOCK) ct->close = 1;
 			}
-			/* Error while receiving */
-			else if (n == 0 || sockerr != EWOULDBLOCK) ct->close = 1;
+			/* Error while filling buffer (compressed input simply
+			 * waits until there's room to inflate it) */
+			else if (!ct->zin) ct->close = 1;
+		}
+		/* Inflate compressed input */
+		if (!ct->close && ct->zin && connection_inflate(ct) < 0)
+		{
+			ct->close = 1;
 		}
 		/* Handle input */
 		if (!ct->close && cq_len(&ct->rbuf))
@@ -298,52 +1140,43 @@ eptr handle_connections(eptr root) {
 			/* Error while handling input */
 			if (n < 0) ct->close = 1;
 		}
-		/* Send */
-		if (cq_len(&ct->wbuf))
+		/* Send (unless corked or waiting for socket to become writable) */
+		if (connection_pending(ct) && (!ct->cork || ct->push || ct->close)
+		 && (!ct->wblock || ct->io || fd_ready(connfd, &ct->ready, NET_WRITE)))
 		{
-			/* Hack -- call connection wrapper (if any) */
-			if (ct->send_cb)
-			{
-				/* It's job is to fill the "mesg" buffer, instead of
-				 * doing a simple "cq_read" below. */
-				void *old_ptr = ct->uptr;
-				ct->uptr = &mesg[0];
-				n = ct->send_cb(0, ct);
-				ct->uptr = old_ptr;
-			} else
-
-			n = cq_read(&ct->wbuf, &mesg[0], PD_LARGE_BUFFER);
-			n = sendto(connfd,mesg,n,0, NULL,0);
-
-			/* Error while sending */
-			if (n <= 0) ct->close = 1;
+			connection_flush(ct);
 		}
 
 		/* Done for? */
 		to_close += ct->close;
 	}
+	/* Close them all in one pass, unlinking each node via it's predecessor */
 	if (to_close) {
-		while (to_close) {
-			for (iter=root; iter; iter=iter->next) {
-				ct = (connection_type*)iter->data2;
-				if (ct->close)
-				{
-					closesocket(ct->conn_fd);
-					FD_CLR(ct->conn_fd, &rd);
-					ct->close_cb(0, ct);
-					cq_free(&ct->rbuf);
-					cq_free(&ct->wbuf);
-					FREE(ct);
-					e_del(&root, iter);
-					to_close--;
-					break;
-				}
-			}
-		}
-		cnfds = 0;
-		for (iter=root; iter; iter=iter->next) {
+		eptr prev = NULL, next;
+		for (iter=root; iter && to_close; iter=next) {
+			next = iter->next;
 			ct = (connection_type*)iter->data2;
-			cnfds = MATH_MAX(cnfds, ct->conn_fd);
+			if (!ct->close)
+			{
+				prev = iter;
+				continue;
+			}
+			conn_slot_clear(ct);
+			if (ct->io) io_release(ct);
+			else
+			{
+				unwatch_fd(ct->conn_fd);
+				closesocket(ct->conn_fd);
+			}
+			ct->close_cb(0, ct);
+			cq_free(&ct->rbuf);
+			cq_free(&ct->wbuf);
+			connection_free_z(ct);
+			FREE(ct);
+			if (prev) prev->next = next;
+			else root = next;
+			e_free_aux(iter);
+			to_close--;
 		}
 	}
 	/*nfds = MATH_MAX(lnfds, cnfds);*/
@@ -364,7 +1197,7 @@ eptr handle_callers(eptr root) {
 			//this is a good place to check if socket is connected
 		} */
 
-		FD_SET(callerfd, &wd);
+		FD_SET(callerfd, &wd_all);
 		n = connect(callerfd, (struct sockaddr *)&ct->addr, sizeof(ct->addr));
 		err = sockerr;
 		#ifdef WINDOWS
@@ -398,7 +1231,7 @@ eptr handle_callers(eptr root) {
 				struct caller_type *ct = (struct caller_type *)iter->data2;
 				if (ct->remove)
 				{
-					FD_CLR(ct->caller_fd, &wd);
+					FD_CLR(ct->caller_fd, &wd_all);
 					FREE(ct);
 					e_del(&root, iter);
 					to_remove--;
@@ -427,8 +1260,8 @@ eptr handle_listeners(eptr root) {
 		struct listener_type *lt = (struct listener_type *)iter->data2;
 		int listenfd = lt->listen_fd;	
 
-		FD_SET (listenfd, &rd);
-		lnfds = MATH_MAX(listenfd, lnfds);
+		/* Nobody knocked */
+		if (!fd_ready(listenfd, &lt->ready, NET_READ)) continue;
 
 		connfd = accept(listenfd,(struct sockaddr *)&cliaddr,&clilen);
 		if (connfd == -1) continue;
@@ -477,6 +1310,122 @@ micro static_timer(int id) {
 	return passed;
 }
 
+/* Returns microseconds from an arbitrary starting point. Unlike the
+ * "static_timer", it is not affected by system clock adjustments. */
+s64b monotonic_timer(void) {
+#if defined(WINDOWS)
+	LARGE_INTEGER PerformanceCount, Frequency;
+	QueryPerformanceFrequency(&Frequency);
+	QueryPerformanceCounter(&PerformanceCount);
+	return (PerformanceCount.QuadPart / Frequency.QuadPart) * 1000000
+		+ (PerformanceCount.QuadPart % Frequency.QuadPart) * 1000000 / Frequency.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (s64b)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (s64b)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+/* Returns microseconds left until the earliest timer is due,
+ * but no more than "max_delay". Use it to sleep in "network_pause". */
+micro timers_delay(micro max_delay) {
+	s64b delay;
+	if (!timer_heap_num) return max_delay;
+	delay = timer_heap[0]->deadline - monotonic_timer();
+	if (delay > max_delay) return max_delay;
+	return (micro)MAX(0, delay);
+}
+
+/* Returns TRUE if any of the connections has bytes waiting to be sent */
+int connections_pending(eptr root) {
+	eptr iter;
+	for (iter=root; iter; iter=iter->next) {
+		connection_type *ct = (connection_type*)iter->data2;
+		if (ct->close) return 1;
+		if (connection_pending(ct) && !ct->wblock && (!ct->cork || ct->push)) return 1;
+	}
+	return 0;
+}
+
+/* Send everything corked connections have accumulated so far.
+ * Call this once per game tick, so each client gets a single write. */
+void flush_connections(eptr root) {
+	eptr iter;
+	for (iter=root; iter; iter=iter->next) {
+		connection_type *ct = (connection_type*)iter->data2;
+		if (!ct->cork || !connection_pending(ct) || ct->close) continue;
+		/* Socket is full, send it when it becomes writable */
+		if (ct->wblock) ct->push = 1;
+		else connection_flush(ct);
+	}
+}
+
+/* Send output of connection "ct" on the next network pass, without
+ * waiting for the end of tick. Use for latency-sensitive packets.
+ * Note: whatever was queued before goes out too, to keep the order. */
+void push_connection(connection_type *ct) {
+	if (ct->cork) ct->push = 1;
+}
+
+/* Start compressing output of connection "ct" with deflate "level".
+ * Whatever was queued up to this point is sent as is, so the last thing
+ * queued should tell the peer to "decompress_connection" after it.
+ * Each send ends with a sync flush, corked connections (see above) thus
+ * produce one flush per tick.
+ * Returns 0 on success, -1 on error. */
+int compress_connection(connection_type *ct, int level) {
+	mz_streamp zs;
+
+	/* Doesn't mix with connection wrappers */
+	if (ct->zout || ct->send_cb) return -1;
+
+	zs = RNEW(mz_stream);
+	WIPE(zs, mz_stream);
+	if (mz_deflateInit(zs, level) != MZ_OK)
+	{
+		FREE(zs);
+		return -1;
+	}
+	ct->zout = zs;
+	ct->zflush = 0;
+	cq_init(&ct->zwbuf, PD_LARGE_BUFFER);
+
+	/* Queued output goes out uncompressed */
+	ct->wsent += cq_len(&ct->wbuf);
+	cq_copyn(&ct->wbuf, cq_len(&ct->wbuf), &ct->zwbuf);
+	CQ_CLEAR(&ct->wbuf);
+
+	return 0;
+}
+
+/* Start inflating input of connection "ct". Call this from "receive_cb",
+ * everything past the current read position is considered compressed.
+ * Returns number of bytes inflated so far, -1 on error. */
+int decompress_connection(connection_type *ct) {
+	mz_streamp zs;
+
+	if (ct->zin) return -1;
+
+	zs = RNEW(mz_stream);
+	WIPE(zs, mz_stream);
+	if (mz_inflateInit(zs) != MZ_OK)
+	{
+		FREE(zs);
+		return -1;
+	}
+	ct->zin = zs;
+	cq_init(&ct->zrbuf, PD_LARGE_BUFFER);
+
+	/* Move the rest of the read buffer aside */
+	cq_copyn(&ct->rbuf, cq_len(&ct->rbuf), &ct->zrbuf);
+
+	return connection_inflate(ct);
+}
+
 eptr handle_senders(eptr root, micro microsec) {
 	eptr iter;
 	int n, to_close = 0;
@@ -525,33 +1474,48 @@ eptr handle_senders(eptr root, micro microsec) {
 	return root;
 }
 
-eptr handle_timers(eptr root, micro microsec) {
-	eptr iter;
+/* Fire all the timers which are due. Timer callbacks receive their
+ * lateness (in microseconds) as "data1". */
+eptr handle_timers(eptr root) {
+	eptr iter, next, *link;
 	int n, to_close = 0;
-	for (iter=root; iter; iter=iter->next) {
-		struct timer_type *timer = (struct timer_type *)iter->data2;
-		timer->delay -= microsec;
-		while (timer->delay <= 0) {
-			timer->delay += timer->interval;
-			n = timer->timeout_cb((int)(microsec / 1000000), timer);
-			if (!n) {
-				timer->interval = 0;
-				to_close++;
-			} else if (n != 2) 
-				timer->delay = timer->interval;
+	s64b now = monotonic_timer();
+
+	while (timer_heap_num && timer_heap[0]->deadline <= now) {
+		struct timer_type *timer = timer_heap[0];
+		micro late = (micro)(now - timer->deadline);
+
+		/* Track jitter */
+		timer->fired++;
+		timer->late_last = late;
+		timer->late_total += late;
+		if (late > timer->late_max) timer->late_max = late;
+
+		n = timer->timeout_cb((int)late, timer);
+		if (!n) {
+			/* One-shot */
+			heap_remove(timer);
+			timer->interval = 0;
+			to_close++;
+			continue;
 		}
+		/* Smooth timers catch up with missed deadlines, others restart */
+		if (n == 2) timer->deadline += timer->interval;
+		else timer->deadline = now + timer->interval;
+		heap_sift_down(timer->heap_pos);
 	}
-	while (to_close) {
-		for (iter=root; iter; iter=iter->next) {
-			struct timer_type *timer = (struct timer_type *)iter->data2;
-			if (!timer->interval)
-			{
-				FREE(timer);
-				e_del(&root, iter);
-				to_close--;
-				break;
-			}
+
+	/* Remove finished timers in a single pass */
+	for (link = &root, iter = root; to_close && iter; iter = next) {
+		struct timer_type *timer = (struct timer_type *)iter->data2;
+		next = iter->next;
+		if (!timer->interval) {
+			*link = next;
+			FREE(timer);
+			e_free_aux(iter);
+			to_close--;
 		}
+		else link = &iter->next;
 	}
 	return root;
 }
@@ -566,7 +1530,20 @@ void network_reset() {
 
 	FD_ZERO (&rd);
 	FD_ZERO (&wd);
+	FD_ZERO (&rd_all);
+	FD_ZERO (&wd_all);
 	nfds = cnfds = lnfds = crfds = refds = 0;
+
+	/* Forget all connections */
+	if (conn_slots) C_WIPE(conn_slots, conn_slots_max, connection_type*);
+
+	/* Forget all timers (they were released along with their lists) */
+	timer_heap_num = 0;
+
+#ifdef USE_EPOLL
+	if (epfd != -1) close(epfd);
+	epfd = epoll_create(EPOLL_MAX_EVENTS); /* Size is only a hint */
+#endif
 }
 
 void network_done() {
@@ -575,8 +1552,35 @@ void network_done() {
 #endif
 }
 
+/* Sleep for up to "timeout" microseconds, or until any of the
+ * watched sockets becomes readable. */
 void network_pause(micro timeout) {
-#ifndef HAVE_SELECT
+#if defined(USE_EPOLL)
+	struct epoll_event events[EPOLL_MAX_EVENTS];
+	struct timeval tv = { 0, 0 };
+	fd_set ep;
+	int i, n;
+
+	/* Hack -- epoll_wait() only has millisecond precision, which is too
+	 * coarse for timer deadlines. So we sleep in select() on the epoll
+	 * descriptor itself, and then collect the events without waiting. */
+	if (timeout > 0)
+	{
+		TV_SET(tv, timeout);
+		FD_ZERO(&ep);
+		FD_SET(epfd, &ep);
+		select(epfd + 1, &ep, NULL, NULL, &tv);
+	}
+	n = epoll_wait(epfd, events, EPOLL_MAX_EVENTS, 0);
+
+	/* Raise "ready" flags */
+	for (i = 0; i < n; i++)
+	{
+		int *ready = (int*)events[i].data.ptr;
+		if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) *ready |= NET_READ;
+		if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) *ready |= NET_WRITE;
+	}
+#elif !defined(HAVE_SELECT)
 	usleep(timeout);
 #else
 	struct timeval tv = { 0, 0 };
@@ -586,6 +1590,12 @@ void network_pause(micro timeout) {
 	nfds = MATH_MAX(lnfds, cnfds);
 	nfds = MATH_MAX(nfds, crfds);
 	nfds = MATH_MAX(nfds, refds);
+#ifdef USE_IO_THREAD
+	if (io_running) nfds = MATH_MAX(nfds, io_wake_game[0]);
+#endif
+
+	rd = rd_all;
+	wd = wd_all;
 
 	select(nfds + 1, &rd, &wd, NULL, &tv);
 #endif
@@ -3,7 +3,7 @@
 
 #define TV_SEC(A) (A / 1000000)
 #define TV_MSEC(A) (A / 1000)
-#define TV_SET(A,B) {A.tv_sec = 0;A.tv_usec=B;}
+#define TV_SET(A,B) {A.tv_sec = TV_SEC(B);A.tv_usec=(B) % 1000000;}
 
 /* struct sender_type -- see imps.c */
 /* struct caller_type -- see imps.c */
@@ -13,25 +13,51 @@ typedef struct timer_type timer_type;
 struct listener_type {
 	int port;
 	int listen_fd;	
+	int ready; /* Set by "network_pause" when there's something to accept */
 	callback accept_cb;
 };
 struct connection_type {
 	int conn_fd;
 	callback receive_cb; /* return -1 if you disliked his input */
-	callback send_cb; /* Unused, unless using connection wrappers */
+	callback send_cb; /* Unused, unless using connection wrappers; fills "whead" */
 	callback close_cb;
 	int close;
+	int ready; /* Set by "network_pause" when socket is readable/writable */
+	int wblock; /* Socket is full, waiting for it to become writable */
+	int cork; /* Hold output until "flush_connections" */
+	int push; /* Send held output as soon as possible (despite the cork) */
+	int wframe; /* Bytes of "wbuf" covered by current "send_cb" frame */
+	char whead[16]; /* Current frame header, prepared by "send_cb" */
+	int whead_len;
+	int whead_pos;
 	char host_addr[24];
 	cq rbuf;
 	cq wbuf;
 	int user; /* User-defined data, unused by us */
 	data uptr;
 	cq wsrbuf; /* Unused, additional read buffer for connection wrapping */
+	s64b wsent; /* Bytes taken out of "wbuf" so far (sent or compressed) */
+	data io; /* Network thread's side of the connection, if any */
+	data zout; /* Deflate stream, if output is compressed */
+	data zin; /* Inflate stream, if input is compressed */
+	int zflush; /* Deflate ran out of room mid-flush, more output pending */
+	cq zwbuf; /* Compressed output, waiting to be sent */
+	cq zrbuf; /* Compressed input, waiting to be inflated */
+	/* Compression statistics */
+	s64b z_plain; /* Bytes before compression */
+	s64b z_wire; /* Bytes after compression */
+	s64b z_usec; /* Time spent compressing, in microseconds */
 };
 struct timer_type {
 	micro interval;
-	micro delay;
+	s64b deadline; /* Absolute time, see "monotonic_timer()" */
+	int heap_pos; /* Index in the timer heap, -1 if not scheduled */
 	callback timeout_cb; /* return 1 for infinite, 0 for one-shot, 2 for smooth */
+	/* Observed lateness (jitter), in microseconds */
+	u32b fired;
+	micro late_last;
+	micro late_max;
+	s64b late_total;
 };
 
 extern eptr add_sender(eptr root, char *host, int port, micro interval, callback send_cb);
@@ -39,13 +65,26 @@ extern eptr add_caller(eptr root, char *addr, int port, callback conn_cb, callba
 extern eptr add_listener(eptr root, int port, callback cb);
 extern eptr add_timer(eptr root, int interval, callback timeout);
 extern eptr add_connection(eptr root, int fd, callback read, callback close);
+extern connection_type* connection_by_fd(int fd);
 
 extern eptr handle_senders(eptr root, micro microsec);
 extern eptr handle_listeners(eptr root);
 extern eptr handle_connections(eptr root);
 extern eptr handle_callers(eptr root);
-extern eptr handle_timers(eptr root, long microsec);
+extern eptr handle_timers(eptr root);
 extern micro static_timer(int id);
+extern s64b monotonic_timer(void);
+extern micro timers_delay(micro max_delay);
+extern void timer_reset_stats(timer_type *timer);
+extern void release_timers(eptr root);
+extern  int connections_pending(eptr root);
+extern void flush_connections(eptr root);
+extern void push_connection(connection_type *ct);
+extern  int compress_connection(connection_type *ct, int level);
+extern  int decompress_connection(connection_type *ct);
+extern  int thread_connection(connection_type *ct);
+extern  int network_thread_start(void);
+extern void network_thread_stop(void);
 
 extern void network_reset(void);
 extern void network_pause(long timeout);
@@ -14,28 +14,6 @@
  */
 #include "angband.h"
 
-#define PACK_PTR_8(PT, VAL) \
- * PT ++ = VAL
-#define PACK_PTR_16(PT, VAL) \
- * PT ++ = (char)(VAL >> 8), \
- * PT ++ = (char)VAL
-#define PACK_PTR_32(PT, VAL) \
- * PT ++ = (char)(VAL >> 24),\
- * PT ++ = (char)(VAL >> 16),\
- * PT ++ = (char)(VAL >> 8), \
- * PT ++ = (char)VAL
-#define PACK_PTR_64(PT, VAL) \
- * PT ++ = (char)(VAL >> 56),\
- * PT ++ = (char)(VAL >> 48),\
- * PT ++ = (char)(VAL >> 40),\
- * PT ++ = (char)(VAL >> 32),\
- * PT ++ = (char)(VAL >> 24),\
- * PT ++ = (char)(VAL >> 16),\
- * PT ++ = (char)(VAL >> 8), \
- * PT ++ = (char)VAL
-#define PACK_PTR_STR(PT, VAL) while ((* PT ++ = * VAL ++) != '\0')
-#define PACK_PTR_NSTR(PT, VAL, SIZE) while (SIZE--) { * PT ++ = * VAL ++ ; }
-
 #define UNPACK_PTR_8(PT, VAL) \
  * PT = * VAL ++
 #define UNPACK_PTR_16(PT, VAL)   \
@@ -572,6 +550,63 @@ int cq_copyf(cq *src, const char *str, cq *dst) {
 	return found;
 }
 
+/* "Compile" a packet scheme. If it consists only of fixed-width
+ * fields, return it's total size in bytes, so it can be copied with
+ * "cq_copyn" instead of "cq_copyf". Otherwise, return -1. */
+int cq_scheme_size(const char *str) {
+	int size = 0;
+
+	if (!str) return 0;
+
+	while (*str++ == '%') {
+		switch(*str++) {
+			case 'b':
+			case 'c': size += 1; break;
+			case 'd': size += 2; break;
+			case 'l': size += 4; break;
+			case 'u': {/* unsigned */
+				switch (*str++) {
+					case 'c': size += 1; break;
+					case 'd': size += 2; break;
+					case 'l': size += 4; break;
+					default: return -1;
+				}
+				break;}
+			default: return -1;
+		}
+	}
+
+	return size;
+}
+
+/* Copy exactly "len" bytes from "src" to "dst", with a single bounds
+ * check. Returns 1 on success, -1 if either buffer is short. */
+int cq_copyn(cq *src, int len, cq *dst) {
+	if (src->pos + len > src->len) { src->err = dst->err = 3; return -1; }
+	if (dst->len + len > dst->max) { src->err = dst->err = 4; return -1; }
+
+	memcpy(&dst->buf[dst->len], &src->buf[src->pos], len);
+	src->pos += len;
+	dst->len += len;
+
+	return 1;
+}
+
+/* Make sure "size" more bytes fit into "charq", and return pointer
+ * to write them to. Returns NULL if there's no space. */
+char* cq_reserve(cq *charq, int size) {
+	if (charq->len + size > charq->max) {
+		charq->err = 2;
+		return NULL;
+	}
+	return &charq->buf[charq->len];
+}
+
+/* Account for bytes written after "cq_reserve", up to "end" */
+void cq_commit(cq *charq, char *end) {
+	charq->len = end - charq->buf;
+}
+
 #define PW_ERROR_SIZE(SIZE) if (WPTRN + SIZE > WENDN) { dst->err = 2; return 0; }
 #define PR_ERROR_SIZE(SIZE) if (RPTRN + SIZE > RENDN) { src->err = 2; return 0; }
 
@@ -1034,6 +1069,92 @@ int cq_scanac(cq *charq, unsigned int mode, byte *a, char *c, int len) {
 	return n;
 }
 
+/*
+ * Row-delta. Encodes "len" grids of "from" as a difference against
+ * "old", the copy client already has. Row is sent as pairs of "skip"
+ * (unchanged grids) and "count" (changed grids) bytes, each pair
+ * followed by "count" attr/char pairs.
+ */
+int cq_printd(cq *charq, cave_view_type *from, cave_view_type *old, int len) {
+	int i, x = 0, skip, count, bytes = 0;
+	PACK_DEF
+	PACK_INIT(charq);
+	while (x < len)
+	{
+		/* Count unchanged grids */
+		for (skip = 0; x + skip < len && skip < 255; skip++)
+		{
+			if (from[x + skip].a != old[x + skip].a
+			 || from[x + skip].c != old[x + skip].c) break;
+		}
+		x += skip;
+
+		/* Count changed grids */
+		for (count = 0; x + count < len && count < 255; count++)
+		{
+			if (from[x + count].a == old[x + count].a
+			 && from[x + count].c == old[x + count].c) break;
+		}
+
+		/* Output the info */
+		if (WPTRN + 2 + count * 2 > WENDN)
+		{
+			charq->err = 2;
+			return 0;
+		}
+		PACK_8((byte)skip);
+		PACK_8((byte)count);
+		for (i = 0; i < count; i++)
+		{
+			PACK_8(from[x + i].a);
+			PACK_8(from[x + i].c);
+		}
+		x += count;
+	}
+	PACK_FIN_R(charq, bytes);
+	return bytes;
+}
+
+/* Decode row-delta "in place", on top of what "to" already has.
+ * Pass "NULL" as "to" to discard the result. */
+int cq_scand(cq *charq, cave_view_type *to, int len) {
+	int i, x = 0;
+	UNPACK_DEF
+	UNPACK_INIT(charq);
+	while (x < len)
+	{
+		byte skip, count;
+		byte a;
+		char c;
+
+		if (RPTRN + 2 > RENDN) { charq->err = 2; return 0; }
+		UNPACK_8(&skip);
+		UNPACK_8(&count);
+
+		/* Is it even legal? */
+		if ((!skip && !count) || x + skip + count > len)
+		{
+			charq->err = 9;
+			return 0;
+		}
+		x += skip;
+
+		if (RPTRN + count * 2 > RENDN) { charq->err = 2; return 0; }
+		for (i = 0; i < count; i++, x++)
+		{
+			UNPACK_8(&a);
+			UNPACK_8(&c);
+			if (to)
+			{
+				to[x].a = a;
+				to[x].c = c;
+			}
+		}
+	}
+	UNPACK_FIN(charq);
+	return len;
+}
+
 const char* cq_error(cq *charq) {
 	if (charq->err == 0) return "";
 	if (charq->err < MAX_CQ_ERRORS) {
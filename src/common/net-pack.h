@@ -1,13 +1,45 @@
 #ifndef __NET_PACK_H_
 #define __NET_PACK_H_
 
+/* Straight-line packing, for the hottest packets. Reserve space
+ * with "cq_reserve", store fields with PACK_PTR_* macros and call
+ * "cq_commit" with the final pointer. */
+#define PACK_PTR_8(PT, VAL) \
+ * PT ++ = VAL
+#define PACK_PTR_16(PT, VAL) \
+ * PT ++ = (char)(VAL >> 8), \
+ * PT ++ = (char)VAL
+#define PACK_PTR_32(PT, VAL) \
+ * PT ++ = (char)(VAL >> 24),\
+ * PT ++ = (char)(VAL >> 16),\
+ * PT ++ = (char)(VAL >> 8), \
+ * PT ++ = (char)VAL
+#define PACK_PTR_64(PT, VAL) \
+ * PT ++ = (char)(VAL >> 56),\
+ * PT ++ = (char)(VAL >> 48),\
+ * PT ++ = (char)(VAL >> 40),\
+ * PT ++ = (char)(VAL >> 32),\
+ * PT ++ = (char)(VAL >> 24),\
+ * PT ++ = (char)(VAL >> 16),\
+ * PT ++ = (char)(VAL >> 8), \
+ * PT ++ = (char)VAL
+#define PACK_PTR_STR(PT, VAL) while ((* PT ++ = * VAL ++) != '\0')
+#define PACK_PTR_NSTR(PT, VAL, SIZE) while (SIZE--) { * PT ++ = * VAL ++ ; }
+
+extern char* cq_reserve(cq *charq, int size);
+extern void cq_commit(cq *charq, char *end);
+
 extern int cq_printf(cq *charq, char *str, ...);
 extern int cq_copyf(cq *src, const char *str, cq *dst);
+extern int cq_scheme_size(const char *str);
+extern int cq_copyn(cq *src, int len, cq *dst);
 extern int cq_scanf(cq *charq, char *str, ...);
 extern int cq_printc(cq *charq, unsigned int mode, cave_view_type *from, int len);
 extern int cq_scanc(cq *charq, unsigned int mode, cave_view_type *to, int len);
 extern int cq_printac(cq *charq, unsigned int mode, byte *a, char *c, int len);
 extern int cq_scanac(cq *charq, unsigned int mode, byte *a, char *c, int len);
+extern int cq_printd(cq *charq, cave_view_type *from, cave_view_type *old, int len);
+extern int cq_scand(cq *charq, cave_view_type *to, int len);
 extern const char* cq_error(cq *charq);
 extern bool cq_fatal(cq *charq);
 
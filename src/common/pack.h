@@ -95,6 +95,7 @@
 /* Packet type 150 are hacks */
 #define PKT_FLUSH       	150
 #define PKT_CURSOR      	151
+#define PKT_DEFLATE     	152 /* Everything past this packet is compressed */
 
 /* Extra packets */
 #define PKT_OBSERVE     	160
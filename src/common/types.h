@@ -47,6 +47,8 @@
 /**** MAngband specific structs ****/
 
 typedef struct cave_type cave_type;
+typedef struct flow_type flow_type;
+typedef struct wall_type wall_type;
 typedef struct server_setup_t server_setup_t;
 typedef struct client_setup_t client_setup_t;
 typedef struct option_type option_type;
@@ -79,8 +81,8 @@ typedef struct item_tester_type item_tester_type;
  * (if any) with the grid, but takes a lot of memory.  Several other
  * methods come to mind, but they all seem rather complicated.
  *
- * Note the special fields for the simple "monster flow" code,
- * and for the "tracking" code.
+ * Note that the "monster flow" information is kept per level in
+ * a separate "flow_type" (see below), not in every grid.
  */
 
 struct cave_type
@@ -93,14 +95,40 @@ struct cave_type
 
 	s16b m_idx;		/* Monster index (in m_list) or zero */
 				/* or negative if a player */
+};
 
-#ifdef MONSTER_FLOW
+/*
+ * A row of a level.  Each level is a single block of MAX_HGT rows.
+ */
+typedef cave_type cave_row[MAX_WID];
 
-	byte cost;		/* Hack -- cost of flowing */
-	byte when;		/* Hack -- when cost was computed */
 
-#endif
+/*
+ * Monster "flow" information for a single level.
+ *
+ * Each grid holds the number of steps to the nearest player on the
+ * level, or FLOW_NONE if no player is within MONSTER_FLOW_DEPTH steps.  This
+ * lets monsters walk around walls with a simple gradient lookup.
+ */
+struct flow_type
+{
+	byte cost[MAX_HGT][MAX_WID];	/* Steps to the nearest player */
 
+	s16b sources;		/* Number of players flowed from */
+	hturn turn;		/* Turn the costs were computed */
+	bool stale;		/* The costs need recomputing */
+};
+
+
+/*
+ * Packed copy of which grids of a level block sight and projections
+ * (those which are not "cave_floor_bold()"), one bit per grid, so that
+ * "los()" and "projectable()" need a single bit test per grid.
+ */
+struct wall_type
+{
+	u32b bits[MAX_HGT][VIS_SIZE(MAX_WID)];
+	bool arena;		/* The level has arena walls */
 };
 
 
@@ -347,6 +375,7 @@ typedef struct player_class player_class;
 typedef struct hist_type hist_type;
 typedef struct player_other player_other;
 typedef struct player_type player_type;
+typedef struct packet_stat packet_stat;
 typedef struct start_item start_item;
 typedef struct flavor_type flavor_type;
 
@@ -1178,6 +1207,17 @@ struct player_other
 };
 
 
+/*
+ * Traffic and time spent on one packet type
+ */
+struct packet_stat
+{
+	u32b count;	/* Packets */
+	s64b bytes;	/* Bytes */
+	s64b usec;	/* Time spent handling them, in microseconds */
+};
+
+
 /*
  * Most of the "player" information goes here.
  *
@@ -1211,6 +1251,13 @@ struct player_type
 	int afk_seconds; /* Number of seconds since last game command */
 	cq cbuf;	/* Command Queue */
 
+	/* Traffic accounting, per packet type (see "count_packet") */
+	packet_stat pkt_in[256];	/* Received ("handlers") */
+	packet_stat pkt_cmd[256];	/* Executed ("pcommands") */
+	packet_stat pkt_out[256];	/* Sent */
+	byte pkt_out_last;	/* Packet being queued */
+	s64b pkt_out_mark;	/* Output total when it was started */
+
 	s32b id;		/* Unique ID to each player */
 
 	hostile_type *hostile;	/* List of players we wish to attack */
@@ -1220,6 +1267,7 @@ struct player_type
 
 	int infodata_sent[6];
 	bool supports_slash_fx;
+	u16b client_caps;	/* CAPS_* flags */
 
 	bool alive;		/* Are we alive */
 	bool death;		/* Have we died */
@@ -1348,16 +1396,22 @@ struct player_type
 
 	byte cave_flag[MAX_HGT][MAX_WID]; /* Can the player see this grid? */
 
-	bool mon_hrt[MAX_M_IDX]; /* Have this player hurt these monsters? */
+	/* Note that these are bit sets, see "vis_has()" */
+	u32b mon_hrt[VIS_SIZE(MAX_M_IDX)]; /* Have this player hurt these monsters? */
 
-	bool mon_vis[MAX_M_IDX];  /* Can this player see these monsters? */
-	bool mon_los[MAX_M_IDX];
-	byte mon_det[MAX_M_IDX]; /* Were these monsters detected by this player? */
+	u32b mon_vis[VIS_SIZE(MAX_M_IDX)];  /* Can this player see these monsters? */
+	u32b mon_los[VIS_SIZE(MAX_M_IDX)];
+	s16b mon_los_num; /* How many of the above are set */
+	u32b mon_det[VIS_SIZE(MAX_M_IDX)]; /* Were these monsters detected by this player? */
+	s16b mon_det_idx[MAX_DETECTED]; /* The detected monsters... */
+	byte mon_det_pow[MAX_DETECTED]; /* ...and how long they stay detected */
+	s16b mon_det_num;
 
-	bool obj_vis[MAX_O_IDX];  /* Can this player see these objcets? */
+	u32b obj_vis[VIS_SIZE(MAX_O_IDX)];  /* Can this player see these objcets? */
 
-	bool play_vis[MAX_PLAYERS];	/* Can this player see these players? */
-	bool play_los[MAX_PLAYERS];
+	u32b play_vis[VIS_SIZE(MAX_PLAYERS)];	/* Can this player see these players? */
+	u32b play_los[VIS_SIZE(MAX_PLAYERS)];
+	s16b play_los_num; /* How many of the above are set */
 	byte play_det[MAX_PLAYERS]; /* Were these players detected by this player? */
 
 	bool *kind_aware; /* Is the player aware of this obj kind? */
@@ -1410,6 +1464,10 @@ struct player_type
 				/* What he should be seeing */
 	cave_view_type scr_info[MAX_HGT][MAX_WID];
 	cave_view_type trn_info[MAX_HGT][MAX_WID];
+				/* What his client has (for row-delta) */
+	cave_view_type sent_info[MAX_HGT][MAX_WID];
+	cave_view_type sent_trn[MAX_HGT][MAX_WID];
+	bool sent_ok[MAX_HGT]; /* Row of "sent_info" is known to match client's */
 	cave_view_type info[MAX_TXT_INFO][MAX_WID];
 	cave_view_type file[MAX_TXT_INFO][MAX_WID];
 	s16b last_info_line; /* (number of lines - 1) */
@@ -1646,7 +1704,8 @@ struct player_type
 	quest q_list[MAX_Q_IDX]; /* Quests completed by player */
 	bool in_hack;		/* Temporary flag, not guaranteed to stay same between function calls */
 
-	bool bubble_checked;	/* Have we been included in a time bubble check? */
+	s32b bubble_factor;	/* Time factor of our time bubble chain this turn */
+	hturn bubble_turn;		/* Server turn the above was worked out on */
 	s32b bubble_speed;		/* What was our last time bubble scale factor */
 	hturn bubble_change;		/* Server turn we last changed colour */
 	byte bubble_colour;		/* Current warning colour for slow time bubbles */
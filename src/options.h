@@ -396,15 +396,8 @@
 
 
 /*
- * OPTION: Allow use of the "flow_by_smell" and "flow_by_sound"
- * software options, which enable "monster flowing".
- * --broken in mangband.
- */
-/* #define MONSTER_FLOW */
-
-
-/*
- * OPTION: Maximum flow depth when using "MONSTER_FLOW"
+ * OPTION: Maximum flow depth, i.e. how many steps away from the
+ * nearest player monsters can "flow" around walls (max 254).
  */
 #define MONSTER_FLOW_DEPTH 32
 
@@ -554,7 +547,6 @@
 # undef ALLOW_COLORS
 # undef ALLOW_VISUALS
 # undef ALLOW_MACROS
-# undef MONSTER_FLOW
 # undef WDT_TRACK_OPTIONS
 # undef DRS_SMART_OPTIONS
 # undef ALLOW_OLD_SAVEFILES
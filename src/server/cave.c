@@ -31,6 +31,170 @@ int distance(int y1, int x1, int y2, int x2)
 }
 
 
+/*
+ * Wall bitboards.
+ *
+ * Each level keeps a packed copy of which of its grids block sight
+ * and projections, so that "los()" and "projectable()" test a single
+ * bit per grid instead of fetching a whole "cave_type" through the
+ * per-row pointers.  The board is built the first time it is needed
+ * and kept in sync by "cave_set_feat()" (or "update_wall_spot()" for
+ * code which writes "feat" directly).
+ *
+ * While a level is being generated (or loaded) the terrain changes
+ * wholesale, so no board is used and the cave itself is tested.
+ */
+
+/*
+ * Incremented whenever any wall bitboard changes (see "projectable()")
+ */
+static u32b wall_epoch;
+
+
+/*
+ * Determine if a grid blocks sight, using the board if we have one
+ */
+#define los_wall(W,D,Y,X) \
+	((W) ? wall_bold(W,Y,X) : !cave_floor_bold(D,Y,X))
+
+
+/*
+ * Forget the wall bitboard for a level
+ */
+void forget_walls(int Depth)
+{
+	/* Free the board */
+	if (cave_wall[Depth]) KILL(cave_wall[Depth]);
+
+	/* Cached queries may refer to it */
+	wall_epoch++;
+}
+
+
+/*
+ * Build the wall bitboard for a level from scratch
+ */
+static void build_walls(int Depth, wall_type *w_ptr)
+{
+	int y, x;
+
+	/* Start with no walls */
+	WIPE(w_ptr, wall_type);
+
+	/* Scan the level */
+	for (y = 0; y < MAX_HGT; y++)
+	{
+		cave_type *c_ptr = cave[Depth][y];
+
+		for (x = 0; x < MAX_WID; x++)
+		{
+			/* Note walls */
+			if (c_ptr[x].feat & 0x20) vis_on(w_ptr->bits[y], x);
+
+			/* Note arena walls (see "projectable_wall()") */
+			if (c_ptr[x].feat == FEAT_PVP_ARENA) w_ptr->arena = TRUE;
+		}
+	}
+}
+
+
+/*
+ * Get the wall bitboard for a level, building it if needed.
+ *
+ * Returns NULL if the level is not allocated, or is being generated.
+ */
+static wall_type *level_walls(int Depth)
+{
+	/* Paranoia -- level not allocated */
+	if (!cave[Depth]) return (NULL);
+
+	/* The level is still being created */
+	if (!server_dungeon)
+	{
+		/* Do not keep a board around from before */
+		if (cave_wall[Depth]) forget_walls(Depth);
+
+		return (NULL);
+	}
+
+	/* First use of this level */
+	if (!cave_wall[Depth])
+	{
+		MAKE(cave_wall[Depth], wall_type);
+		build_walls(Depth, cave_wall[Depth]);
+	}
+
+	return (cave_wall[Depth]);
+}
+
+
+/*
+ * Notice a change of the feature of a grid.
+ *
+ * This must be called by code which sets "feat" directly instead of
+ * through "cave_set_feat()", once the level has been generated.
+ */
+void update_wall_spot(int Depth, int y, int x)
+{
+	wall_type *w_ptr = cave_wall[Depth];
+	byte feat = cave[Depth][y][x].feat;
+
+	/* Monsters must path around (or through) it */
+	update_flow(Depth);
+
+	/* No board yet */
+	if (!w_ptr) return;
+
+	/* Note arena walls */
+	if (feat == FEAT_PVP_ARENA && !w_ptr->arena)
+	{
+		w_ptr->arena = TRUE;
+		wall_epoch++;
+	}
+
+	/* Nothing changed */
+	if (wall_bold(w_ptr, y, x) == ((feat & 0x20) ? 1 : 0)) return;
+
+	/* Update the board */
+	vis_set(w_ptr->bits[y], x, (feat & 0x20));
+
+	/* Cached queries may be wrong now */
+	wall_epoch++;
+}
+
+
+/*
+ * Determine if there are no walls in a row strictly between x1 and x2
+ */
+static bool wall_row_clear(wall_type *w_ptr, int y, int x1, int x2)
+{
+	u32b *row = w_ptr->bits[y];
+	u32b mask;
+	int lo, hi, i;
+
+	/* Exclude the end points */
+	if (x1 < x2) lo = x1 + 1, hi = x2 - 1;
+	else lo = x2 + 1, hi = x1 - 1;
+
+	/* Nothing in between */
+	if (lo > hi) return (TRUE);
+
+	/* Scan a word at a time */
+	for (i = lo >> 5; i <= (hi >> 5); i++)
+	{
+		mask = (u32b)0xFFFFFFFFL;
+
+		/* Trim the first and last words */
+		if (i == (lo >> 5)) mask &= ((u32b)0xFFFFFFFFL << (lo & 31));
+		if (i == (hi >> 5)) mask &= ((u32b)0xFFFFFFFFL >> (31 - (hi & 31)));
+
+		if (row[i] & mask) return (FALSE);
+	}
+
+	return (TRUE);
+}
+
+
 /*
  * A simple, fast, integer-based line-of-sight algorithm.  By Joseph Hall,
  * 4116 Brewster Drive, Raleigh NC 27606.  Email to jnh@ecemwl.ncsu.edu.
@@ -89,6 +253,9 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 	/* Slope, or 1/Slope, of LOS */
 	int m;
 
+	/* Wall bitboard */
+	wall_type *w_ptr;
+
 
 	/* Extract the offset */
 	dy = y2 - y1;
@@ -107,6 +274,10 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 	/* if (!in_bounds(y1, x1)) return (FALSE); */
 
 
+	/* Access the walls */
+	w_ptr = level_walls(Depth);
+
+
 	/* Directly South/North */
 	if (!dx)
 	{
@@ -115,7 +286,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 		{
 			for (ty = y1 + 1; ty < y2; ty++)
 			{
-				if (!cave_floor_bold(Depth, ty, x1)) return (FALSE);
+				if (los_wall(w_ptr, Depth, ty, x1)) return (FALSE);
 			}
 		}
 
@@ -124,7 +295,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 		{
 			for (ty = y1 - 1; ty > y2; ty--)
 			{
-				if (!cave_floor_bold(Depth, ty, x1)) return (FALSE);
+				if (los_wall(w_ptr, Depth, ty, x1)) return (FALSE);
 			}
 		}
 
@@ -135,12 +306,15 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 	/* Directly East/West */
 	if (!dy)
 	{
+		/* Test whole words of the row at once */
+		if (w_ptr) return (wall_row_clear(w_ptr, y1, x1, x2));
+
 		/* East -- check for walls */
 		if (dx > 0)
 		{
 			for (tx = x1 + 1; tx < x2; tx++)
 			{
-				if (!cave_floor_bold(Depth, y1, tx)) return (FALSE);
+				if (los_wall(w_ptr, Depth, y1, tx)) return (FALSE);
 			}
 		}
 
@@ -149,7 +323,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 		{
 			for (tx = x1 - 1; tx > x2; tx--)
 			{
-				if (!cave_floor_bold(Depth, y1, tx)) return (FALSE);
+				if (los_wall(w_ptr, Depth, y1, tx)) return (FALSE);
 			}
 		}
 
@@ -168,7 +342,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 	{
 		if (ay == 2)
 		{
-			if (cave_floor_bold(Depth, y1 + sy, x1)) return (TRUE);
+			if (!los_wall(w_ptr, Depth, y1 + sy, x1)) return (TRUE);
 		}
 	}
 
@@ -177,7 +351,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 	{
 		if (ax == 2)
 		{
-			if (cave_floor_bold(Depth, y1, x1 + sx)) return (TRUE);
+			if (!los_wall(w_ptr, Depth, y1, x1 + sx)) return (TRUE);
 		}
 	}
 
@@ -213,7 +387,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 		/* the LOS exactly meets the corner of a tile. */
 		while (x2 - tx)
 		{
-			if (!cave_floor_bold(Depth, ty, tx)) return (FALSE);
+			if (los_wall(w_ptr, Depth, ty, tx)) return (FALSE);
 
 			qy += m;
 
@@ -224,7 +398,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 			else if (qy > f2)
 			{
 				ty += sy;
-				if (!cave_floor_bold(Depth, ty, tx)) return (FALSE);
+				if (los_wall(w_ptr, Depth, ty, tx)) return (FALSE);
 				qy -= f1;
 				tx += sx;
 			}
@@ -260,7 +434,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 		/* the LOS exactly meets the corner of a tile. */
 		while (y2 - ty)
 		{
-			if (!cave_floor_bold(Depth, ty, tx)) return (FALSE);
+			if (los_wall(w_ptr, Depth, ty, tx)) return (FALSE);
 
 			qx += m;
 
@@ -271,7 +445,7 @@ bool los(int Depth, int y1, int x1, int y2, int x2)
 			else if (qx > f2)
 			{
 				tx += sx;
-				if (!cave_floor_bold(Depth, ty, tx)) return (FALSE);
+				if (los_wall(w_ptr, Depth, ty, tx)) return (FALSE);
 				qx -= f1;
 				ty += sy;
 			}
@@ -585,7 +759,7 @@ int player_pict(player_type *p_ptr, player_type *q_ptr)
 	}
 	
 	/* If we are in a slow time bubble, give a visual warning */
-	timefactor = base_time_factor(p_ptr, 0);
+	timefactor = base_time_factor(p_ptr);
 	if( same_player(q_ptr, p_ptr) && (timefactor < NORMAL_TIME) )
 	{
 		int blink_speed = cfg_fps;
@@ -1204,7 +1378,7 @@ void map_info(player_type *p_ptr, int y, int x, byte *ap, char *cp, byte *tap, c
 
 		/* Memorized objects */
 		/* Hack -- the dungeon master knows where everything is */
-		if ((p_ptr->obj_vis[c_ptr->o_idx]) || (p_ptr->dm_flags & DM_SEE_LEVEL))
+		if ((vis_has(p_ptr->obj_vis, c_ptr->o_idx)) || (p_ptr->dm_flags & DM_SEE_LEVEL))
 		{
 			/* Normal char */
 			(*cp) = object_char_p(p_ptr, o_ptr);
@@ -1231,7 +1405,7 @@ void map_info(player_type *p_ptr, int y, int x, byte *ap, char *cp, byte *tap, c
 		monster_type *m_ptr = &m_list[c_ptr->m_idx];
 
 		/* Visible monster */
-		if (p_ptr->mon_vis[c_ptr->m_idx])
+		if (vis_has(p_ptr->mon_vis, c_ptr->m_idx))
 		{
 			monster_race *r_ptr = &r_info[m_ptr->r_idx];
 
@@ -1339,7 +1513,7 @@ void map_info(player_type *p_ptr, int y, int x, byte *ap, char *cp, byte *tap, c
 	if (c_ptr->m_idx < 0)
 	{
 		/* Is that player visible? */
-		if (p_ptr->play_vis[0 - c_ptr->m_idx])
+		if (vis_has(p_ptr->play_vis, 0 - c_ptr->m_idx))
 		{
 			int p = player_pict(p_ptr, Players[0 - c_ptr->m_idx]);
 			a = PICT_A(p);
@@ -1395,13 +1569,13 @@ void note_spot(player_type *p_ptr, int y, int x)
 	if (c_ptr->o_idx)
 	{
 		/* Only memorize once */
-		if (!(p_ptr->obj_vis[c_ptr->o_idx]))
+		if (!(vis_has(p_ptr->obj_vis, c_ptr->o_idx)))
 		{
 			/* Memorize visible objects */
 			if (player_can_see_bold(p_ptr, y, x))
 			{
 				/* Memorize */
-				p_ptr->obj_vis[c_ptr->o_idx] = TRUE;
+				vis_on(p_ptr->obj_vis, c_ptr->o_idx);
 
 				/* Schedule list redraw */
 				p_ptr->window |= (PW_ITEMLIST);
@@ -1587,6 +1761,9 @@ void cave_set_feat(int Depth, int y, int x, int feat)
 	/* Change the feature */
 	c_ptr->feat = feat;
 
+	/* Update the wall bitboard (and monster flow) */
+	update_wall_spot(Depth, y, x);
+
 #if 0
 	/* Handle "wall/door" grids */
 	if (feat >= FEAT_DOOR_HEAD)
@@ -2285,10 +2462,14 @@ void update_player_lite(player_type *p_ptr, int y, int x)
  * quickly.
  *
  *
- * The current "update_view()" algorithm uses the "CAVE_XTRA" flag as a
- * temporary internal flag to mark those grids which are not only in view,
- * but which are also "easily" in line of sight of the player.  This flag
- * is always cleared when we are done.
+ * The current "update_view()" algorithm needs no temporary grid flag of
+ * its own.  Each octant keeps a local bit vector of the lines of sight
+ * which are still open, split across four words ("bits0" to "bits3"), and
+ * a wall clears the "vinfo" bits of every line passing through it.  A
+ * grid is in view while any of its lines is still open, and its children
+ * are queued, between the "queue_head" and "queue_tail" counters, only if
+ * it is not a wall.  The bit vector and the queue are discarded once each
+ * octant is done, so there is nothing to clear afterwards.
  *
  *
  * The current "update_lite()" and "update_view()" algorithms use the
@@ -2346,14 +2527,12 @@ void update_player_lite(player_type *p_ptr, int y, int x)
  *
  * Some comments on the "update_view()" algorithm...
  *
- * The algorithm is very fast, since it spreads "obvious" grids very quickly,
- * and only has to call "los()" on the borderline cases.  The major axes/diags
- * even terminate early when they hit walls.  I need to find a quick way
- * to "terminate" the other scans.
+ * The algorithm is table driven (see "vinfo_init()"), and never calls "los()".
+ * Each octant is a precomputed walk outwards from the player, and each scan
+ * terminates as soon as walls have blocked every line of sight.
  *
  * Note that in the worst case (a big empty area with say 5% scattered walls),
- * each of the 1500 or so nearby grids is checked once, most of them getting
- * an "instant" rating, and only a small portion requiring a call to "los()".
+ * each of the 1300 or so nearby grids is checked once, with four bit tests.
  *
  * The only time that the algorithm appears to be "noticeably" too slow is
  * when running, and this is usually only important in town, since the town
@@ -2379,18 +2558,6 @@ void update_player_lite(player_type *p_ptr, int y, int x)
  * Note that door/wall changes are only relevant when the door/wall itself is
  * in the "view" region.
  *
- * The algorithm seems to only call "los()" from zero to ten times, usually
- * only when coming down a corridor into a room, or standing in a room, just
- * misaligned with a corridor.  So if, say, there are five "nearby" monsters,
- * we will be reducing the calls to "los()".
- *
- * I am thinking in terms of an algorithm that "walks" from the central point
- * out to the maximal "distance", at each point, determining the "view" code
- * (above).  For each grid not on a major axis or diagonal, the "view" code
- * depends on the "cave_floor_bold()" and "view" of exactly two other grids
- * (the one along the nearest diagonal, and the one next to that one, see
- * "update_view_aux()"...).
- *
  * We "memorize" the viewable space array, so that at the cost of under 3000
  * bytes, we reduce the time taken by "forget_view()" to one assignment for
  * each grid actually in the "viewable space".  And for another 3000 bytes,
@@ -2732,6 +2899,9 @@ void forget_view(player_type *p_ptr)
 	/* None to forget */
 	if (!(p_ptr->view_n)) return;
 
+	/* Views on this depth have changed */
+	view_epoch[p_ptr->dun_depth]++;
+
 	/* Clear them all */
 	for (i = 0; i < p_ptr->view_n; i++)
 	{
@@ -2771,125 +2941,354 @@ void forget_view(player_type *p_ptr)
 
 
 /*
- * Helper function for "update_view()" below
- *
- * We are checking the "viewability" of grid (y,x) by the player.
- *
- * This function assumes that (y,x) is legal (i.e. on the map).
- *
- * Grid (y1,x1) is on the "diagonal" between (py,px) and (y,x)
- * Grid (y2,x2) is "adjacent", also between (py,px) and (y,x).
- *
- * Note that we are using the "CAVE_XTRA" field for marking grids as
- * "easily viewable".  This bit is cleared at the end of "update_view()".
- *
- * This function adds (y,x) to the "viewable set" if necessary.
+ * Maximum number of grids in a single octant
+ */
+#define VINFO_MAX_GRIDS 161
+
+/*
+ * Maximum number of slopes in a single octant
+ */
+#define VINFO_MAX_SLOPES 126
+
+/*
+ * Mask of bits used in a single octant
+ */
+#define VINFO_BITS_3 0x3FFFFFFF
+#define VINFO_BITS_2 0xFFFFFFFF
+#define VINFO_BITS_1 0xFFFFFFFF
+#define VINFO_BITS_0 0xFFFFFFFF
+
+/*
+ * Slopes are kept as fixed point numbers with this scale
+ */
+#define VINFO_SCALE 100000L
+
+
+/*
+ * Forward declare
+ */
+typedef struct vinfo_type vinfo_type;
+
+/*
+ * The "vinfo_type" structure
  *
- * This function now returns "TRUE" if vision is "blocked" by grid (y,x).
+ * One entry for each grid of the first octant of the MAX_SIGHT circle,
+ * giving the offsets of the matching grid in all eight octants, the set
+ * of "slopes" (lines of sight from the player) passing through it, and
+ * its two children, the grids just beyond it that those lines reach.
  */
- 
- 
-static bool update_view_aux(player_type *p_ptr, int y, int x, int y1, int x1, int y2, int x2)
+struct vinfo_type
 {
-	int Depth = p_ptr->dun_depth;
-	bool f1, f2, v1, v2, z1, z2, wall;
+	s16b grid_y[8];
+	s16b grid_x[8];
 
-	cave_type *c_ptr;
-	byte *w_ptr;
+	u32b bits_3;
+	u32b bits_2;
+	u32b bits_1;
+	u32b bits_0;
 
-	cave_type *g1_c_ptr;
-	cave_type *g2_c_ptr;
+	vinfo_type *next_0;
+	vinfo_type *next_1;
 
-	byte *g1_w_ptr;
-	byte *g2_w_ptr;
+	byte y;
+	byte x;
+	byte d;
+	byte r;
+};
 
-	/* Access the grids */
-	g1_c_ptr = &cave[Depth][y1][x1];
-	g2_c_ptr = &cave[Depth][y2][x2];
 
-	g1_w_ptr = &p_ptr->cave_flag[y1][x1];
-	g2_w_ptr = &p_ptr->cave_flag[y2][x2];
+/*
+ * The array of "vinfo" objects, initialized by "vinfo_init()"
+ */
+static vinfo_type vinfo[VINFO_MAX_GRIDS];
 
 
-	/* Check for walls */
-	f1 = (cave_floor_grid(g1_c_ptr));
-	f2 = (cave_floor_grid(g2_c_ptr));
+/*
+ * Slope scratch space, only used by "vinfo_init()"
+ */
+typedef struct vinfo_hack vinfo_hack;
 
-	/* Totally blocked by physical walls */
-	if (!f1 && !f2) return (TRUE);
+struct vinfo_hack
+{
+	int num_slopes;
 
+	long slopes[VINFO_MAX_SLOPES];
 
-	/* Check for visibility */
-	v1 = (f1 && (*(g1_w_ptr) & CAVE_VIEW));
-	v2 = (f2 && (*(g2_w_ptr) & CAVE_VIEW));
+	long slopes_min[MAX_SIGHT+1][MAX_SIGHT+1];
+	long slopes_max[MAX_SIGHT+1][MAX_SIGHT+1];
+};
 
-	/* Totally blocked by "unviewable neighbors" */
-	if (!v1 && !v2) return (TRUE);
 
+/*
+ * Save a slope passing through grid (y,x)
+ */
+static void vinfo_init_aux(vinfo_hack *hack, int y, int x, long m)
+{
+	int i;
 
-	/* Access the grid */
-	c_ptr = &cave[Depth][y][x];
-	w_ptr = &p_ptr->cave_flag[y][x];
+	/* Handle "legal" slopes */
+	if ((m > 0) && (m <= VINFO_SCALE))
+	{
+		/* Look for that slope */
+		for (i = 0; i < hack->num_slopes; i++)
+		{
+			if (hack->slopes[i] == m) break;
+		}
 
+		/* New slope */
+		if (i == hack->num_slopes)
+		{
+			/* Paranoia */
+			if (hack->num_slopes >= VINFO_MAX_SLOPES)
+			{
+				quit_fmt("Too many slopes (%d)!", VINFO_MAX_SLOPES);
+			}
+
+			/* Save the slope, and advance */
+			hack->slopes[hack->num_slopes++] = m;
+		}
+	}
+
+	/* Track slope range */
+	if (hack->slopes_min[y][x] > m) hack->slopes_min[y][x] = m;
+	if (hack->slopes_max[y][x] < m) hack->slopes_max[y][x] = m;
+}
 
-	/* Check for walls */
-	wall = (!cave_floor_grid(c_ptr));
 
+/*
+ * Fill in a "vinfo" entry for the first octant grid (y,x)
+ */
+static void vinfo_init_grid(vinfo_type *v_ptr, int y, int x)
+{
+	v_ptr->grid_y[0] = +y; v_ptr->grid_x[0] = +x;
+	v_ptr->grid_y[1] = +x; v_ptr->grid_x[1] = +y;
+	v_ptr->grid_y[2] = +x; v_ptr->grid_x[2] = -y;
+	v_ptr->grid_y[3] = +y; v_ptr->grid_x[3] = -x;
+	v_ptr->grid_y[4] = -y; v_ptr->grid_x[4] = -x;
+	v_ptr->grid_y[5] = -x; v_ptr->grid_x[5] = -y;
+	v_ptr->grid_y[6] = -x; v_ptr->grid_x[6] = +y;
+	v_ptr->grid_y[7] = -y; v_ptr->grid_x[7] = +x;
+
+	v_ptr->y = y;
+	v_ptr->x = x;
+}
 
-	/* Check the "ease" of visibility */
-	z1 = (v1 && (g1_c_ptr->info & CAVE_XTRA));
-	z2 = (v2 && (g2_c_ptr->info & CAVE_XTRA));
 
-	/* Hack -- "easy" plus "easy" yields "easy" */
-	if (z1 && z2)
+/*
+ * Initialize the "vinfo" array, used by "update_view()"
+ *
+ * Every grid of the first octant (0 <= y <= x, within MAX_SIGHT) gets a
+ * bit for each "slope" from the center of the player's grid which
+ * passes through it.  Walking the grids outwards, a wall removes its
+ * bits from the set of open slopes, and a grid is in view as long as
+ * at least one of its slopes is still open.
+ *
+ * The tables only depend on MAX_SIGHT, so they are built once, at
+ * startup, and shared by every player.
+ */
+errr vinfo_init(void)
+{
+	int i, y, x;
+
+	long m;
+
+	vinfo_hack *hack;
+
+	int num_grids = 0;
+
+	int queue_head = 0;
+	int queue_tail = 0;
+	vinfo_type *queue[VINFO_MAX_GRIDS*2];
+
+
+	/* Make hack */
+	MAKE(hack, vinfo_hack);
+
+
+	/* Analyze grids */
+	for (y = 0; y <= MAX_SIGHT; ++y)
 	{
-		c_ptr->info |= CAVE_XTRA;
+		for (x = y; x <= MAX_SIGHT; ++x)
+		{
+			/* Skip grids which are out of sight range */
+			if (distance(0, 0, y, x) > MAX_SIGHT) continue;
+
+			/* Default slope range */
+			hack->slopes_min[y][x] = 999999999;
+			hack->slopes_max[y][x] = 0;
+
+			/* Paranoia */
+			if (num_grids >= VINFO_MAX_GRIDS)
+			{
+				quit_fmt("Too many grids (%d >= %d)!",
+				         num_grids, VINFO_MAX_GRIDS);
+			}
+
+			/* Count grids */
+			num_grids++;
+
+			/* Slope to the top right corner */
+			m = VINFO_SCALE * (1000L * y - 500) / (1000L * x + 500);
+
+			/* Handle "legal" slopes */
+			vinfo_init_aux(hack, y, x, m);
+
+			/* Slope to top left corner */
+			m = VINFO_SCALE * (1000L * y - 500) / (1000L * x - 500);
+
+			/* Handle "legal" slopes */
+			vinfo_init_aux(hack, y, x, m);
 
-		cave_view_hack(w_ptr, y, x);
+			/* Slope to bottom right corner */
+			m = VINFO_SCALE * (1000L * y + 500) / (1000L * x + 500);
 
-		return (wall);
+			/* Handle "legal" slopes */
+			vinfo_init_aux(hack, y, x, m);
+
+			/* Slope to bottom left corner */
+			m = VINFO_SCALE * (1000L * y + 500) / (1000L * x - 500);
+
+			/* Handle "legal" slopes */
+			vinfo_init_aux(hack, y, x, m);
+		}
 	}
 
-	/* Hack -- primary "easy" yields "viewed" */
-	if (z1)
+
+	/* Enforce maximal efficiency */
+	if (num_grids < VINFO_MAX_GRIDS)
 	{
-		cave_view_hack(w_ptr, y, x);
+		quit_fmt("Too few grids (%d < %d)!",
+		         num_grids, VINFO_MAX_GRIDS);
+	}
 
-		return (wall);
+	/* Enforce maximal efficiency */
+	if (hack->num_slopes < VINFO_MAX_SLOPES)
+	{
+		quit_fmt("Too few slopes (%d < %d)!",
+		         hack->num_slopes, VINFO_MAX_SLOPES);
 	}
 
 
-	/* Hack -- "view" plus "view" yields "view" */
-	if (v1 && v2)
+	/* Sort slopes numerically (insertion sort, there are few) */
+	for (i = 1; i < hack->num_slopes; i++)
 	{
-		/* c_ptr->info |= CAVE_XTRA; */
+		long t = hack->slopes[i];
+		int j;
 
-		cave_view_hack(w_ptr, y, x);
+		for (j = i; (j > 0) && (hack->slopes[j-1] > t); j--)
+			hack->slopes[j] = hack->slopes[j-1];
 
-		return (wall);
+		hack->slopes[j] = t;
 	}
 
 
-	/* Mega-Hack -- the "los()" function works poorly on walls */
-	if (wall)
+	/* Initialize the first "vinfo" entry (the player grid) */
+	WIPE(&vinfo[0], vinfo_type);
+	vinfo_init_grid(&vinfo[0], 0, 0);
+
+	/* Initialize bits */
+	vinfo[0].bits_3 = VINFO_BITS_3;
+	vinfo[0].bits_2 = VINFO_BITS_2;
+	vinfo[0].bits_1 = VINFO_BITS_1;
+	vinfo[0].bits_0 = VINFO_BITS_0;
+
+	/* Enqueue */
+	queue[queue_tail++] = &vinfo[0];
+
+
+	/* Process queue */
+	while (queue_head < queue_tail)
 	{
-		cave_view_hack(w_ptr, y, x);
+		/* Dequeue next grid */
+		vinfo_type *p = queue[queue_head++];
+		int e = p - vinfo;
+
+		/* Location of main grid */
+		y = p->y;
+		x = p->x;
+
+		/* Compute its slope bits */
+		for (i = 0; i < VINFO_MAX_SLOPES; ++i)
+		{
+			m = hack->slopes[i];
+
+			/* Grid is "on" the line */
+			if ((hack->slopes_min[y][x] < m) &&
+			    (m < hack->slopes_max[y][x]))
+			{
+				/* Set the bit */
+				if (i < 32) p->bits_0 |= (1L << (i - 0));
+				else if (i < 64) p->bits_1 |= (1L << (i - 32));
+				else if (i < 96) p->bits_2 |= (1L << (i - 64));
+				else p->bits_3 |= (1L << (i - 96));
+			}
+		}
+
+		/* Default (no child, at the edge of sight) */
+		p->next_0 = NULL;
+
+		/* Grid next child */
+		if (distance(0, 0, y, x+1) <= MAX_SIGHT)
+		{
+			/* New grid */
+			if ((queue[queue_tail-1]->y != y) ||
+			    (queue[queue_tail-1]->x != x+1))
+			{
+				WIPE(&vinfo[queue_tail], vinfo_type);
+				vinfo_init_grid(&vinfo[queue_tail], y, x+1);
+				queue[queue_tail] = &vinfo[queue_tail];
+				queue_tail++;
+			}
 
-		return (wall);
+			/* Child */
+			p->next_0 = &vinfo[queue_tail-1];
+		}
+
+		/* Default (no child, at the edge of sight) */
+		p->next_1 = NULL;
+
+		/* Grid diag child */
+		if (distance(0, 0, y+1, x+1) <= MAX_SIGHT)
+		{
+			/* New grid */
+			if ((queue[queue_tail-1]->y != y+1) ||
+			    (queue[queue_tail-1]->x != x+1))
+			{
+				WIPE(&vinfo[queue_tail], vinfo_type);
+				vinfo_init_grid(&vinfo[queue_tail], y+1, x+1);
+				queue[queue_tail] = &vinfo[queue_tail];
+				queue_tail++;
+			}
+
+			/* Child */
+			p->next_1 = &vinfo[queue_tail-1];
+		}
+
+		/* Hack -- main diagonal has special children */
+		if (y == x) p->next_0 = p->next_1;
+
+		/* Extra values */
+		vinfo[e].d = ((y > x) ? (y + x/2) : (x + y/2));
+		vinfo[e].r = ((!y) ? x : (!x) ? y : (y == x) ? y : 0);
 	}
 
 
-	/* Hack -- check line of sight */
-	if (los(Depth, p_ptr->py, p_ptr->px, y, x))
+	/* Verify maximal bits XXX XXX XXX */
+	if (((vinfo[1].bits_3 | vinfo[2].bits_3) != VINFO_BITS_3) ||
+	    ((vinfo[1].bits_2 | vinfo[2].bits_2) != VINFO_BITS_2) ||
+	    ((vinfo[1].bits_1 | vinfo[2].bits_1) != VINFO_BITS_1) ||
+	    ((vinfo[1].bits_0 | vinfo[2].bits_0) != VINFO_BITS_0))
 	{
-		cave_view_hack(w_ptr, y, x);
-
-		return (wall);
+		quit("Incorrect bit masks!");
 	}
 
 
-	/* Assume no line of sight. */
-	return (TRUE);
+	/* Kill hack */
+	KILL(hack);
+
+
+	/* Success */
+	return (0);
 }
 
 
@@ -2899,115 +3298,33 @@ static bool update_view_aux(player_type *p_ptr, int y, int x, int y1, int x1, in
  *
  *  1: Process the player
  *  1a: The player is always (easily) viewable
- *  2: Process the diagonals
- *  2a: The diagonals are (easily) viewable up to the first wall
- *  2b: But never go more than 2/3 of the "full" distance
- *  3: Process the main axes
- *  3a: The main axes are (easily) viewable up to the first wall
- *  3b: But never go more than the "full" distance
- *  4: Process sequential "strips" in each of the eight octants
- *  4a: Each strip runs along the previous strip
- *  4b: The main axes are "previous" to the first strip
- *  4c: Process both "sides" of each "direction" of each strip
- *  4c1: Each side aborts as soon as possible
- *  4c2: Each side tells the next strip how far it has to check
- *
- * Note that the octant processing involves some pretty interesting
- * observations involving when a grid might possibly be viewable from
- * a given grid, and on the order in which the strips are processed.
- *
- * Note the use of the mathematical facts shown below, which derive
- * from the fact that (1 < sqrt(2) < 1.5), and that the length of the
- * hypotenuse of a right triangle is primarily determined by the length
- * of the longest side, when one side is small, and is strictly less
- * than one-and-a-half times as long as the longest side when both of
- * the sides are large.
- *
- *   if (manhatten(dy,dx) < R) then (hypot(dy,dx) < R)
- *   if (manhatten(dy,dx) > R*3/2) then (hypot(dy,dx) > R)
- *
- *   hypot(dy,dx) is approximated by (dx+dy+MAX(dx,dy)) / 2
- *
- * These observations are important because the calculation of the actual
- * value of "hypot(dx,dy)" is extremely expensive, involving square roots,
- * while for small values (up to about 20 or so), the approximations above
- * are correct to within an error of at most one grid or so.
- *
- * Observe the use of "full" and "over" in the code below, and the use of
- * the specialized calculation involving "limit", all of which derive from
- * the observations given above.  Basically, we note that the "circle" of
- * view is completely contained in an "octagon" whose bounds are easy to
- * determine, and that only a few steps are needed to derive the actual
- * bounds of the circle given the bounds of the octagon.
- *
- * Note that by skipping all the grids in the corners of the octagon, we
- * place an upper limit on the number of grids in the field of view, given
- * that "full" is never more than 20.  Of the 1681 grids in the "square" of
- * view, only about 1475 of these are in the "octagon" of view, and even
- * fewer are in the "circle" of view, so 1500 or 1536 is more than enough
- * entries to completely contain the actual field of view.
- *
- * Note also the care taken to prevent "running off the map".  The use of
- * explicit checks on the "validity" of the "diagonal", and the fact that
- * the loops are never allowed to "leave" the map, lets "update_view_aux()"
- * use the optimized "cave_floor_bold()" macro, and to avoid the overhead
- * of multiple checks on the validity of grids.
- *
- * Note the "optimizations" involving the "se","sw","ne","nw","es","en",
- * "ws","wn" variables.  They work like this: While travelling down the
- * south-bound strip just to the east of the main south axis, as soon as
- * we get to a grid which does not "transmit" viewing, if all of the strips
- * preceding us (in this case, just the main axis) had terminated at or before
- * the same point, then we can stop, and reset the "max distance" to ourself.
- * So, each strip (named by major axis plus offset, thus "se" in this case)
- * maintains a "blockage" variable, initialized during the main axis step,
- * and checks it whenever a blockage is observed.  After processing each
- * strip as far as the previous strip told us to process, the next strip is
- * told not to go farther than the current strip's farthest viewable grid,
- * unless open space is still available.  This uses the "k" variable.
- *
- * Note the use of "inline" macros for efficiency.  The "cave_floor_grid()"
- * macro is a replacement for "cave_floor_bold()" which takes a pointer to
- * a cave grid instead of its location.  The "cave_view_hack()" macro is a
- * chunk of code which adds the given location to the "view" array if it
- * is not already there, using both the actual location and a pointer to
- * the cave grid.  See above.
- *
- * By the way, the purpose of this code is to reduce the dependancy on the
- * "los()" function which is slow, and, in some cases, not very accurate.
- *
- * It is very possible that I am the only person who fully understands this
- * function, and for that I am truly sorry, but efficiency was very important
- * and the "simple" version of this function was just not fast enough.  I am
- * more than willing to replace this function with a simpler one, if it is
- * equally efficient, and especially willing if the new function happens to
- * derive "reverse-line-of-sight" at the same time, since currently monsters
- * just use an optimized hack of "you see me, so I see you", and then use the
- * actual "projectable()" function to check spell attacks.
- *
- * Well, I for one don't understand it, so I'm hoping I didn't screw anything
- * up while trying to do this. --KLJ--
- */
- 
- /* Hmm, this function doesn't seem to be very "mangworld" friendly... 
-    lets add some speedbumps/sanity checks.
-    -APD-  
-    
-    With my new "invisible wall" code this shouldn't be neccecary. 
-    
+ *  2: Process the eight octants
+ *  2a: Walk the precomputed "vinfo" grids of each octant outwards
+ *  2b: Each wall grid blocks the "slopes" passing through it
+ *  2c: A grid is viewable while any of its slopes remains open
+ *  3: Redraw the grids which entered or left the view
+ *
+ * The "vinfo" tables (see "vinfo_init()") reduce each octant to a short
+ * walk over at most VINFO_MAX_GRIDS grids, testing four bit masks per
+ * grid, with no calls to "los()" at all.  Each grid is visited once per
+ * octant, and the walk stops early once every slope has been blocked,
+ * so a player in a corridor only looks at a handful of grids.
+ *
+ * The old "view" grids are remembered with the "CAVE_TEMP" flag, so we
+ * only redraw grids whose viewability actually changed; after a single
+ * step, that is usually just the edges of the view.
+ *
+ * Note that "CAVE_TEMP" lives in the shared cave, so (as before) views
+ * must be computed one player at a time.
  */
 void update_view(player_type *p_ptr)
 {
 	int Depth = p_ptr->dun_depth;
 
-	int n, m, d, k, y, x, z;
-
-	int se, sw, ne, nw, es, en, ws, wn;
-
-	int full, over;
+	int py = p_ptr->py;
+	int px = p_ptr->px;
 
-	int y_max = p_ptr->cur_hgt - 1;
-	int x_max = p_ptr->cur_wid - 1;
+	int n, o, y, x, full;
 
 	cave_type *c_ptr;
 	byte *w_ptr;
@@ -3015,14 +3332,14 @@ void update_view(player_type *p_ptr)
 
 	/*** Initialize ***/
 
+	/* Views on this depth have changed */
+	view_epoch[p_ptr->dun_depth]++;
+
 	/* Optimize */
 	if (option_p(p_ptr,VIEW_REDUCE_VIEW) && !Depth)
 	{
 		/* Full radius (10) */
 		full = MAX_SIGHT / 2;
-
-		/* Octagon factor (15) */
-		over = MAX_SIGHT * 3 / 4;
 	}
 
 	/* Normal */
@@ -3030,9 +3347,6 @@ void update_view(player_type *p_ptr)
 	{
 		/* Full radius (20) */
 		full = MAX_SIGHT;
-
-		/* Octagon factor (30) */
-		over = MAX_SIGHT * 3 / 2;
 	}
 
 
@@ -3064,387 +3378,100 @@ void update_view(player_type *p_ptr)
 	p_ptr->view_n = 0;
 
 
-	/*** Step 1 -- adjacent grids ***/
-
-	/* Now start on the player */
-	y = p_ptr->py;
-	x = p_ptr->px;
-
-	/* Access the grid */
-	c_ptr = &cave[Depth][y][x];
-	w_ptr = &p_ptr->cave_flag[y][x];
-
-	/* Assume the player grid is easily viewable */
-	c_ptr->info |= CAVE_XTRA;
+	/*** Step 1 -- player grid ***/
 
 	/* Assume the player grid is viewable */
-	cave_view_hack(w_ptr, y, x);
-
-
-	/*** Step 2 -- Major Diagonals ***/
-
-	/* Hack -- Limit */
-	z = full * 2 / 3;
-
-	/* Scan south-east */
-	for (d = 1; d <= z; d++)
-	{
-		/*if (y + d > 65) break;*/
-		c_ptr = &cave[Depth][y+d][x+d];
-		w_ptr = &p_ptr->cave_flag[y+d][x+d];
-		c_ptr->info |= CAVE_XTRA;
-		cave_view_hack(w_ptr, y+d, x+d);
-		if (!cave_floor_grid(c_ptr)) break;		
-	}
-
-	/* Scan south-west */
-	for (d = 1; d <= z; d++)
-	{
-		/*if (y + d > 65) break;*/
-		c_ptr = &cave[Depth][y+d][x-d];
-		w_ptr = &p_ptr->cave_flag[y+d][x-d];
-		c_ptr->info |= CAVE_XTRA;
-		cave_view_hack(w_ptr, y+d, x-d);
-		if (!cave_floor_grid(c_ptr)) break;
-	}
-
-	/* Scan north-east */
-	for (d = 1; d <= z; d++)
-	{
-		/*if (d > y) break;*/
-		c_ptr = &cave[Depth][y-d][x+d];
-		w_ptr = &p_ptr->cave_flag[y-d][x+d];
-		c_ptr->info |= CAVE_XTRA;
-		cave_view_hack(w_ptr, y-d, x+d);
-		if (!cave_floor_grid(c_ptr)) break;
-	}
-
-	/* Scan north-west */
-	for (d = 1; d <= z; d++)
-	{
-		/*if (d > y) break;*/
-		c_ptr = &cave[Depth][y-d][x-d];
-		w_ptr = &p_ptr->cave_flag[y-d][x-d];
-		c_ptr->info |= CAVE_XTRA;
-		cave_view_hack(w_ptr, y-d, x-d);
-		if (!cave_floor_grid(c_ptr)) break;
-	}
-
+	w_ptr = &p_ptr->cave_flag[py][px];
+	cave_view_hack(w_ptr, py, px);
 
-	/*** Step 3 -- major axes ***/
 
-	/* Scan south */
-	for (d = 1; d <= full; d++)
-	{
-		/*if (y + d > 65) break;*/
-		c_ptr = &cave[Depth][y+d][x];
-		w_ptr = &p_ptr->cave_flag[y+d][x];
-		c_ptr->info |= CAVE_XTRA;
-		cave_view_hack(w_ptr, y+d, x);
-		if (!cave_floor_grid(c_ptr)) break;
-	}
-
-	/* Initialize the "south strips" */
-	se = sw = d;
-
-	/* Scan north */
-	for (d = 1; d <= full; d++)
-	{
-		/*if (d > y) break;*/
-		c_ptr = &cave[Depth][y-d][x];
-		w_ptr = &p_ptr->cave_flag[y-d][x];
-		c_ptr->info |= CAVE_XTRA;
-		cave_view_hack(w_ptr, y-d, x);
-		if (!cave_floor_grid(c_ptr)) break;
-	}
+	/*** Step 2 -- octants ***/
 
-	/* Initialize the "north strips" */
-	ne = nw = d;
-
-	/* Scan east */
-	for (d = 1; d <= full; d++)
+	for (o = 0; o < 8; o++)
 	{
-		c_ptr = &cave[Depth][y][x+d];
-		w_ptr = &p_ptr->cave_flag[y][x+d];
-		c_ptr->info |= CAVE_XTRA;
-		cave_view_hack(w_ptr, y, x+d);
-		if (!cave_floor_grid(c_ptr)) break;
-	}
-
-	/* Initialize the "east strips" */
-	es = en = d;
-
-	/* Scan west */
-	for (d = 1; d <= full; d++)
-	{
-		c_ptr = &cave[Depth][y][x-d];
-		w_ptr = &p_ptr->cave_flag[y][x-d];
-		c_ptr->info |= CAVE_XTRA;
-		cave_view_hack(w_ptr, y, x-d);
-		if (!cave_floor_grid(c_ptr)) break;
-	}
-
-	/* Initialize the "west strips" */
-	ws = wn = d;
-
-
-	/*** Step 4 -- Divide each "octant" into "strips" ***/
-
-	/* Now check each "diagonal" (in parallel) */
-	for (n = 1; n <= over / 2; n++)
-	{
-		int ypn, ymn, xpn, xmn;
-
-
-		/* Acquire the "bounds" of the maximal circle */
-		z = over - n - n;
-		if (z > full - n) z = full - n;
-		while ((z + n + (n>>1)) > full) z--;
-
-
-		/* Access the four diagonal grids */
-		ypn = y + n;
-		ymn = y - n;
-		xpn = x + n;
-		xmn = x - n;
-
-
-		/* South strip */
-		if (ypn < y_max)
-		{
-			/* Maximum distance */
-			m = MIN(z, y_max - ypn);
-
-			/* East side */
-			if ((xpn <= x_max) && (n < se))
-			{
-				/* Scan */
-				for (k = n, d = 1; d <= m; d++)
-				{				
-					/*if (ypn + d > 65) break; */
-				
-					/* Check grid "d" in strip "n", notice "blockage" */
-					if (update_view_aux(p_ptr, ypn+d, xpn, ypn+d-1, xpn-1, ypn+d-1, xpn))
-					{
-						if (n + d >= se) break;
-					}								
-					
-					/* Track most distant "non-blockage" */
-					else
-					{
-						k = n + d;
-					}										
-					
-				}
+		vinfo_type *p;
 
-				/* Limit the next strip */
-				se = k + 1;
-			}
+		/* Last added */
+		vinfo_type *last = &vinfo[0];
 
-			/* West side */
-			if ((xmn >= 0) && (n < sw))
-			{
-				/* Scan */
-				for (k = n, d = 1; d <= m; d++)
-				{
-					/*if (ypn + d > 65) break;*/
-				
-					/* Check grid "d" in strip "n", notice "blockage" */
-					if (update_view_aux(p_ptr, ypn+d, xmn, ypn+d-1, xmn+1, ypn+d-1, xmn))
-					{
-						if (n + d >= sw) break;
-					}
+		/* Grid queue */
+		int queue_head = 0;
+		int queue_tail = 0;
+		vinfo_type *queue[VINFO_MAX_GRIDS*2];
 
-					/* Track most distant "non-blockage" */
-					else
-					{
-						k = n + d;
-					}
-										
-				}
+		/* Slope bit vector */
+		u32b bits0 = VINFO_BITS_0;
+		u32b bits1 = VINFO_BITS_1;
+		u32b bits2 = VINFO_BITS_2;
+		u32b bits3 = VINFO_BITS_3;
 
-				/* Limit the next strip */
-				sw = k + 1;
-			}
-		}
+		/* Initial grids */
+		queue[queue_tail++] = &vinfo[1];
+		queue[queue_tail++] = &vinfo[2];
 
-
-		/* North strip */
-		if (ymn > 0)
+		/* Process queue */
+		while (queue_head < queue_tail)
 		{
-			/* Maximum distance */
-			m = MIN(z, ymn);
+			/* Dequeue next grid */
+			p = queue[queue_head++];
 
-			/* East side */
-			if ((xpn <= x_max) && (n < ne))
-			{
-				/* Scan */
-				for (k = n, d = 1; d <= m; d++)
-				{
-					/*if (d > ymn) break;*/
-				
-					/* Check grid "d" in strip "n", notice "blockage" */
-					if (update_view_aux(p_ptr, ymn-d, xpn, ymn-d+1, xpn-1, ymn-d+1, xpn))
-					{
-						if (n + d >= ne) break;
-					}
+			/* Check bits */
+			if (!((bits0 & (p->bits_0)) ||
+			      (bits1 & (p->bits_1)) ||
+			      (bits2 & (p->bits_2)) ||
+			      (bits3 & (p->bits_3)))) continue;
 
-					/* Track most distant "non-blockage" */
-					else
-					{
-						k = n + d;
-					}										
-				}
-
-				/* Limit the next strip */
-				ne = k + 1;
-			}
+			/* Reduced view */
+			if (p->d > full) continue;
 
-			/* West side */
-			if ((xmn >= 0) && (n < nw))
-			{
-				/* Scan */
-				for (k = n, d = 1; d <= m; d++)
-				{
-					/*if (d > ymn) break;*/
-					
-					/* Check grid "d" in strip "n", notice "blockage" */
-					if (update_view_aux(p_ptr, ymn-d, xmn, ymn-d+1, xmn+1, ymn-d+1, xmn))
-					{
-						if (n + d >= nw) break;
-					}
+			/* Extract the location */
+			y = py + p->grid_y[o];
+			x = px + p->grid_x[o];
 
-					/* Track most distant "non-blockage" */
-					else
-					{
-						k = n + d;
-					}										
-				}
+			/* Paranoia -- stay on the map */
+			if ((y < 0) || (y >= p_ptr->cur_hgt) ||
+			    (x < 0) || (x >= p_ptr->cur_wid)) continue;
 
-				/* Limit the next strip */
-				nw = k + 1;
-			}
-		}
-
-
-		/* East strip */
-		if (xpn < x_max)
-		{
-			/* Maximum distance */
-			m = MIN(z, x_max - xpn);
+			/* Access the grid */
+			c_ptr = &cave[Depth][y][x];
+			w_ptr = &p_ptr->cave_flag[y][x];
 
-			/* South side */
-			if ((ypn <= x_max) && (n < es))
+			/* Handle wall */
+			if (!cave_floor_grid(c_ptr))
 			{
-				/* Scan */
-				for (k = n, d = 1; d <= m; d++)
-				{
-					/*if (ypn > 65) break;*/
-				
-					/* Check grid "d" in strip "n", notice "blockage" */
-					if (update_view_aux(p_ptr, ypn, xpn+d, ypn-1, xpn+d-1, ypn, xpn+d-1))
-					{
-						if (n + d >= es) break;
-					}
-
-					/* Track most distant "non-blockage" */
-					else
-					{
-						k = n + d;
-					}
-				}
-
-				/* Limit the next strip */
-				es = k + 1;
+				/* Clear bits */
+				bits0 &= ~(p->bits_0);
+				bits1 &= ~(p->bits_1);
+				bits2 &= ~(p->bits_2);
+				bits3 &= ~(p->bits_3);
 			}
 
-			/* North side */
-			if ((ymn >= 0) && (n < en))
+			/* Handle non-wall */
+			else
 			{
-				/* Scan */
-				for (k = n, d = 1; d <= m; d++)
+				/* Enqueue child */
+				if (p->next_0 && (last != p->next_0))
 				{
-					/*if (ymn > 65) break;*/
-				
-					/* Check grid "d" in strip "n", notice "blockage" */
-					if (update_view_aux(p_ptr, ymn, xpn+d, ymn+1, xpn+d-1, ymn, xpn+d-1))
-					{
-						if (n + d >= en) break;
-					}
-
-					/* Track most distant "non-blockage" */
-					else
-					{
-						k = n + d;
-					}
+					queue[queue_tail++] = last = p->next_0;
 				}
 
-				/* Limit the next strip */
-				en = k + 1;
-			}
-		}
-
-
-		/* West strip */
-		if (xmn > 0)
-		{
-			/* Maximum distance */
-			m = MIN(z, xmn);
-
-			/* South side */
-			if ((ypn <= y_max) && (n < ws))
-			{
-				/* Scan */
-				for (k = n, d = 1; d <= m; d++)
+				/* Enqueue child */
+				if (p->next_1 && (last != p->next_1))
 				{
-					/*if (ypn > 65) break;*/
-				
-					/* Check grid "d" in strip "n", notice "blockage" */
-					if (update_view_aux(p_ptr, ypn, xmn-d, ypn-1, xmn-d+1, ypn, xmn-d+1))
-					{
-						if (n + d >= ws) break;
-					}
-
-					/* Track most distant "non-blockage" */
-					else
-					{
-						k = n + d;
-					}
+					queue[queue_tail++] = last = p->next_1;
 				}
-
-				/* Limit the next strip */
-				ws = k + 1;
 			}
 
-			/* North side */
-			if ((ymn >= 0) && (n < wn))
+			/* Newly viewable grid (axes and diagonals are shared) */
+			if (!(*w_ptr & CAVE_VIEW))
 			{
-				/* Scan */
-				for (k = n, d = 1; d <= m; d++)
-				{
-					/*if (ymn > 65) break;*/
-				
-					/* Check grid "d" in strip "n", notice "blockage" */
-					if (update_view_aux(p_ptr, ymn, xmn-d, ymn+1, xmn-d+1, ymn, xmn-d+1))
-					{
-						if (n + d >= wn) break;
-					}
-
-					/* Track most distant "non-blockage" */
-					else
-					{
-						k = n + d;
-					}
-				}
-
-				/* Limit the next strip */
-				wn = k + 1;
+				cave_view_hack(w_ptr, y, x);
 			}
 		}
 	}
 
 
-	/*** Step 5 -- Complete the algorithm ***/
+	/*** Step 3 -- Complete the algorithm ***/
 
 	/* Update all the new grids */
 	for (n = 0; n < p_ptr->view_n; n++)
@@ -3455,9 +3482,6 @@ void update_view(player_type *p_ptr)
 		/* Access the grid */
 		c_ptr = &cave[Depth][y][x];
 
-		/* Clear the "CAVE_XTRA" flag */
-		c_ptr->info &= ~CAVE_XTRA;
-
 		/* Update only newly viewed grids */
 		if (c_ptr->info & CAVE_TEMP) continue;
 
@@ -3497,186 +3521,170 @@ void update_view(player_type *p_ptr)
 
 
 
+
 /*
- * Hack -- provide some "speed" for the "flow" code
- * This entry is the "current index" for the "when" field
- * Note that a "when" value of "zero" means "not used".
- *
- * Note that the "cost" indexes from 1 to 127 are for
- * "old" data, and from 128 to 255 are for "new" data.
- *
- * This means that as long as the player does not "teleport",
- * then any monster up to 128 + MONSTER_FLOW_DEPTH will be
- * able to track down the player, and in general, will be
- * able to track down either the player or a position recently
- * occupied by the player.
+ * Queue of grids for the "flow" code.  Every grid is added at most
+ * once per update, so a simple linear queue is large enough.
  */
-/*static int flow_n = 0;*/
+static byte flow_y[MAX_HGT * MAX_WID];
+static byte flow_x[MAX_HGT * MAX_WID];
 
 
 /*
- * Hack -- forget the "flow" information
+ * Hack -- forget the "flow" information for a level
  */
-void forget_flow(void)
+void forget_flow(int Depth)
 {
-
-#ifdef MONSTER_FLOW
-
-	int x, y;
-
-	/* Nothing to forget */
-	if (!flow_n) return;
-
-	/* Check the entire dungeon */
-	for (y = 0; y < cur_hgt; y++)
-	{
-		for (x = 0; x < cur_wid; x++)
-		{
-			/* Forget the old data */
-			cave[y][x].cost = 0;
-			cave[y][x].when = 0;
-		}
-	}
-
-	/* Start over */
-	flow_n = 0;
-
-#endif
-
+	/* Free the costs */
+	if (cave_flow[Depth]) KILL(cave_flow[Depth]);
 }
 
 
-#ifdef MONSTER_FLOW
-
 /*
- * Hack -- Allow us to treat the "seen" array as a queue
+ * Note that the "flow" information for a level is out of date,
+ * because a player moved or the terrain changed.
+ *
+ * The costs are recomputed lazily (see "level_flow()"), so this is
+ * cheap enough to call whenever a player takes a step.
  */
-static int flow_head = 0;
-static int flow_tail = 0;
+void update_flow(int Depth)
+{
+	if (cave_flow[Depth]) cave_flow[Depth]->stale = TRUE;
+}
 
 
 /*
- * Take note of a reachable grid.  Assume grid is legal.
+ * Determine if monsters can "flow" through a grid.
+ *
+ * Doors (including secret ones) are passable, since most monsters
+ * can open or bash them; rubble and walls are not.
  */
-static void update_flow_aux(int y, int x, int n)
+static bool flow_passable(int Depth, int y, int x)
 {
-	cave_type *c_ptr;
-
-	int old_head = flow_head;
-
-
-	/* Get the grid */
-	c_ptr = &cave[y][x];
-
-	/* Ignore "pre-stamped" entries */
-	if (c_ptr->when == flow_n) return;
+	byte feat = cave[Depth][y][x].feat;
 
-	/* Ignore "walls" and "rubble" */
-	if (c_ptr->feat >= FEAT_RUBBLE) return;
+	if ((feat >= FEAT_DOOR_HEAD) && (feat <= FEAT_SECRET)) return (TRUE);
 
-	/* Save the time-stamp */
-	c_ptr->when = flow_n;
-
-	/* Save the flow cost */
-	c_ptr->cost = n;
-
-	/* Hack -- limit flow depth */
-	if (n == MONSTER_FLOW_DEPTH) return;
-
-	/* Enqueue that entry */
-	temp_y[flow_head] = y;
-	temp_x[flow_head] = x;
-
-	/* Advance the queue */
-	if (++flow_head == TEMP_MAX) flow_head = 0;
-
-	/* Hack -- notice overflow by forgetting new entry */
-	if (flow_head == flow_tail) flow_head = old_head;
+	return (cave_floor_bold(Depth, y, x));
 }
 
-#endif
-
 
 /*
- * Hack -- fill in the "cost" field of every grid that the player
- * can "reach" with the number of steps needed to reach that grid.
- * This also yields the "distance" of the player from every grid.
- *
- * In addition, mark the "when" of the grids that can reach
- * the player with the incremented value of "flow_n".
- *
- * Hack -- use the "seen" array as a "circular queue".
- *
- * We do not need a priority queue because the cost from grid
- * to grid is always "one" and we process them in order.
+ * Fill in the "cost" of every grid within MONSTER_FLOW_DEPTH steps
+ * of a player on the level with the number of steps needed to reach
+ * the nearest such player.  All other grids get FLOW_NONE.
+ *
+ * Every player on the level is added to the queue at cost zero, so a
+ * single breadth first search serves all of them.  We do not need a
+ * priority queue because the cost from grid to grid is always "one"
+ * and we process them in order.
  */
-void update_flow(void)
+static void build_flow(int Depth, flow_type *f_ptr)
 {
+	int head = 0, tail = 0;
+	int i, d, y, x, n;
 
-#ifdef MONSTER_FLOW
-
-	int x, y, d;
+	/* Forget the old costs */
+	memset(f_ptr->cost, FLOW_NONE, sizeof(f_ptr->cost));
 
-	/* Hack -- disabled */
-	if (!flow_by_sound) return;
-
-	/* Paranoia -- make sure the array is empty */
-	if (temp_n) return;
-
-	/* Cycle the old entries (once per 128 updates) */
-	if (flow_n == 255)
+	/* Add every player on the level to the queue */
+	for (i = 1; i <= NumPlayers; i++)
 	{
-		/* Rotate the time-stamps */
-		for (y = 0; y < cur_hgt; y++)
-		{
-			for (x = 0; x < cur_wid; x++)
-			{
-				int w = cave[y][x].when;
-				cave[y][x].when = (w > 128) ? (w - 128) : 0;
-			}
-		}
+		player_type *p_ptr = Players[i];
 
-		/* Restart */
-		flow_n = 127;
-	}
+		/* Skip players not on this level */
+		if (p_ptr->dun_depth != Depth) continue;
 
-	/* Start a new flow (never use "zero") */
-	flow_n++;
+		/* Hack -- notice death or departure */
+		if (!p_ptr->alive || p_ptr->death || p_ptr->new_level_flag) continue;
 
+		/* Hack -- skip shoppers and the dungeon master */
+		if (p_ptr->store_num != -1) continue;
+		if (p_ptr->dm_flags & DM_MONSTER_FRIEND) continue;
 
-	/* Reset the "queue" */
-	flow_head = flow_tail = 0;
+		/* Players may share a grid (not usually) */
+		if (f_ptr->cost[p_ptr->py][p_ptr->px] == 0) continue;
 
-	/* Add the player's grid to the queue */
-	update_flow_aux(py, px, 0);
+		f_ptr->cost[p_ptr->py][p_ptr->px] = 0;
+		flow_y[head] = p_ptr->py;
+		flow_x[head] = p_ptr->px;
+		head++;
+	}
 
 	/* Now process the queue */
-	while (flow_head != flow_tail)
+	while (tail < head)
 	{
 		/* Extract the next entry */
-		y = temp_y[flow_tail];
-		x = temp_x[flow_tail];
+		y = flow_y[tail];
+		x = flow_x[tail];
+		tail++;
 
-		/* Forget that entry */
-		if (++flow_tail == TEMP_MAX) flow_tail = 0;
+		/* Hack -- limit flow depth */
+		n = f_ptr->cost[y][x] + 1;
+		if (n > MONSTER_FLOW_DEPTH) continue;
 
 		/* Add the "children" */
 		for (d = 0; d < 8; d++)
 		{
-			/* Add that child if "legal" */
-			update_flow_aux(y+ddy_ddd[d], x+ddx_ddd[d], cave[y][x].cost+1);
+			int ny = y + ddy_ddd[d];
+			int nx = x + ddx_ddd[d];
+
+			/* Ignore illegal or already reached grids */
+			if (!in_bounds2(Depth, ny, nx)) continue;
+			if (f_ptr->cost[ny][nx] != FLOW_NONE) continue;
+
+			/* Ignore "walls" and "rubble" */
+			if (!flow_passable(Depth, ny, nx)) continue;
+
+			/* Save the flow cost */
+			f_ptr->cost[ny][nx] = n;
+
+			/* Enqueue that entry */
+			flow_y[head] = ny;
+			flow_x[head] = nx;
+			head++;
 		}
 	}
 
-	/* Forget the flow info */
-	flow_head = flow_tail = 0;
+	/* Remember when and for whom this was done */
+	f_ptr->sources = players_on_depth[Depth];
+	f_ptr->turn = turn;
+	f_ptr->stale = FALSE;
+}
 
-#endif
 
-}
+/*
+ * Get the "flow" information for a level, (re)computing it if needed.
+ *
+ * The costs are recomputed at most once per game turn, however many
+ * players moved or walls changed since the last time.  A change in
+ * the number of players on the level is noticed here, since players
+ * leaving the level do not always mark the old level's flow as stale.
+ */
+flow_type *level_flow(int Depth)
+{
+	flow_type *f_ptr = cave_flow[Depth];
+
+	/* Paranoia -- level not allocated */
+	if (!cave[Depth]) return (NULL);
+
+	/* First use of this level */
+	if (!f_ptr)
+	{
+		MAKE(cave_flow[Depth], flow_type);
+		f_ptr = cave_flow[Depth];
+		build_flow(Depth, f_ptr);
+		return (f_ptr);
+	}
 
+	/* Player arrived or left */
+	if (f_ptr->sources != players_on_depth[Depth]) f_ptr->stale = TRUE;
 
+	/* Recompute (once per turn) */
+	if (f_ptr->stale && !ht_eq(&f_ptr->turn, &turn)) build_flow(Depth, f_ptr);
 
+	return (f_ptr);
+}
 
 
 
@@ -3719,10 +3727,10 @@ void wiz_lite(player_type *p_ptr)
 			if (c_ptr->o_idx)
 			{
 				/* Wasn't seen, schedule list redraw */
-				if (!p_ptr->obj_vis[c_ptr->o_idx]) p_ptr->window |= (PW_ITEMLIST);
+				if (!vis_has(p_ptr->obj_vis, c_ptr->o_idx)) p_ptr->window |= (PW_ITEMLIST);
 
 				/* Memorize */
-				p_ptr->obj_vis[c_ptr->o_idx]= TRUE;
+				vis_on(p_ptr->obj_vis, c_ptr->o_idx);
 			}
 
 			/* Process all non-walls */
@@ -3795,10 +3803,10 @@ void wiz_dark(player_type *p_ptr)
 			if (c_ptr->o_idx)
 			{
 				/* Was known, schedule list redraw */
-				if (p_ptr->obj_vis[c_ptr->o_idx]) p_ptr->window |= (PW_ITEMLIST);
+				if (vis_has(p_ptr->obj_vis, c_ptr->o_idx)) p_ptr->window |= (PW_ITEMLIST);
 
 				/* Forget the object */
-				p_ptr->obj_vis[c_ptr->o_idx] = FALSE;
+				vis_off(p_ptr->obj_vis, c_ptr->o_idx);
 			}
 		}
 	}
@@ -3925,13 +3933,63 @@ void mmove2(int *y, int *x, int y1, int x1, int y2, int x2)
 
 
 /*
- * Determine if a bolt spell cast from (y1,x1) to (y2,x2) will arrive
- * at the final destination, assuming no monster gets in the way.
+ * Size of the "projectable()" cache (a power of two)
+ */
+#define PROJ_CACHE_SIZE	1024
+
+typedef struct proj_cache_type proj_cache_type;
+
+/*
+ * A remembered "projectable()" or "projectable_wall()" answer.
  *
- * This is slightly (but significantly) different from "los(y1,x1,y2,x2)".
+ * Monsters ask about the same players every game turn (when picking
+ * spells, and again when casting them), so the answers are kept for
+ * the rest of the turn, unless some wall changes in the meantime.
  */
-bool projectable(int Depth, int y1, int x1, int y2, int x2)
+struct proj_cache_type
 {
+	s16b Depth;
+	byte y1, x1;
+	byte y2, x2;
+	byte kind;		/* 0 = "projectable()", 1 = "projectable_wall()" */
+	bool result;
+
+	hturn turn;		/* Turn of the query */
+	u32b epoch;		/* Value of "wall_epoch" at the time */
+};
+
+static proj_cache_type proj_cache[PROJ_CACHE_SIZE];
+
+
+/*
+ * Find the cache slot for a query
+ */
+static proj_cache_type *proj_cache_slot(int Depth, int y1, int x1, int y2, int x2, int kind)
+{
+	u32b h;
+
+	h = (u32b)(Depth + MAX_WILD);
+	h = h * 31 + (u32b)y1;
+	h = h * 31 + (u32b)x1;
+	h = h * 31 + (u32b)y2;
+	h = h * 31 + (u32b)x2;
+	h = h * 2 + (u32b)kind;
+	h ^= (h >> 13);
+	h *= 0x9E3779B1L;
+
+	return (&proj_cache[(h >> 16) & (PROJ_CACHE_SIZE - 1)]);
+}
+
+
+/*
+ * Trace a bolt from (y1,x1) towards (y2,x2), see "project()".
+ *
+ * If "arena" is set, arena walls block the bolt too, and the final
+ * destination may be a wall.
+ */
+static bool projectable_aux(int Depth, int y1, int x1, int y2, int x2, bool arena)
+{
+	wall_type *w_ptr = level_walls(Depth);
 	int dist, y, x;
 
 	/* Start at the initial location */
@@ -3940,8 +3998,18 @@ bool projectable(int Depth, int y1, int x1, int y2, int x2)
 	/* See "project()" */
 	for (dist = 0; dist <= MAX_RANGE; dist++)
 	{
-		/* Never pass through walls */
-		if (dist && !cave_floor_bold(Depth, y, x)) break;
+		/* Targets in walls are allowed */
+		if (arena && (x == x2) && (y == y2)) return (TRUE);
+
+		if (dist)
+		{
+			/* HACK -- Never go through walls -- ARENA WALLS */
+			if (arena && (!w_ptr || w_ptr->arena) &&
+			    cave[Depth][y][x].feat == FEAT_PVP_ARENA) break;
+
+			/* Never pass through walls */
+			if (los_wall(w_ptr, Depth, y, x)) break;
+		}
 
 		/* Check for arrival at "final target" */
 		if ((x == x2) && (y == y2)) return (TRUE);
@@ -3950,39 +4018,65 @@ bool projectable(int Depth, int y1, int x1, int y2, int x2)
 		mmove2(&y, &x, y1, x1, y2, x2);
 	}
 
-
 	/* Assume obstruction */
 	return (FALSE);
 }
 
 
-/* The same function... but with target in a wall (for player ghosts)
- * Used by monsters... otherwise player ghosts would be safe from monster spells! */
-bool projectable_wall(int Depth, int y1, int x1, int y2, int x2)
+/*
+ * Answer a "projectable()" query, using the cache if possible
+ */
+static bool projectable_cached(int Depth, int y1, int x1, int y2, int x2, int kind)
 {
-	int dist, y, x;
+	proj_cache_type *q_ptr;
 
-	/* Start at the initial location */
-	y = y1, x = x1;
+	/* Levels being generated have no board (and change a lot) */
+	if (!server_dungeon) return (projectable_aux(Depth, y1, x1, y2, x2, kind));
 
-	/* See "project()" */
-	for (dist = 0; dist <= MAX_RANGE; dist++)
+	/* Find the slot */
+	q_ptr = proj_cache_slot(Depth, y1, x1, y2, x2, kind);
+
+	/* Still valid */
+	if ((q_ptr->Depth == Depth) && (q_ptr->kind == kind) &&
+	    (q_ptr->y1 == y1) && (q_ptr->x1 == x1) &&
+	    (q_ptr->y2 == y2) && (q_ptr->x2 == x2) &&
+	    (q_ptr->epoch == wall_epoch) && ht_eq(&q_ptr->turn, &turn))
 	{
-		/* Check for arrival at "final target" */
-		if ((x == x2) && (y == y2)) return (TRUE);
+		return (q_ptr->result);
+	}
 
-		/* HACK -- Never go through walls -- ARENA WALLS */
-		if (dist && cave[Depth][y][x].feat ==  FEAT_PVP_ARENA) break;
+	/* Remember the answer */
+	q_ptr->result = projectable_aux(Depth, y1, x1, y2, x2, kind);
+	q_ptr->Depth = Depth;
+	q_ptr->kind = kind;
+	q_ptr->y1 = y1;
+	q_ptr->x1 = x1;
+	q_ptr->y2 = y2;
+	q_ptr->x2 = x2;
+	q_ptr->epoch = wall_epoch;
+	q_ptr->turn = turn;
+
+	return (q_ptr->result);
+}
 
-		/* Never go through walls */
-		if (dist && !cave_floor_bold(Depth, y, x)) break;
 
-		/* Calculate the new location */
-		mmove2(&y, &x, y1, x1, y2, x2);
-	}
+/*
+ * Determine if a bolt spell cast from (y1,x1) to (y2,x2) will arrive
+ * at the final destination, assuming no monster gets in the way.
+ *
+ * This is slightly (but significantly) different from "los(y1,x1,y2,x2)".
+ */
+bool projectable(int Depth, int y1, int x1, int y2, int x2)
+{
+	return (projectable_cached(Depth, y1, x1, y2, x2, 0));
+}
 
-	/* Assume obstruction */
-	return (FALSE);
+
+/* The same function... but with target in a wall (for player ghosts)
+ * Used by monsters... otherwise player ghosts would be safe from monster spells! */
+bool projectable_wall(int Depth, int y1, int x1, int y2, int x2)
+{
+	return (projectable_cached(Depth, y1, x1, y2, x2, 1));
 }
 
 
@@ -769,7 +769,7 @@ void carry(player_type *p_ptr, int pickup, int confirm)
 							q_ptr = Players[i];
 							if (obj_own_p(q_ptr,o_ptr))
 							{
-								okay = p_ptr->play_los[i];
+								okay = vis_has(p_ptr->play_los, i);
 								break;
 							}
 						}
@@ -1224,7 +1224,7 @@ void py_attack_player(player_type *p_ptr, int y, int x)
 	my_strcpy(pvp_name, q_ptr->name, 80);
 
 	/* Track player health */
-	if (p_ptr->play_vis[0 - c_ptr->m_idx]) health_track(p_ptr, c_ptr->m_idx);
+	if (vis_has(p_ptr->play_vis, 0 - c_ptr->m_idx)) health_track(p_ptr, c_ptr->m_idx);
 
 	/* Handle attacker fear */
 	if (p_ptr->afraid)
@@ -1389,10 +1389,10 @@ void py_attack_mon(player_type *p_ptr, int y, int x)
 
 
 	/* Auto-Recall if possible and visible */
-	if (p_ptr->mon_vis[c_ptr->m_idx]) monster_race_track(p_ptr, m_ptr->r_idx);
+	if (vis_has(p_ptr->mon_vis, c_ptr->m_idx)) monster_race_track(p_ptr, m_ptr->r_idx);
 
 	/* Track a new monster */
-	if (p_ptr->mon_vis[c_ptr->m_idx]) health_track(p_ptr, c_ptr->m_idx);
+	if (vis_has(p_ptr->mon_vis, c_ptr->m_idx)) health_track(p_ptr, c_ptr->m_idx);
 
 
 	/* Handle player fear */
@@ -1407,7 +1407,7 @@ void py_attack_mon(player_type *p_ptr, int y, int x)
 
 	if (p_ptr->cp_ptr->flags & CF_BACK_STAB)
 	{
-		if (p_ptr->mon_vis[c_ptr->m_idx])
+		if (vis_has(p_ptr->mon_vis, c_ptr->m_idx))
 		{
 			if (m_ptr->csleep) backstab = TRUE;
 			else if (m_ptr->monfear) stab_fleeing = TRUE;
@@ -1438,7 +1438,7 @@ void py_attack_mon(player_type *p_ptr, int y, int x)
 		p_ptr->dealt_blows++;
 
 		/* Test for hit */
-		if (test_hit_norm(chance, r_ptr->ac, p_ptr->mon_vis[c_ptr->m_idx]))
+		if (test_hit_norm(chance, r_ptr->ac, vis_has(p_ptr->mon_vis, c_ptr->m_idx)))
 		{
 			/* Message */
 			if ((!backstab) && (!stab_fleeing))
@@ -1462,7 +1462,7 @@ void py_attack_mon(player_type *p_ptr, int y, int x)
 			if (o_ptr->k_idx)
 			{
 				k = damroll(o_ptr->dd, o_ptr->ds);
-				k = tot_dam_aux(p_ptr, o_ptr, k, m_ptr, p_ptr->mon_vis[c_ptr->m_idx]);
+				k = tot_dam_aux(p_ptr, o_ptr, k, m_ptr, vis_has(p_ptr->mon_vis, c_ptr->m_idx));
 				if (backstab)
 				{
 					backstab = FALSE;
@@ -1504,7 +1504,7 @@ void py_attack_mon(player_type *p_ptr, int y, int x)
 				/* Confuse the monster */
 				if (r_ptr->flags3 & RF3_NO_CONF)
 				{
-					if (p_ptr->mon_vis[c_ptr->m_idx]) l_ptr->flags3 |= RF3_NO_CONF;
+					if (vis_has(p_ptr->mon_vis, c_ptr->m_idx)) l_ptr->flags3 |= RF3_NO_CONF;
 					msg_format(p_ptr, "%^s is unaffected.", m_name);
 				}
 				else if (randint0(100) < r_ptr->level)
@@ -1547,7 +1547,7 @@ void py_attack_mon(player_type *p_ptr, int y, int x)
 
 
 	/* Hack -- delay fear messages */
-	if (fear && p_ptr->mon_vis[c_ptr->m_idx] && !(r_ptr->flags2 & RF2_WANDERER))
+	if (fear && vis_has(p_ptr->mon_vis, c_ptr->m_idx) && !(r_ptr->flags2 & RF2_WANDERER))
 	{
 		/* Sound */
 		sound(p_ptr, MSG_FLEE);
@@ -2494,14 +2494,14 @@ static bool run_test(player_type *p_ptr)
 		if (c_ptr->m_idx > 0)
 		{
 			/* Visible monster */
-			if (p_ptr->mon_vis[c_ptr->m_idx]) return (TRUE);
+			if (vis_has(p_ptr->mon_vis, c_ptr->m_idx)) return (TRUE);
 		}
 
 		/* Visible objects abort running */
 		if (c_ptr->o_idx)
 		{
 			/* Visible object */
-			if (p_ptr->obj_vis[c_ptr->o_idx]) return (TRUE);
+			if (vis_has(p_ptr->obj_vis, c_ptr->o_idx)) return (TRUE);
 		}
 
 		/* Hack -- always stop in water */
@@ -642,6 +642,7 @@ bool create_house_door(player_type *p_ptr, int x, int y)
 			houses[house].door_x = x;
 			c_ptr = &cave[p_ptr->dun_depth][y][x];
 			c_ptr->feat = FEAT_HOME_HEAD;
+			update_wall_spot(p_ptr->dun_depth, y, x);
 			everyone_lite_spot(p_ptr->dun_depth, y, x);
 			msg_print(p_ptr, "You create a door for your house!");
 			return TRUE;
@@ -852,6 +853,7 @@ bool create_house(player_type *p_ptr)
 			if( c_ptr->feat < FEAT_HOME_HEAD || c_ptr->feat > FEAT_HOME_TAIL)
 			{
 				c_ptr->feat = FEAT_PERM_EXTRA;
+				update_wall_spot(p_ptr->dun_depth, y, x);
 			}
 			
 			/* Update the spot */
@@ -870,6 +872,7 @@ bool create_house(player_type *p_ptr)
 
 			/* Fill with floor */
 			c_ptr->feat = FEAT_FLOOR;
+			update_wall_spot(p_ptr->dun_depth, y, x);
 
 			/* Make it "icky" */
 			c_ptr->info |= CAVE_ICKY;
@@ -934,6 +937,7 @@ void disown_house(int house)
 
 		/* Close the door */
 		c_ptr->feat = FEAT_HOME_HEAD + houses[house].strength;
+		update_wall_spot(Depth, houses[house].door_y, houses[house].door_x);
 
 		/* Reshow */
 		everyone_lite_spot(Depth, houses[house].door_y, houses[house].door_x);
@@ -1238,6 +1242,7 @@ static bool do_cmd_open_aux(player_type *p_ptr, int y, int x)
 
 			/* Open the door */
 			c_ptr->feat = FEAT_HOME_OPEN;
+			update_wall_spot(Depth, y, x);
 
 			/* Notice */
 			note_spot_depth(Depth, y, x);
@@ -1346,6 +1351,7 @@ static bool do_cmd_open_aux(player_type *p_ptr, int y, int x)
 		/* Open the door */
 		/*cave_set_feat(y, x, FEAT_OPEN);*/
 		c_ptr->feat = FEAT_OPEN;
+		update_wall_spot(Depth, y, x);
 
 		/* Notice */
 		note_spot_depth(Depth, y, x);
@@ -1588,6 +1594,7 @@ static bool do_cmd_close_aux(player_type *p_ptr, int y, int x)
 
 		/* Close the door */
 		c_ptr->feat = FEAT_HOME_HEAD + houses[i].strength;
+		update_wall_spot(Depth, y, x);
 
 		/* Notice */
 		note_spot_depth(Depth, y, x);
@@ -1604,6 +1611,7 @@ static bool do_cmd_close_aux(player_type *p_ptr, int y, int x)
 	{
 		/* Close the door */
 		c_ptr->feat = FEAT_DOOR_HEAD + 0x00;
+		update_wall_spot(Depth, y, x);
 
 		/* Notice */
 		note_spot_depth(Depth, y, x);
@@ -2507,6 +2515,9 @@ static bool do_cmd_bash_aux(player_type *p_ptr, int y, int x)
 			c_ptr->feat = FEAT_OPEN;
 		}
 
+		/* Update the walls */
+		update_wall_spot(Depth, y, x);
+
 		/* Notice */
 		note_spot_depth(Depth, y, x);
 
@@ -3752,7 +3763,7 @@ void do_cmd_fire(player_type *p_ptr, int item, int dir)
 			}
 
 			/* Check the visibility */
-			visible = p_ptr->play_vis[0 - c_ptr->m_idx];
+			visible = vis_has(p_ptr->play_vis, 0 - c_ptr->m_idx);
 
 			/* Note the collision */
 			hit_body = TRUE;
@@ -3813,7 +3824,7 @@ void do_cmd_fire(player_type *p_ptr, int item, int dir)
 			monster_race *r_ptr = &r_info[m_ptr->r_idx];
 
 			/* Check the visibility */
-			visible = p_ptr->mon_vis[c_ptr->m_idx];
+			visible = vis_has(p_ptr->mon_vis, c_ptr->m_idx);
 
 			/* Note the collision */
 			hit_body = TRUE;
@@ -3863,7 +3874,7 @@ void do_cmd_fire(player_type *p_ptr, int item, int dir)
 				}
 
 				/* Apply special damage XXX XXX XXX */
-				tdam = tot_dam_aux(p_ptr, o_ptr, tdam, m_ptr, p_ptr->mon_vis[c_ptr->m_idx]);
+				tdam = tot_dam_aux(p_ptr, o_ptr, tdam, m_ptr, vis_has(p_ptr->mon_vis, c_ptr->m_idx));
 				tdam = critical_shot(p_ptr, o_ptr->weight, o_ptr->to_h, tdam);
 
 				/* No negative damage */
@@ -4188,7 +4199,7 @@ void do_cmd_throw(player_type *p_ptr, int item, int dir)
 			q_ptr = Players[0 - c_ptr->m_idx];
 
 			/* Check the visibility */
-			visible = p_ptr->play_vis[0 - c_ptr->m_idx];
+			visible = vis_has(p_ptr->play_vis, 0 - c_ptr->m_idx);
 
 			/* Note the collision */
 			hit_body = TRUE;
@@ -4259,7 +4270,7 @@ void do_cmd_throw(player_type *p_ptr, int item, int dir)
 			monster_race *r_ptr = &r_info[m_ptr->r_idx];
 
 			/* Check the visibility */
-			visible = p_ptr->mon_vis[c_ptr->m_idx];
+			visible = vis_has(p_ptr->mon_vis, c_ptr->m_idx);
 
 			/* Note the collision */
 			hit_body = TRUE;
@@ -4309,7 +4320,7 @@ void do_cmd_throw(player_type *p_ptr, int item, int dir)
 				}
 
 				/* Apply special damage XXX XXX XXX */
-				tdam = tot_dam_aux(p_ptr, o_ptr, tdam, m_ptr, p_ptr->mon_vis[c_ptr->m_idx]);
+				tdam = tot_dam_aux(p_ptr, o_ptr, tdam, m_ptr, vis_has(p_ptr->mon_vis, c_ptr->m_idx));
 				tdam = critical_shot(p_ptr, o_ptr->weight, o_ptr->to_h, tdam);
 
 				/* No negative damage */
@@ -4528,6 +4539,7 @@ void do_cmd_purchase_house(player_type *p_ptr, int dir)
 
 		/* Open the door */
 		c_ptr->feat = FEAT_HOME_OPEN;
+		update_wall_spot(Depth, y, x);
 
 		/* Reshow */
 		everyone_lite_spot(Depth, y, x);
@@ -246,6 +246,126 @@ static void console_conn(connection_type* ct, char *useless)
 	}
 }
 
+/*
+ * Report traffic and time spent, per packet type
+ */
+static void console_traffic(connection_type* ct, char *params)
+{
+	packet_stat *in = server_pkt_in, *cmd = server_pkt_cmd, *out = server_pkt_out;
+	s64b total_in = 0, total_out = 0, total_usec = 0;
+	int i, len;
+
+	/* Start counting anew */
+	if (params && streq(params, "reset"))
+	{
+		C_WIPE(server_pkt_in, 256, packet_stat);
+		C_WIPE(server_pkt_cmd, 256, packet_stat);
+		C_WIPE(server_pkt_out, 256, packet_stat);
+		for (i = 1; i <= NumPlayers; i++) reset_packet_stats(Players[i]);
+		cq_printf(&ct->wbuf, "%T", "Traffic statistics reset\n");
+		return;
+	}
+
+	/* Find this player */
+	if (params && params[0])
+	{
+		player_type *p_ptr = NULL;
+		for (i = 1; i <= NumPlayers; i++)
+		{
+			len = strlen(Players[i]->name);
+			if (!my_strnicmp(Players[i]->name, params, len))
+			{
+				p_ptr = Players[i];
+				break;
+			}
+		}
+		if (!p_ptr)
+		{
+			cq_printf(&ct->wbuf, "%T", "No such player\n");
+			return;
+		}
+		in = p_ptr->pkt_in;
+		cmd = p_ptr->pkt_cmd;
+		out = p_ptr->pkt_out;
+		cq_printf(&ct->wbuf, "%T", format("Traffic of %s\n", p_ptr->name));
+	}
+	else cq_printf(&ct->wbuf, "%T", "Traffic of all players\n");
+
+	cq_printf(&ct->wbuf, "%T", "PKT   IN: count      bytes      usec  CMD: count      usec  OUT: count      bytes\n");
+	for (i = 0; i < 256; i++)
+	{
+		if (!in[i].count && !cmd[i].count && !out[i].count && !out[i].bytes) continue;
+
+		cq_printf(&ct->wbuf, "%T", format("%3d %11lu %10ld %9ld %10lu %9ld %10lu %10ld\n", i,
+			(unsigned long)in[i].count, (long)in[i].bytes, (long)in[i].usec,
+			(unsigned long)cmd[i].count, (long)cmd[i].usec,
+			(unsigned long)out[i].count, (long)out[i].bytes));
+
+		total_in += in[i].bytes;
+		total_out += out[i].bytes;
+		total_usec += in[i].usec + cmd[i].usec;
+	}
+	cq_printf(&ct->wbuf, "%T", format("Total: %ld bytes in, %ld bytes out, %ld usec\n",
+		(long)total_in, (long)total_out, (long)total_usec));
+}
+
+/*
+ * Report output compression ratio and cost, per player
+ */
+static void console_zstat(connection_type* ct, char *useless)
+{
+	s64b plain = 0, wire = 0, usec = 0;
+	int k;
+
+	cq_printf(&ct->wbuf, "%T", format("Output compression is %s (level %d)\n",
+		cfg_compress_output ? "on" : "off", cfg_compress_output));
+
+	for (k = 1; k <= NumPlayers; k++)
+	{
+		player_type *p_ptr = Players[k];
+		connection_type *c_ptr = PConn[k];
+
+		if (!c_ptr || !c_ptr->zout) continue;
+
+		cq_printf(&ct->wbuf, "%T", format("%s: %ld -> %ld bytes (%d%%), %ld usec (%ld usec/Kb)\n",
+			p_ptr->name, (long)c_ptr->z_plain, (long)c_ptr->z_wire,
+			c_ptr->z_plain ? (int)(c_ptr->z_wire * 100 / c_ptr->z_plain) : 100,
+			(long)c_ptr->z_usec,
+			c_ptr->z_plain ? (long)(c_ptr->z_usec * 1024 / c_ptr->z_plain) : 0L));
+
+		plain += c_ptr->z_plain;
+		wire += c_ptr->z_wire;
+		usec += c_ptr->z_usec;
+	}
+
+	cq_printf(&ct->wbuf, "%T", format("Total: %ld -> %ld bytes (%d%%), %ld usec\n",
+		(long)plain, (long)wire, plain ? (int)(wire * 100 / plain) : 100, (long)usec));
+}
+
+/*
+ * Report how well the game clock keeps up with FPS
+ */
+static void console_ticks(connection_type* ct, char *params)
+{
+	timer_type *timer = tick_timer;
+	long late_avg = 0;
+
+	/* Start counting anew */
+	if (params && streq(params, "reset"))
+	{
+		timer_reset_stats(timer);
+		cq_printf(&ct->wbuf, "%T", "Tick statistics reset\n");
+		return;
+	}
+
+	if (timer->fired) late_avg = (long)(timer->late_total / timer->fired);
+
+	cq_printf(&ct->wbuf, "%T", format("%d ticks during last second, FPS is %d\n",
+		last_ticks, cfg_fps));
+	cq_printf(&ct->wbuf, "%T", format("%lu ticks late by %ld usec (last), %ld usec (avg), %ld usec (max)\n",
+		(unsigned long)timer->fired, (long)timer->late_last, late_avg, (long)timer->late_max));
+}
+
 /*
  * Utility function, change locally as required when testing
  */
@@ -491,6 +611,91 @@ static void console_dng_test(connection_type* ct, char *params)
 	cq_printf(&ct->wbuf, "%T", "Done\n");
 }
 
+#ifdef DEBUG
+/*
+ * Pathfinder benchmark -- walk on any open grid
+ */
+static bool pf_test_pass(vptr data, int y, int x)
+{
+	int Depth = *(int *)data;
+
+	return (cave_floor_bold(Depth, y, x));
+}
+
+/*
+ * Time N random searches of the pathfinder on a dungeon level.
+ */
+static void console_pf_test(connection_type* ct, char *params)
+{
+	byte path[MAX_PF_LENGTH];
+	int rep = 1000;
+	int Depth = 1;
+	int i, n, y1, x1, y2, x2;
+	int found = 0, steps = 0;
+	bool made = FALSE;
+	s64b start, usec;
+
+	char *param1 = (params ? strtok(params, " ") : NULL);
+	char *param2 = (param1 ? strtok(NULL, " ") : NULL);
+	if (param1) rep = atoi(param1);
+	if (param2) Depth = atoi(param2);
+
+	if ((rep < 1) || (Depth < 1) || (Depth >= MAX_DEPTH))
+	{
+		cq_printf(&ct->wbuf, "%T", "Invalid argument\n");
+		return;
+	}
+
+	/* Generate a level to test on */
+	if (!cave[Depth])
+	{
+		if (NumPlayers > 0)
+		{
+			cq_printf(&ct->wbuf, "%T", "Can't generate a level with players online!\n");
+			return;
+		}
+
+		alloc_dungeon_level(Depth);
+		generate_cave(0, Depth, TRUE);
+		made = TRUE;
+	}
+
+	start = monotonic_timer();
+
+	for (i = 0; i < rep; i++)
+	{
+		/* Pick two open grids not too far apart */
+		do
+		{
+			y1 = rand_range(1, MAX_HGT - 2);
+			x1 = rand_range(1, MAX_WID - 2);
+		}
+		while (!cave_floor_bold(Depth, y1, x1));
+
+		do
+		{
+			y2 = y1 + rand_spread(0, MAX_PF_RADIUS / 2 - 1);
+			x2 = x1 + rand_spread(0, MAX_PF_RADIUS / 2 - 1);
+		}
+		while (!in_bounds(Depth, y2, x2) || !cave_floor_bold(Depth, y2, x2));
+
+		n = path_search(Depth, y1, x1, y2, x2, pf_test_pass, (vptr)&Depth, path, MAX_PF_LENGTH);
+		if (n < 0) continue;
+
+		found++;
+		steps += n;
+	}
+
+	usec = monotonic_timer() - start;
+
+	cq_printf(&ct->wbuf, "%T", format("%d searches on level %d: %d found (%d steps avg), %ld usec (%ld usec each)\n",
+		rep, Depth, found, found ? steps / found : 0, (long)usec, (long)(usec / rep)));
+
+	/* Forget the test level */
+	if (made) dealloc_dungeon_level(Depth);
+}
+#endif
+
 static void console_reload(connection_type* ct, char *mod)
 {
 	bool done = FALSE;
@@ -609,8 +814,12 @@ console_command_ops console_commands[] = {
 	{ "reload",    console_reload,      1, "config|news\nReload mangband.cfg or news.txt"     },
 	{ "whois",     console_whois,       1, "PLAYERNAME\nDetailed player information"          },
 	{ "rngtest",   console_rng_test,    0, "\nPerform RNG test"                               },
+	{ "ticks",     console_ticks,       0, "[reset]\nDisplay game clock jitter"                },
+	{ "traffic",   console_traffic,     0, "[reset|PLAYERNAME]\nDisplay traffic per packet type" },
+	{ "zstat",     console_zstat,       0, "\nDisplay output compression ratio and cost"     },
 #ifdef DEBUG
 	{ "dngtest",   console_dng_test,    2, "[N] [DEPTH]\nGenerate dungeon N times"            },
+	{ "pftest",    console_pf_test,     2, "[N] [DEPTH]\nTime N pathfinder searches"        },
 #endif
 	{ "debug",     console_debug,       0, "\nUnused"                                         },
 };
@@ -381,60 +381,67 @@ static void regenmana(player_type *p_ptr, int percent)
  */
 static void regen_monsters(void)
 {
-	int i, frac;
+	int i, k, pl, frac;
 	int time, timefactor;
 
-	/* Regenerate everyone */
-	for (i = 1; i < m_max; i++)
+	/* Regenerate everyone on the populated levels */
+	for (pl = 1; pl <= NumPlayers; pl++)
 	{
-		/* Check the i'th monster */
-		monster_type *m_ptr = &m_list[i];
-		monster_race *r_ptr = &r_info[m_ptr->r_idx];
+		int Depth = Players[pl]->dun_depth;
 
-		/* Skip dead monsters */
-		if (!m_ptr->r_idx) continue;
+		/* Skip levels already handled */
+		for (k = 1; k < pl; k++)
+			if (Players[k]->dun_depth == Depth) break;
+		if (k < pl) continue;
 
-		/* Check if it's time to regenerate */
+		for (i = m_depth_first[Depth]; i; i = m_depth_next[i])
+		{
+			/* Check the i'th monster */
+			monster_type *m_ptr = &m_list[i];
+			monster_race *r_ptr = &r_info[m_ptr->r_idx];
+
+			/* Check if it's time to regenerate */
 
-		/* Determine basic frequency of regen in game turns */
-		time = 100; /* Default is every 100 turns (level_speed(m_ptr->dun_depth)/1000) */;
+			/* Determine basic frequency of regen in game turns */
+			time = 100; /* Default is every 100 turns (level_speed(m_ptr->dun_depth)/1000) */;
 		
-		/* Scale frequency by players local time bubble */
-		if (m_ptr->closest_player > 0 && m_ptr->closest_player <= NumPlayers)
-		{
-			timefactor = base_time_factor(Players[m_ptr->closest_player], 0);
-			time = time / ((float)timefactor / 100);
-		}
+			/* Scale frequency by players local time bubble */
+			if (m_ptr->closest_player > 0 && m_ptr->closest_player <= NumPlayers)
+			{
+				timefactor = base_time_factor(Players[m_ptr->closest_player]);
+				time = time / ((float)timefactor / 100);
+			}
 
-		/* Not yet */
-		if ((turn.turn % time)) continue;
+			/* Not yet */
+			if ((turn.turn % time)) continue;
 
-		/* Allow regeneration (if needed) */
-		if (m_ptr->hp < m_ptr->maxhp)
-		{
-			/* Hack -- Base regeneration */
-			frac = m_ptr->maxhp / 100;
+			/* Allow regeneration (if needed) */
+			if (m_ptr->hp < m_ptr->maxhp)
+			{
+				/* Hack -- Base regeneration */
+				frac = m_ptr->maxhp / 100;
 
-			/* Hack -- Minimal regeneration rate */
-			if (!frac) frac = 1;
+				/* Hack -- Minimal regeneration rate */
+				if (!frac) frac = 1;
 
-			/* Hack -- Some monsters regenerate quickly */
-			if (r_ptr->flags2 & RF2_REGENERATE) frac *= 2;
+				/* Hack -- Some monsters regenerate quickly */
+				if (r_ptr->flags2 & RF2_REGENERATE) frac *= 2;
 
-			/* Hack -- Regenerate */
-			m_ptr->hp += frac;
+				/* Hack -- Regenerate */
+				m_ptr->hp += frac;
 
-			/* Do not over-regenerate */
-			if (m_ptr->hp > m_ptr->maxhp) m_ptr->hp = m_ptr->maxhp;
+				/* Do not over-regenerate */
+				if (m_ptr->hp > m_ptr->maxhp) m_ptr->hp = m_ptr->maxhp;
 
-			/* Update health bars */
-			update_health(i);
-		}
-		/* HACK !!! Act like nobody ever hurt this monster */
-		else
-		{
-			for (frac = 1; frac <= NumPlayers; frac++)
-				Players[frac]->mon_hrt[i] = FALSE;
+				/* Update health bars */
+				update_health(i);
+			}
+			/* HACK !!! Act like nobody ever hurt this monster */
+			else
+			{
+				for (frac = 1; frac <= NumPlayers; frac++)
+					vis_off(Players[frac]->mon_hrt, i);
+			}
 		}
 	}
 }
@@ -806,7 +813,7 @@ static int auto_retaliate(player_type *p_ptr)
 			if (c_ptr->m_idx < 0)
 			{
 				/* Skip players we cannot see */
-				if (!p_ptr->play_vis[0 - c_ptr->m_idx]) continue;
+				if (!vis_has(p_ptr->play_vis, 0 - c_ptr->m_idx)) continue;
 
 				/* If they are hostile, they are a fair target */
 				if (pvp_okay(p_ptr, Players[0 - c_ptr->m_idx], 1))
@@ -825,7 +832,7 @@ static int auto_retaliate(player_type *p_ptr)
 			else if(c_ptr->m_idx)
 			{
 				/* Make sure that the player can see this monster */
-				if (!p_ptr->mon_vis[c_ptr->m_idx]) continue;
+				if (!vis_has(p_ptr->mon_vis, c_ptr->m_idx)) continue;
 				
 				targetlist[targets++] = i;
 				if(p_ptr->health_who == c_ptr->m_idx)
@@ -1050,7 +1057,7 @@ static void process_player_end(player_type *p_ptr)
 	}
 
 	/* If we are are in a slow time condition, give visual warning */
-	timefactor = base_time_factor(p_ptr, 0);
+	timefactor = base_time_factor(p_ptr);
 	if(timefactor < NORMAL_TIME)
 	{
 		/* Paranoia: cave pointer not set */
@@ -1183,16 +1190,7 @@ static void process_player_end(player_type *p_ptr)
 	if ( !(turn.turn % time) )
 	{
 		/* Hack -- Fade monster Detect over time */
-		for (i = 0; i < m_max; i++)
-		{
-			if (p_ptr->mon_det[i])
-			{
-				if (--p_ptr->mon_det[i] == 0) 
-				{
-					update_mon(i, FALSE);
-				}
-			}
-		}
+		fade_monster_detection(p_ptr);
 		/* Hack -- Fade player Detect over time */
 		for (i = 1; i <= NumPlayers; i++)
 		{
@@ -1895,6 +1893,7 @@ static void process_various(void)
 
 			/* Grow a tree here */
 			c_ptr->feat = FEAT_TREE;
+			update_wall_spot(0, y, x);
 			trees_in_town++;
 
 			/* Show it */
@@ -2012,7 +2011,7 @@ static void process_various(void)
 
 void dungeon(void)
 {
-	int i, d, j;
+	int i, d, j, next_m_idx;
 	byte *w_ptr;
 	cave_type *c_ptr;
 	int dy, dx;
@@ -2217,13 +2216,13 @@ void dungeon(void)
 			case LEVEL_RAND:
 
 				/* Remove nearby hounds */
-				for (j = 1; j < m_max; j++)
+				for (j = m_depth_first[Depth]; j; j = next_m_idx)
 				{
 					monster_type	*m_ptr = &m_list[j];
 					monster_race	*r_ptr = &r_info[m_ptr->r_idx];
-		
-					/* Paranoia -- Skip dead monsters */
-					if (!m_ptr->r_idx) continue;
+
+					/* Get the next monster (this one may be deleted) */
+					next_m_idx = m_depth_next[j];
 
 					/* Hack -- Skip Unique Monsters */
 					if (r_ptr->flags1 & RF1_UNIQUE) continue;
@@ -2231,9 +2230,6 @@ void dungeon(void)
 					/* Skip monsters other than hounds */
 					if (r_ptr->d_char != 'Z') continue;
 
-					/* Skip monsters not on this depth */
-					if (p_ptr->dun_depth != m_ptr->dun_depth) continue;
-
 					/* Approximate distance */
 					dy = (p_ptr->py > m_ptr->fy) ? (p_ptr->py - m_ptr->fy) : (m_ptr->fy - p_ptr->py);
 					dx = (p_ptr->px > m_ptr->fx) ? (p_ptr->px - m_ptr->fx) : (m_ptr->fx - p_ptr->px);
@@ -2307,6 +2303,9 @@ void dungeon(void)
 	///*** BEGIN NEW TURN ***///
 	ht_add(&turn,1);
 
+	/* Work out everybody's time bubble for this turn */
+	update_time_bubbles();
+
 	/* Do some beginning of turn processing for each player */
 	for (i = 1; i <= NumPlayers; i++)
 	{
@@ -2511,6 +2510,13 @@ void play_game(bool new_game)
 	/* Finish initializing dungeon objects */
 	setup_objects();
 
+	/* Start the level threads */
+	if (cfg_level_threads)
+	{
+		cfg_level_threads = level_threads_start(cfg_level_threads);
+		if (!cfg_level_threads) plog("Unable to start level threads, running without them");
+	}
+
 	/* Server initialization is now "complete" */
 	server_generated = TRUE;
 }
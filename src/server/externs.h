@@ -149,8 +149,8 @@ extern bool scan_objects;
 extern s16b inven_nxt;
 /*extern s16b inven_cnt;
 extern s16b equip_cnt;*/
-extern s32b o_nxt;
-extern s32b m_nxt;
+extern s32b o_free_num;
+extern s32b m_free;
 extern s32b o_max;
 extern s32b m_max;
 extern s32b o_top;
@@ -168,6 +168,10 @@ extern char * cfg_dungeon_master;
 extern char * cfg_load_pref_file;
 extern bool cfg_secret_dungeon_master;
 extern s16b cfg_fps;
+extern bool cfg_cork_output;
+extern s16b cfg_compress_output;
+extern bool cfg_network_thread;
+extern s16b cfg_level_threads;
 extern s32b cfg_tcp_port;
 extern bool cfg_safe_recharge;
 extern bool cfg_no_steal;
@@ -268,10 +272,19 @@ extern u32b window_flag[8];
 extern u32b window_mask[8];*/
 /*extern term *ang_term[8];*/
 extern s16b o_fast[MAX_O_IDX];
-extern s16b m_fast[MAX_M_IDX];
-extern cave_type ***cave;
+extern s16b o_free[MAX_O_IDX];
+extern s16b *o_depth_first;
+extern s16b o_depth_next[MAX_O_IDX];
+extern s16b o_depth_prev[MAX_O_IDX];
+extern s16b *m_depth_first;
+extern s16b m_depth_next[MAX_M_IDX];
+extern s16b m_depth_prev[MAX_M_IDX];
+extern cave_row **cave;
 extern wilderness_type *wild_info;
 extern hturn *turn_cavegen;
+extern flow_type **cave_flow;
+extern wall_type **cave_wall;
+extern u32b *view_epoch;
 extern object_type *o_list;
 extern monster_type *m_list;
 extern player_type **p_list;
@@ -406,9 +419,13 @@ extern void do_cmd_view_map(player_type *p_ptr, char query);
 extern void forget_lite(player_type *p_ptr);
 extern void update_lite(player_type *p_ptr);
 extern void forget_view(player_type *p_ptr);
+extern errr vinfo_init(void);
 extern void update_view(player_type *p_ptr);
-extern void forget_flow(void);
-extern void update_flow(void);
+extern void forget_walls(int Depth);
+extern void update_wall_spot(int Depth, int y, int x);
+extern void forget_flow(int Depth);
+extern void update_flow(int Depth);
+extern flow_type *level_flow(int Depth);
 extern void wiz_lite(player_type *p_ptr);
 extern void wiz_dark(player_type *p_ptr);
 extern void mmove2(int *y, int *x, int y1, int x1, int y2, int x2);
@@ -559,6 +576,8 @@ extern void do_cmd_activate_dir(player_type *p_ptr, int item, int dir);
 extern void do_cmd_refill_potion(player_type *p_ptr, int item);
 
 /* pathfind.c */
+typedef bool (*path_hook)(vptr data, int y, int x);
+extern int path_search(int Depth, int y1, int x1, int y2, int x2, path_hook pass, vptr data, byte *path, int max);
 extern bool findpath(player_type *p_ptr, int y, int x);
 
 /* control.c */
@@ -615,6 +634,7 @@ extern errr file_character_server(player_type *p_ptr, cptr name);
 /* generate.c */
 extern void alloc_dungeon_level(int Depth);
 extern void dealloc_dungeon_level(int Depth);
+extern void wipe_level_pool(void);
 extern void generate_cave(player_type *p_ptr, int Depth, int auto_scum);
 extern void build_vault(int Depth, int yval, int xval, int ymax, int xmax, cptr data);
 extern void place_closed_door(int Depth, int y, int x);
@@ -662,6 +682,9 @@ extern bool rd_dungeon_special_ext(int Depth, cptr levelname);
 extern bool make_attack_normal(player_type *p_ptr, int m_idx);
 extern bool make_attack_spell(player_type *p_ptr, int m_idx);
 extern void process_monsters(void);
+extern void level_threads_run(void (*job)(int), int n);
+extern int level_threads_start(int num);
+extern void level_threads_stop(void);
 
 /* mon-desc.c */
 extern void screen_roff(int r_idx);
@@ -673,7 +696,7 @@ extern void delete_monster_idx(int i);
 extern void delete_monster(int Depth, int y, int x);
 extern void compact_monsters(int size);
 extern void wipe_m_list(int Depth);
-extern s16b m_pop(void);
+extern s16b m_pop(int Depth);
 extern errr get_mon_num_prep(void);
 extern s16b get_mon_num(int level);
 extern void monster_desc(player_type *p_ptr, char *desc, int m_idx, int mode);
@@ -681,8 +704,10 @@ extern void lore_do_probe(player_type *p_ptr, int m_idx);
 extern void lore_treasure(player_type *p_ptr, int m_idx, int num_item, int num_gold);
 extern void update_mon(int m_idx, bool dist);
 extern void update_monsters(bool dist);
+extern void update_monsters_depth(int Depth, bool dist);
 extern void update_player(player_type *p_ptr);
 extern void update_players(void);
+extern void update_players_depth(int Depth);
 extern bool place_monster_aux(int Depth, int y, int x, int r_idx, bool slp, bool grp);
 extern bool place_monster(int Depth, int y, int x, bool slp, bool grp);
 extern bool alloc_monster(int Depth, int dis, int slp);
@@ -700,6 +725,11 @@ extern u16b rand_mimic_kind(int r_idx);
 /* monster2.c */
 extern bool is_detected(u32b flag, u32b esp);
 extern void reveal_mimic(int m_idx);
+extern byte monster_detection(player_type *p_ptr, int m_idx);
+extern void add_monster_detection(player_type *p_ptr, int m_idx, int power);
+extern void forget_monster_detection(player_type *p_ptr, int m_idx);
+extern void move_monster_detection(player_type *p_ptr, int i1, int i2);
+extern void fade_monster_detection(player_type *p_ptr);
 extern void forget_monster(player_type *p_ptr, int m_idx, bool deleted);
 extern s16b monster_carry(player_type *p_ptr, int m_idx, object_type *j_ptr);
 extern bool monster_can_carry(int m_idx);
@@ -805,7 +835,7 @@ extern void delete_object_ptr(object_type * o_ptr);
 extern void delete_object(int Depth, int y, int x);
 extern void compact_objects(int size);
 extern void wipe_o_list(int Depth);
-extern s16b o_pop(void);
+extern s16b o_pop(int Depth);
 extern errr get_obj_num_prep(void);
 extern s16b get_obj_num(int level);
 extern bool object_is_fuel(player_type *p_ptr, object_type *o_ptr, bool *fits);
@@ -833,6 +863,7 @@ extern cptr item_activation(object_type *o_ptr);
 extern void combine_pack(player_type *p_ptr);
 extern void reorder_pack(player_type *p_ptr);
 extern void setup_objects(void);
+extern void setup_level_objects(int Depth);
 extern void distribute_charges(object_type *o_ptr, object_type *q_ptr, int amt);
 extern void reduce_charges(object_type *o_ptr, int amt);
 extern void object_audit(player_type *p_ptr, object_type *o_ptr, int amt);
@@ -884,6 +915,7 @@ extern bool load_player(player_type *p_ptr);
 extern bool load_server_info(void);
 extern bool save_server_info(void);
 extern bool wr_dungeon_special_ext(int Depth, cptr levelname);
+extern void convert_savefiles(void);
 
 
 /* spells1.c */
@@ -1140,7 +1172,8 @@ extern bool do_scroll_life(player_type *p_ptr);
 extern bool do_restoreXP_other(player_type *p_ptr);
 extern u32b level_speed(int Depth);
 extern int time_factor(player_type *p_ptr);
-extern int base_time_factor(player_type *p_ptr, int slowest);
+extern void update_time_bubbles(void);
+extern int base_time_factor(player_type *p_ptr);
 extern void show_motd(player_type *p_ptr);
 extern void show_tombstone(player_type *p_ptr);
 extern void wipe_socials();
@@ -4046,21 +4046,50 @@ static void town_gen(void)
 
 
 
+/*
+ * Freed levels, kept for reuse.
+ *
+ * Players going up and down stairs free and allocate levels all the
+ * time, and every level is the same size, so we keep a few of them
+ * around instead of going back to the system allocator each time.
+ */
+static cave_row *level_pool[MAX_LEVEL_POOL];
+static int level_pool_num = 0;
+
+
 /*
  * Allocate the space needed for a dungeon level
+ *
+ * The whole level is a single block of MAX_HGT rows, so "cave[Depth][y][x]"
+ * only follows one pointer and rows are adjacent in memory.
  */
 void alloc_dungeon_level(int Depth)
 {
-	int i;
+	/* Reuse a freed level */
+	if (level_pool_num)
+	{
+		cave[Depth] = level_pool[--level_pool_num];
+
+		/* Start from scratch */
+		C_WIPE(cave[Depth], MAX_HGT, cave_row);
+	}
+
+	/* Allocate a new one */
+	else
+	{
+		C_MAKE(cave[Depth], MAX_HGT, cave_row);
+	}
+}
 
-	/* Allocate the array of rows */
-	C_MAKE(cave[Depth], MAX_HGT, cave_type *);
 
-	/* Allocate each row */
-	for (i = 0; i < MAX_HGT; i++)
+/*
+ * Free the levels kept for reuse
+ */
+void wipe_level_pool(void)
+{
+	while (level_pool_num)
 	{
-		/* Allocate it */
-		C_MAKE(cave[Depth][i], MAX_WID, cave_type);
+		FREE(level_pool[--level_pool_num]);
 	}
 }
 
@@ -4090,15 +4119,23 @@ void dealloc_dungeon_level(int Depth)
 	/* Hack -- don't wipe wilderness objects */
 	if (Depth > 0) wipe_o_list(Depth);
 
-	/* Free up the space taken by each row */
-	for (i = 0; i < MAX_HGT; i++)
+	/* Forget the monster flow information */
+	forget_flow(Depth);
+
+	/* Forget the wall bitboard */
+	forget_walls(Depth);
+
+	/* Keep the space for another level */
+	if (level_pool_num < MAX_LEVEL_POOL)
 	{
-		/* Dealloc that row */
-		FREE(cave[Depth][i]);
+		level_pool[level_pool_num++] = cave[Depth];
 	}
 
-	/* Deallocate the array of rows */
-	FREE(cave[Depth]);
+	/* Free it */
+	else
+	{
+		FREE(cave[Depth]);
+	}
 
 	/* Set that level to "ungenerated" */
 	cave[Depth] = NULL; 
@@ -4253,7 +4290,7 @@ void generate_cave(player_type *p_ptr, int Depth, int auto_scum)
 
 
 		/* Prevent object over-flow */
-		if (o_max >= MAX_O_IDX)
+		if (o_top >= MAX_O_IDX)
 		{
 			/* Message */
 			why = "too many objects";
@@ -4263,7 +4300,7 @@ void generate_cave(player_type *p_ptr, int Depth, int auto_scum)
 		}
 
 		/* Prevent monster over-flow */
-		if (m_max >= MAX_M_IDX)
+		if (m_top >= MAX_M_IDX)
 		{
 			/* Message */
 			why = "too many monsters";
@@ -4313,11 +4350,11 @@ void generate_cave(player_type *p_ptr, int Depth, int auto_scum)
 		wipe_m_list(Depth);
 
 		/* Compact some objects, if necessary */
-		if (o_max >= MAX_O_IDX * 3 / 4)
+		if (o_top >= MAX_O_IDX * 3 / 4)
 			compact_objects(32);
 
 		/* Compact some monsters, if necessary */
-		if (m_max >= MAX_M_IDX * 3 / 4)
+		if (m_top >= MAX_M_IDX * 3 / 4)
 			compact_monsters(32);
 	}
 
@@ -4330,6 +4367,9 @@ void generate_cave(player_type *p_ptr, int Depth, int auto_scum)
 	/* Remember when we generated this level */
 	turn_cavegen[Depth] = turn;
 
+	/* The walls have all changed */
+	forget_walls(Depth);
+
 	/* Dungeon level ready */
 	server_dungeon = TRUE;
 }
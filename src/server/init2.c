@@ -2121,6 +2121,26 @@ void set_server_option(const char * option, char * value)
 		/* Hack -- reinstall the timer handler to match the new FPS */
 		//TODO: DO THIS! install_timer_tick(dungeon, cfg_fps);
 	}
+	else if (!strcmp(option,"CORK_OUTPUT"))
+	{
+		cfg_cork_output = str_to_boolean(value);
+	}
+	else if (!strcmp(option,"NETWORK_THREAD"))
+	{
+		cfg_network_thread = str_to_boolean(value);
+	}
+	else if (!strcmp(option,"LEVEL_THREADS"))
+	{
+		cfg_level_threads = atoi(value);
+		if (cfg_level_threads < 0) cfg_level_threads = 0;
+		if (cfg_level_threads > 64) cfg_level_threads = 64;
+	}
+	else if (!strcmp(option,"COMPRESS_OUTPUT"))
+	{
+		cfg_compress_output = atoi(value);
+		if (cfg_compress_output < 0) cfg_compress_output = 0;
+		if (cfg_compress_output > 9) cfg_compress_output = 9;
+	}
 	else if (!strcmp(option,"TCP_PORT"))
 	{
 		cfg_tcp_port = atoi(value);
@@ -2487,6 +2507,9 @@ void init_some_arrays(void)
 	plog("[Initializing arrays... (alloc)]");
 	if (init_alloc()) quit("Cannot initialize alloc stuff");
 
+	/* Initialize the field of view tables */
+	if (vinfo_init()) quit("Cannot initialize view tables");
+
 	/* Hack -- all done */
 	plog("[Initializing arrays... done]");
 }
@@ -2504,9 +2527,15 @@ void cleanup_angband(void)
 		}
 	}
 
+	/* Freed levels */
+	wipe_level_pool();
+
 	/* Network */
 	close_network_server();
 
+	/* Level threads */
+	level_threads_stop();
+
 	/* Free options from mangband.cfg */		
 	unload_server_cfg();
 
@@ -72,8 +72,245 @@ static u32b	x_check = 0L;
  */
 static char file_buf[1024];
 
+/*
+ * Binary savefiles are read into memory in one go
+ */
+typedef struct save_block save_block;
+struct save_block
+{
+	bool binary;	/* The savefile uses the binary format */
+	char *data;	/* Contents, past the signature */
+	size_t len;
+	size_t pos;	/* Current record */
+};
+static save_block file_block;
+
+/*
+ * The last record read from a binary savefile
+ */
+static byte rec_type;
+static char rec_name[256];
+static huge rec_num, rec_num2;
+static char rec_data[1024];
+static u16b rec_len;
+
+/*
+ * Functions to read data from the binary format save file
+ */
+
+/* Read some raw bytes */
+static bool rd_bytes(void *buf, size_t len)
+{
+	if (file_block.pos + len > file_block.len) return (FALSE);
+	memcpy(buf, file_block.data + file_block.pos, len);
+	file_block.pos += len;
+	return (TRUE);
+}
+
+/* Read a little-endian number of 'len' bytes */
+static bool rd_number(huge *value, int len)
+{
+	byte *buf = (byte*)file_block.data + file_block.pos;
+	int i;
+
+	if (file_block.pos + len > file_block.len) return (FALSE);
+	file_block.pos += len;
+	*value = 0;
+	for (i = len - 1; i >= 0; i--) *value = (*value << 8) | buf[i];
+	return (TRUE);
+}
+
+/* Read the next record */
+static bool rd_record(void)
+{
+	byte head[2];
+	huge len;
+
+	if (!rd_bytes(head, 2)) return (FALSE);
+	rec_type = head[0];
+	if (!rd_bytes(rec_name, head[1])) return (FALSE);
+	rec_name[head[1]] = '\0';
+
+	switch (rec_type)
+	{
+		case SAVE_REC_END:
+			return (TRUE);
+		case SAVE_REC_SECTION:
+		case SAVE_REC_UINT:
+			return rd_number(&rec_num, 4);
+		case SAVE_REC_INT:
+			if (!rd_number(&rec_num, 4)) return (FALSE);
+			rec_num = (huge)(s32b)(u32b)rec_num;
+			return (TRUE);
+		case SAVE_REC_HUGE:
+			return rd_number(&rec_num, 8);
+		case SAVE_REC_HTURN:
+			return rd_number(&rec_num, 8) && rd_number(&rec_num2, 8);
+		case SAVE_REC_STR:
+		case SAVE_REC_BINARY:
+			if (!rd_number(&len, 2) || len >= sizeof(rec_data)) return (FALSE);
+			rec_len = (u16b)len;
+			if (!rd_bytes(rec_data, rec_len)) return (FALSE);
+			rec_data[rec_len] = '\0';
+			return (TRUE);
+	}
+
+	/* Unknown record */
+	return (FALSE);
+}
+
+/* Turn the last record back into a line of the textual format */
+static void rd_record_line(void)
+{
+	size_t n;
+	int i;
+
+	switch (rec_type)
+	{
+		case SAVE_REC_SECTION:
+			strnfmt(file_buf, sizeof(file_buf), "<%s>", rec_name);
+			break;
+		case SAVE_REC_END:
+			strnfmt(file_buf, sizeof(file_buf), "</%s>", rec_name);
+			break;
+		case SAVE_REC_INT:
+			strnfmt(file_buf, sizeof(file_buf), "%s = %i", rec_name, (int)rec_num);
+			break;
+		case SAVE_REC_UINT:
+			strnfmt(file_buf, sizeof(file_buf), "%s = %u", rec_name, (uint)rec_num);
+			break;
+		case SAVE_REC_HUGE:
+			strnfmt(file_buf, sizeof(file_buf), "%s = %" PRIu64, rec_name, rec_num);
+			break;
+		case SAVE_REC_HTURN:
+			strnfmt(file_buf, sizeof(file_buf), "%s = %" PRIu64 " %" PRIu64, rec_name, rec_num, rec_num2);
+			break;
+		case SAVE_REC_STR:
+			strnfmt(file_buf, sizeof(file_buf), "%s = %s", rec_name, rec_data);
+			break;
+		case SAVE_REC_BINARY:
+			n = strnfmt(file_buf, sizeof(file_buf), "%s = ", rec_name);
+			for (i = 0; i < rec_len && n + 2 < sizeof(file_buf); i++)
+			{
+				n += strnfmt(file_buf + n, sizeof(file_buf) - n, "%2x", (byte)rec_data[i]);
+			}
+			break;
+	}
+}
+
+/*
+ * Fetch the next value.
+ *
+ * Returns TRUE if it is a binary record of the given 'type' (any integer
+ * type will do for SAVE_REC_INT) with the given 'name'.  Otherwise the
+ * value is left in "file_buf" in the textual format, to be parsed (or
+ * rejected) by the text reader.
+ */
+static bool next_value(cptr name, byte type)
+{
+	line_counter++;
+
+	if (!file_block.binary)
+	{
+		if (!file_getl(file_handle, file_buf, sizeof(file_buf)-1)) file_buf[0] = '\0';
+		return (FALSE);
+	}
+
+	if (!rd_record())
+	{
+		file_buf[0] = '\0';
+		return (FALSE);
+	}
+
+	if (type == SAVE_REC_INT && (rec_type == SAVE_REC_UINT || rec_type == SAVE_REC_HUGE))
+	{
+		type = rec_type;
+	}
+	if (rec_type == type && !strcmp(rec_name, name)) return (TRUE);
+
+	rd_record_line();
+	return (FALSE);
+}
+
+/* Peek at the next record, TRUE if it is of the given 'type' and 'name' */
+static bool peek_record(cptr name, byte type)
+{
+	bool matched = FALSE;
+	size_t pos = file_block.pos;
+
+	if (rd_record() && !strcmp(rec_name, name))
+	{
+		if (type == SAVE_REC_SECTION) matched = (rec_type == SAVE_REC_SECTION);
+		else matched = (rec_type >= SAVE_REC_INT);
+	}
+	file_block.pos = pos;
+	return (matched);
+}
+
+/*
+ * Check the savefile signature, and prepare to read the records
+ *
+ * Savefiles without a signature use the older textual format.
+ */
+static bool rd_signature(void)
+{
+	char buf[SAVEFILE_MAGIC_LEN];
+	size_t size = 0, got;
+	huge version;
+
+	WIPE(&file_block, save_block);
+	line_counter = 0;
+
+	/* Text */
+	if (file_read(file_handle, buf, SAVEFILE_MAGIC_LEN) != SAVEFILE_MAGIC_LEN ||
+	    memcmp(buf, SAVEFILE_MAGIC, SAVEFILE_MAGIC_LEN))
+	{
+		return file_seek(file_handle, 0);
+	}
+
+	file_block.binary = TRUE;
+
+	/* Slurp the rest */
+	while (TRUE)
+	{
+		if (file_block.len == size)
+		{
+			char *old_data = file_block.data;
+
+			size = size ? size * 2 : 65536;
+			C_MAKE(file_block.data, size, char);
+			if (old_data)
+			{
+				memcpy(file_block.data, old_data, file_block.len);
+				FREE(old_data);
+			}
+		}
+		got = file_read(file_handle, file_block.data + file_block.len, size - file_block.len);
+		if (got == 0 || got == (size_t)-1) break;
+		file_block.len += got;
+	}
+
+	if (!rd_number(&version, 2)) return (FALSE);
+	if (version > SAVEFILE_VERSION)
+	{
+		plog(format("Savefile version %d is too new", (int)version));
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+/* Done reading the savefile */
+static void rd_release(void)
+{
+	if (file_block.data) FREE(file_block.data);
+	WIPE(&file_block, save_block);
+}
+
 /*
  * Functions to read data from the textual format save file
+ *
+ * These also read the binary format, where the records are parsed as text
+ * whenever they do not match the type of value requested.
  */
 
 /* Start a section */
@@ -83,14 +320,13 @@ bool start_section_read(char* name)
 	char got_section[80];
 	bool matched = FALSE;
 	
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_SECTION)) return (TRUE);
+
+	sprintf(seek_section,"<%s>",name);
+	got_section[0] = '\0';
+	if(sscanf(file_buf,"%s",got_section) == 1)
 	{
-		line_counter++;
-		sprintf(seek_section,"<%s>",name);
-		if(sscanf(file_buf,"%s",got_section) == 1)
-		{
-			matched = !strcmp(got_section,seek_section);
-		}
+		matched = !strcmp(got_section,seek_section);
 	}
 	if(!matched)
 	{
@@ -107,14 +343,13 @@ bool end_section_read(char* name)
 	char got_section[80];
 	bool matched = FALSE;
 		
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_END)) return (TRUE);
+
+	sprintf(seek_section,"</%s>",name);
+	got_section[0] = '\0';
+	if(sscanf(file_buf,"%s",got_section) == 1)
 	{
-		line_counter++;
-		sprintf(seek_section,"</%s>",name);
-		if(sscanf(file_buf,"%s",got_section) == 1)
-		{
-			matched = !strcmp(got_section,seek_section);
-		}
+		matched = !strcmp(got_section,seek_section);
 	}
 	if(!matched)
 	{
@@ -134,17 +369,19 @@ bool read_byte(char* name, byte *dst)
 	u16b larger_value;
 #endif
 		
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_INT))
 	{
-		line_counter++;
+		*dst = (byte)rec_num;
+		return (TRUE);
+	}
+
 #ifndef SCNu8
-		if(sscanf(file_buf,"%s = %" SCNu16, seek_name,&larger_value) == 2)
+	if(sscanf(file_buf,"%s = %" SCNu16, seek_name,&larger_value) == 2)
 #else
-		if(sscanf(file_buf,"%s = %" SCNu8, seek_name,&value) == 2)
+	if(sscanf(file_buf,"%s = %" SCNu8, seek_name,&value) == 2)
 #endif
-		{
-			matched = !strcmp(seek_name,name);
-		}
+	{
+		matched = !strcmp(seek_name,name);
 	}
 	if(!matched)
 	{
@@ -172,13 +409,15 @@ bool read_short(char* name, s16b *dst)
 	bool matched = FALSE;
 	s16b value;
 		
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_INT))
 	{
-		line_counter++;
-		if(sscanf(file_buf,"%s = %" SCNu16, seek_name,&value) == 2)
-		{
-			matched = !strcmp(seek_name,name);
-		}
+		*dst = (s16b)rec_num;
+		return (TRUE);
+	}
+
+	if(sscanf(file_buf,"%s = %" SCNu16, seek_name,&value) == 2)
+	{
+		matched = !strcmp(seek_name,name);
 	}
 	if(!matched)
 	{
@@ -196,13 +435,15 @@ bool read_int(char* name, int *dst)
 	bool matched = FALSE;
 	int value;
 		
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_INT))
 	{
-		line_counter++;
-		if(sscanf(file_buf,"%s = %i",seek_name,&value) == 2)
-		{
-			matched = !strcmp(seek_name,name);
-		}
+		*dst = (int)rec_num;
+		return (TRUE);
+	}
+
+	if(sscanf(file_buf,"%s = %i",seek_name,&value) == 2)
+	{
+		matched = !strcmp(seek_name,name);
 	}
 	if(!matched)
 	{
@@ -220,13 +461,15 @@ bool read_uint(const char* name, uint *dst)
 	bool matched = FALSE;
 	uint value;
 		
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_INT))
 	{
-		line_counter++;
-		if(sscanf(file_buf,"%s = %u",seek_name,&value) == 2)
-		{
-			matched = !strcmp(seek_name,name);
-		}
+		*dst = (uint)rec_num;
+		return (TRUE);
+	}
+
+	if(sscanf(file_buf,"%s = %u",seek_name,&value) == 2)
+	{
+		matched = !strcmp(seek_name,name);
 	}
 	if(!matched)
 	{		
@@ -244,13 +487,15 @@ bool read_huge(char* name, huge *dst)
 	bool matched = FALSE;
 	huge value;
 		
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_INT))
 	{
-		line_counter++;
-		if(sscanf(file_buf,"%s = %" SCNu64 ,seek_name,&value) == 2)
-		{
-			matched = !strcmp(seek_name,name);
-		}
+		*dst = rec_num;
+		return (TRUE);
+	}
+
+	if(sscanf(file_buf,"%s = %" SCNu64 ,seek_name,&value) == 2)
+	{
+		matched = !strcmp(seek_name,name);
 	}
 	if(!matched)
 	{		
@@ -268,13 +513,16 @@ bool read_hturn(char* name, hturn *value)
 	bool matched = FALSE;
 	s64b era, turn;
 
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_HTURN))
 	{
-		line_counter++;
-		if (sscanf(file_buf, "%s = %" SCNu64 " %" SCNu64, seek_name, &era, &turn) == 3)
-		{
-			matched = !strcmp(seek_name,name);
-		}
+		value->era = rec_num;
+		value->turn = rec_num2;
+		return (TRUE);
+	}
+
+	if (sscanf(file_buf, "%s = %" SCNu64 " %" SCNu64, seek_name, &era, &turn) == 3)
+	{
+		matched = !strcmp(seek_name,name);
 	}
 	if(!matched)
 	{		
@@ -295,14 +543,17 @@ bool read_str(char* name, char* value)
 	bool matched = FALSE;
 	char *c;
 	
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_STR))
 	{
-		line_counter++;
-		sscanf(file_buf,"%s = ",seek_name);
-		if (!strcmp(seek_name,name))
-		{
-			matched = TRUE;
-		}
+		strcpy(value, rec_data);
+		return (TRUE);
+	}
+
+	seek_name[0] = '\0';
+	sscanf(file_buf,"%s = ",seek_name);
+	if (!strcmp(seek_name,name))
+	{
+		matched = TRUE;
 	}
 	if (!matched)
 	{
@@ -350,13 +601,12 @@ bool read_float(char* name, float *dst)
 	bool matched = FALSE;
 	float value;
 	
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	/* There are no binary floats */
+	next_value(name, 0);
+
+	if(sscanf(file_buf,"%s = %f",seek_name,&value) == 2)
 	{
-		line_counter++;
-		if(sscanf(file_buf,"%s = %f",seek_name,&value) == 2)
-		{
-			matched = !strcmp(seek_name,name);
-		}
+		matched = !strcmp(seek_name,name);
 	}
 	if(!matched)
 	{
@@ -378,14 +628,17 @@ bool read_binary(char* name, char* value, int max_len)
 	unsigned int abyte;
 	hex[2] = '\0';
 
-	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
+	if (next_value(name, SAVE_REC_BINARY))
 	{
-		line_counter++;
-		sscanf(file_buf,"%s = ",seek_name);
-		if (!strcmp(seek_name,name))
-		{
-			matched = TRUE;
-		}
+		memcpy(value, rec_data, MIN(rec_len, max_len));
+		return (TRUE);
+	}
+
+	seek_name[0] = '\0';
+	sscanf(file_buf,"%s = ",seek_name);
+	if (!strcmp(seek_name,name))
+	{
+		matched = TRUE;
 	}
 	if (!matched)
 	{
@@ -415,6 +668,13 @@ void skip_value(char* name)
 	char seek_name[80];
 	long fpos;
 	
+	/* Skip the record */
+	if (file_block.binary)
+	{
+		if (peek_record(name, SAVE_REC_INT)) rd_record();
+		return;
+	}
+
 	/* Remember where we are incase there is nothing to skip */
 	fpos = file_tell(file_handle);
 	sprintf(seek_name,"%s = ",name);
@@ -439,6 +699,8 @@ bool value_exists(const char* name)
 	bool matched = FALSE;
 	long fpos;
 	
+	if (file_block.binary) return peek_record(name, SAVE_REC_INT);
+
 	/* Remember where we are */
 	fpos = file_tell(file_handle);
 	sprintf(seek_name,"%s = ",name);
@@ -463,6 +725,8 @@ bool section_exists(char* name)
 	bool matched = FALSE;
 	long fpos;
 	
+	if (file_block.binary) return peek_record(name, SAVE_REC_SECTION);
+
 	/* Remember where we are */
 	fpos = file_tell(file_handle);
 	if (file_getl(file_handle, file_buf, sizeof(file_buf)-1))
@@ -1584,6 +1848,9 @@ static bool rd_dungeon(bool ext, int Depth)
 
 	__try( end_section_read("features") );
 
+	/* The walls have all changed */
+	forget_walls(depth);
+
 	/* Load info */
 	start_section_read("info");
 
@@ -1627,6 +1894,7 @@ static errr rd_dungeon_special()
 	char levelname[32];
 	ang_file* fhandle;
 	ang_file* server_handle;
+	save_block server_block;
 	int i,num_levels,j=0,k=0;
 	
 	/* Clear all the special levels */
@@ -1655,11 +1923,14 @@ static errr rd_dungeon_special()
 		{
 			/* swap out the main file pointer for our level file */
 			server_handle = file_handle;
+			server_block = file_block;
 			file_handle = fhandle;
 			/* load the level */
-			ok = rd_dungeon(FALSE, 0);
+			ok = rd_signature() && rd_dungeon(FALSE, 0);
+			rd_release();
 			/* swap the file pointers back */
 			file_handle = server_handle;
+			file_block = server_block;
 			/* close the level file */
 			file_close(fhandle);
 			/* we have an arbitrary max number of levels */
@@ -1684,6 +1955,7 @@ bool rd_dungeon_special_ext(int Depth, cptr levelname)
 	char filename[1024];
 	ang_file* fhandle;
 	ang_file* server_handle;
+	save_block server_block;
 	
 	path_build(filename, 1024, ANGBAND_DIR_SAVE, levelname);
 
@@ -1693,13 +1965,16 @@ bool rd_dungeon_special_ext(int Depth, cptr levelname)
 	{
 			/* swap out the main file pointer for our level file */
 			server_handle = file_handle;
+			server_block = file_block;
 			file_handle = fhandle;
 
 			/* load the level */
-			ok = rd_dungeon(TRUE, Depth);
+			ok = rd_signature() && rd_dungeon(TRUE, Depth);
+			rd_release();
 
 			/* swap the file pointers back */
 			file_handle = server_handle;
+			file_block = server_block;
 
 			/* close the level file */
 			file_close(fhandle);
@@ -1746,7 +2021,8 @@ static bool rd_cave_memory(player_type *p_ptr)
  * This function parses savefile as if it was a text file, searching for
  * "pass =" string. It ignores the 'xml' format for sake
  * of maintance simplicity (i.e. it doesn't care about savefile format
- * changes). It attempts to read out the stored password, and compares it
+ * changes). Binary savefiles are scanned the same way, seeking past every
+ * section but the header. It attempts to read out the stored password, and compares it
  * to the password provided in "pass_word". If it matches, the hashed
  * password stored back onto the "pass_word" buff, which is assumed to be
  * of MAX_CHARS length.
@@ -1770,14 +2046,38 @@ errr rd_savefile_new_scoop_aux(char *sfile, char *pass_word)
 
 	char buf[1024];
 
-	/* The savefile is a text file */
 	file_handle = file_open(sfile, MODE_READ, -1);
 
 	/* Paranoia */
 	if (!file_handle) return (-1);
 
+	if (!rd_signature())
+	{
+		rd_release();
+		file_close(file_handle);
+		return (-1);
+	}
+
+	/* Binary savefile, look in the header and skip everything else */
+	if (file_block.binary)
+	{
+		while (!read_pass && rd_record())
+		{
+			if (rec_type == SAVE_REC_SECTION &&
+			    strcmp(rec_name, "mangband_player_save") && strcmp(rec_name, "header"))
+			{
+				file_block.pos += rec_num;
+			}
+			else if (rec_type == SAVE_REC_STR && !strcmp(rec_name, "pass"))
+			{
+				my_strcpy(pass, rec_data, 80);
+				read_pass = TRUE;
+			}
+		}
+	}
+
 	/* Try to fetch the data */
-	while (file_getl(file_handle, buf, 1024))
+	else while (file_getl(file_handle, buf, 1024))
 	{
 		read = strtok(buf, " \t=");
 		if (!strcmp(read, "pass"))
@@ -1789,6 +2089,7 @@ errr rd_savefile_new_scoop_aux(char *sfile, char *pass_word)
 		}
 		if (read_pass) break;
 	}
+	rd_release();
 
 	/* Paranoia */
 	temp[0] = '\0';
@@ -2185,14 +2486,14 @@ errr rd_savefile_new(player_type *p_ptr)
 {
 	errr err;
 
-	/* The savefile is a text file */
 	file_handle = file_open(p_ptr->savefile, MODE_READ, -1);
 
 	/* Paranoia */
 	if (!file_handle) return (-1);
 
 	/* Call the sub-function */
-	err = rd_savefile_new_aux(p_ptr);
+	err = rd_signature() ? rd_savefile_new_aux(p_ptr) : -1;
+	rd_release();
 
 	/* Check for errors */
 	if (file_error(file_handle)) err = -1;
@@ -2204,19 +2505,15 @@ errr rd_savefile_new(player_type *p_ptr)
 	return (err);
 }
 
-errr rd_server_savefile()
+static errr rd_server_savefile_aux(void)
 {
 #undef __try
-#define __try(X) if (!(X)) { exit(1); }
-#define __tryN(X) if ((X)) { exit(1); }
+#define __try(X) if (!(X)) { rd_release(); exit(1); }
+#define __tryN(X) if ((X)) { rd_release(); exit(1); }
 #define __tryR(X, RET) if (!(X)) { return (RET); }
 
         int i;
 
-	errr err = 0;
-
-	char savefile[1024];
-
 	byte tmp8u;
         u16b tmp16u;
         u32b tmp32u;
@@ -2224,13 +2521,7 @@ errr rd_server_savefile()
 	int major;
 	char name[80];
 
-	/* Savefile name */
-	path_build(savefile, 1024, ANGBAND_DIR_SAVE, "server");
-
-	/* The server savefile is a binary file */
-	file_handle = file_open(savefile, MODE_READ, -1);
-	line_counter = 0;
-
+	__try( rd_signature() );
 
 	__try( start_section_read("mangband_server_save") );
 	__try( start_section_read("version") );
@@ -2239,9 +2530,6 @@ errr rd_server_savefile()
 	__try( read_int("patch", &major) );
 	__try( end_section_read("version") );
 
-	/* Paranoia */
-	if (!file_handle) return (-1);
-
         /* Clear the checksums */
         v_check = 0L;
         x_check = 0L;
@@ -2360,7 +2648,10 @@ errr rd_server_savefile()
 		/* load the monsters */
 		for (i = 1; i < tmp32u; i++)
 		{
-			__try( rd_monster(&m_list[m_pop()]) );
+			monster_type tmp_mon;
+			WIPE(&tmp_mon, monster_type);
+			__try( rd_monster(&tmp_mon) );
+			COPY(&m_list[m_pop(tmp_mon.dun_depth)], &tmp_mon, monster_type);
 		}
 	__try( end_section_read("monsters") );
 
@@ -2383,6 +2674,9 @@ errr rd_server_savefile()
 
 		/* Set the maximum object number */
 		o_max = tmp16u;
+
+		/* Rebuild the "live" object array */
+		compact_objects(0);
 	__try( end_section_read("objects") );
 
 		/* Read holding info */
@@ -2508,6 +2802,28 @@ errr rd_server_savefile()
 
 	__try( end_section_read("mangband_server_save") );
 
+	/* Success */
+	return (0);
+}
+
+errr rd_server_savefile()
+{
+	errr err;
+
+	char savefile[1024];
+
+	/* Savefile name */
+	path_build(savefile, 1024, ANGBAND_DIR_SAVE, "server");
+
+	file_handle = file_open(savefile, MODE_READ, -1);
+
+	/* Paranoia */
+	if (!file_handle) return (-1);
+
+	/* Call the sub-function, the savefile block is freed on every path */
+	err = rd_server_savefile_aux();
+	rd_release();
+
 	/* Check for errors */
 	if (file_error(file_handle)) err = -1;
 
@@ -251,6 +251,7 @@ void show_version()
 int main(int argc, char *argv[])
 {
 	bool new_game = FALSE;
+	bool convert = FALSE;
 	int catch_signals = TRUE;
 
 	/* Setup our logging hook */
@@ -342,6 +343,11 @@ int main(int argc, char *argv[])
 			catch_signals = FALSE;
 			break;
 
+			case 'X':
+			case 'x':
+			convert = TRUE;
+			break;
+
 			case 'v':
 				show_version();
 			break;
@@ -354,6 +360,7 @@ int main(int argc, char *argv[])
 			puts("Usage: mangband [options]");
 			puts("  -r       Reset the server");
 			puts("  -z       Don't catch signals");
+			puts("  -x       Convert text savefiles to binary and exit");
 			puts("  -C<file> Use config file <file>");
 			puts("  -e<path> Look for edit files in the directory <path>");
 			puts("  -t<path> Look for help files in the directory <path>");
@@ -387,6 +394,13 @@ int main(int argc, char *argv[])
 	/* Load the mangband.cfg options */
 	load_server_cfg();
 
+	/* Convert old savefiles */
+	if (convert)
+	{
+		convert_savefiles();
+		quit(NULL);
+	}
+
 	/* Test existance of 'news.txt' and 'scores.raw' */
 	show_news();
 
@@ -101,6 +101,37 @@
  */
 #define NUM_HASH_ENTRIES	256
 
+/*
+ * Number of entries in the quark hash table (see "quark_add()").
+ * This must be a power of 2!
+ */
+#define QUARK_HASH_SIZE	8192
+
+/*
+ * Binary savefile format (see "save.c" and "load2.c").
+ *
+ * A binary savefile starts with SAVEFILE_MAGIC and a 16-bit version,
+ * followed by records of the form {type, name length, name, payload}.
+ * All numbers are little-endian.  A section record carries the 32-bit
+ * byte length of its body (up to and including its end record), so
+ * readers may seek past sections they are not interested in.
+ */
+#define SAVEFILE_MAGIC	"\203MSF"
+#define SAVEFILE_MAGIC_LEN	4
+#define SAVEFILE_VERSION	1
+
+#define SAVE_REC_SECTION	1	/* u32b body length */
+#define SAVE_REC_END    	2	/* no payload */
+#define SAVE_REC_INT    	3	/* s32b */
+#define SAVE_REC_UINT   	4	/* u32b */
+#define SAVE_REC_HUGE   	5	/* u64b */
+#define SAVE_REC_HTURN  	6	/* u64b era, u64b turn */
+#define SAVE_REC_STR    	7	/* u16b length, characters */
+#define SAVE_REC_BINARY 	8	/* u16b length, bytes */
+
+/* Maximum nesting of savefile sections */
+#define SAVE_MAX_SECTIONS	16
+
 
 /* Maximum number of items in ITEMLIST window/command */
 #define MAX_ITEMLIST 256
@@ -2994,6 +3025,29 @@ that keeps many algorithms happy.
 #define player_has_los_bold(PLR,Y,X) \
     ((PLR->cave_flag[Y][X] & CAVE_VIEW) != 0)
 
+/*
+ * Monster "flow" cost of a grid no player is near (see "level_flow()")
+ */
+#define FLOW_NONE	255
+
+/*
+ * Access the per-player visibility bit sets ("mon_vis", "obj_vis", etc)
+ */
+#define vis_has(S,I) \
+    (((S)[(I) >> 5] >> ((I) & 31)) & 1)
+#define vis_on(S,I) \
+    ((S)[(I) >> 5] |= ((u32b)1 << ((I) & 31)))
+#define vis_off(S,I) \
+    ((S)[(I) >> 5] &= ~((u32b)1 << ((I) & 31)))
+#define vis_set(S,I,V) \
+    ((V) ? vis_on(S,I) : vis_off(S,I))
+
+/*
+ * Determine if a grid is marked as a wall in a level's wall bitboard
+ */
+#define wall_bold(W,Y,X) \
+    (vis_has((W)->bits[Y], X))
+
 /*
  * Convert an "attr"/"char" pair into a "pict" (P)
  */
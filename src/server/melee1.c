@@ -233,7 +233,7 @@ bool make_attack_normal(player_type *p_ptr, int m_idx)
 
 
 		/* Extract visibility (before blink) */
-		if (p_ptr->mon_vis[m_idx]) visible = TRUE;
+		if (vis_has(p_ptr->mon_vis, m_idx)) visible = TRUE;
 
 
 
@@ -286,7 +286,7 @@ bool make_attack_normal(player_type *p_ptr, int m_idx)
 			    ((randint0(100) + p_ptr->lev) > 50))
 			{
 				/* Remember the Evil-ness */
-				if (p_ptr->mon_vis[m_idx]) l_ptr->flags3 |= RF3_EVIL;
+				if (vis_has(p_ptr->mon_vis, m_idx)) l_ptr->flags3 |= RF3_EVIL;
 
 				/* Message */
 				msg_format(p_ptr, "%^s is repelled.", m_name);
@@ -1311,7 +1311,7 @@ bool make_attack_normal(player_type *p_ptr, int m_idx)
 				case RBM_XXX2:
 
 				/* Visible monsters */
-				if (p_ptr->mon_vis[m_idx])
+				if (vis_has(p_ptr->mon_vis, m_idx))
 				{
 					/* Disturbing */
 					disturb(p_ptr, 1, 0);
@@ -445,7 +445,7 @@ bool make_attack_spell(player_type *p_ptr, int m_idx)
 	bool blind = (p_ptr->blind ? TRUE : FALSE);
 
 	/* Extract the "see-able-ness" */
-	bool seen = (!blind && p_ptr->mon_vis[m_idx]);
+	bool seen = (!blind && vis_has(p_ptr->mon_vis, m_idx));
 
 
 	/* Assume "normal" target */
@@ -2082,42 +2082,29 @@ static int mon_will_run(player_type *p_ptr, int m_idx)
 
 
 
-#ifdef MONSTER_FLOW
-
 /*
  * Choose the "best" direction for "flowing"
  *
  * Note that ghosts and rock-eaters are never allowed to "flow",
  * since they should move directly towards the player.
  *
- * Prefer "non-diagonal" directions, but twiddle them a little
- * to angle slightly towards the player's actual location.
- *
- * Allow very perceptive monsters to track old "spoor" left by
- * previous locations occupied by the player.  This will tend
- * to have monsters end up either near the player or on a grid
- * recently occupied by the player (and left via "teleport").
- *
- * Note that if "smell" is turned on, all monsters get vicious.
+ * The level's flow costs give the number of steps to the nearest
+ * player, so an approaching monster steps to the cheapest adjacent
+ * grid and a frightened one to the most expensive, which walks it
+ * around walls instead of into them.
  *
- * Also note that teleporting away from a location will cause
- * the monsters who were chasing you to converge on that location
- * as long as you are still near enough to "annoy" them without
- * being close enough to chase directly.  I have no idea what will
- * happen if you combine "smell" with low "aaf" values.
+ * Monsters the player can see, or which are too far away to notice
+ * anyone, use the simple "straight line" code instead.
  */
-static bool get_moves_aux(int m_idx, int *yp, int *xp)
+static bool get_moves_aux(player_type *p_ptr, int m_idx, int *yp, int *xp, bool fear)
 {
-	int i, y, x, y1, x1, when = 0, cost = 999;
+	int i, y, x, y1, x1, best = -1, cost;
 
-	cave_type *c_ptr;
+	flow_type *f_ptr;
 
 	monster_type *m_ptr = &m_list[m_idx];
 	monster_race *r_ptr = &r_info[m_ptr->r_idx];
 
-	/* Monster flowing disabled */
-	if (!flow_by_sound) return (FALSE);
-
 	/* Monster can go through rocks */
 	if (r_ptr->flags2 & RF2_PASS_WALL) return (FALSE);
 	if (r_ptr->flags2 & RF2_KILL_WALL) return (FALSE);
@@ -2126,60 +2113,54 @@ static bool get_moves_aux(int m_idx, int *yp, int *xp)
 	y1 = m_ptr->fy;
 	x1 = m_ptr->fx;
 
-	/* Monster grid */
-	c_ptr = &cave[y1][x1];
-
-	/* The player is not currently near the monster grid */
-	if (c_ptr->when < cave[py][px].when)
-	{
-		/* The player has never been near the monster grid */
-		if (!c_ptr->when) return (FALSE);
+	/* Hack -- Player can see us, run towards (or away from) him */
+	if (player_has_los_bold(p_ptr, y1, x1)) return (FALSE);
 
-		/* The monster is not allowed to track the player */
-		if (!flow_by_smell) return (FALSE);
-	}
+	/* Get the flow information */
+	f_ptr = level_flow(m_ptr->dun_depth);
+	if (!f_ptr) return (FALSE);
 
 	/* Monster is too far away to notice the player */
-	if (c_ptr->cost > MONSTER_FLOW_DEPTH) return (FALSE);
-	if (c_ptr->cost > r_ptr->aaf) return (FALSE);
-
-	/* Hack -- Player can see us, run towards him */
-	if (player_has_los_bold(y1, x1)) return (FALSE);
+	cost = f_ptr->cost[y1][x1];
+	if (cost == FLOW_NONE) return (FALSE);
+	if (cost > r_ptr->aaf) return (FALSE);
 
 	/* Check nearby grids, diagonals first */
 	for (i = 7; i >= 0; i--)
 	{
+		int c;
+
 		/* Get the location */
 		y = y1 + ddy_ddd[i];
 		x = x1 + ddx_ddd[i];
 
-		/* Ignore illegal locations */
-		if (!cave[y][x].when) continue;
+		/* Ignore unreachable locations */
+		if (!in_bounds2(m_ptr->dun_depth, y, x)) continue;
+		c = f_ptr->cost[y][x];
+		if (c == FLOW_NONE) continue;
 
-		/* Ignore ancient locations */
-		if (cave[y][x].when < when) continue;
+		/* Approach: ignore more distant locations */
+		if (!fear && c >= cost) continue;
 
-		/* Ignore distant locations */
-		if (cave[y][x].cost > cost) continue;
+		/* Flee: ignore closer locations */
+		if (fear && c <= cost) continue;
 
-		/* Save the cost and time */
-		when = cave[y][x].when;
-		cost = cave[y][x].cost;
-
-		/* Hack -- Save the "twiddled" location */
-		(*yp) = py + 16 * ddy_ddd[i];
-		(*xp) = px + 16 * ddx_ddd[i];
+		/* Save the cost */
+		cost = c;
+		best = i;
 	}
 
-	/* No legal move (?) */
-	if (!when) return (FALSE);
+	/* No better grid */
+	if (best < 0) return (FALSE);
+
+	/* Hack -- Save the "twiddled" location */
+	(*yp) = y1 + 16 * ddy_ddd[best];
+	(*xp) = x1 + 16 * ddx_ddd[best];
 
 	/* Success */
 	return (TRUE);
 }
 
-#endif
-
 
 /*
  * Choose "logical" directions for monster movement
@@ -2196,6 +2177,8 @@ static void get_moves(player_type *p_ptr, int m_idx, int *mm)
 	int y2 = p_ptr->py;
 	int x2 = p_ptr->px;
 
+	bool wander = FALSE;
+
 	/* Wanderers have their own ideas about where they are going unless
 	 * the player is aggravating them or they are hurt and standing near
 	 * a player who is higher than level 1.
@@ -2203,6 +2186,7 @@ static void get_moves(player_type *p_ptr, int m_idx, int *mm)
 	if ( (r_ptr->flags2 & RF2_WANDERER) && (!p_ptr->aggravate) 
 	   && ( (m_ptr->hp == m_ptr->maxhp) || (p_ptr->lev == 1) ) )
 	{
+		wander = TRUE;
 		x2 = y2 = 0;
 		
 		/* Do we know where we are going? */
@@ -2233,25 +2217,33 @@ static void get_moves(player_type *p_ptr, int m_idx, int *mm)
 	}
 
 
-#ifdef MONSTER_FLOW
-	/* Flow towards the player */
-	if (flow_by_sound)
-	{
-		/* Flow towards the player */
-		(void)get_moves_aux(m_idx, &y2, &x2);
-	}
-#endif
-
-	/* Extract the "pseudo-direction" */
-	y = m_ptr->fy - y2;
-	x = m_ptr->fx - x2;
-
-
 	/* Apply fear if possible and necessary (wanderers never run away) */
 	if ( mon_will_run(p_ptr, m_idx) && !(r_ptr->flags2 & RF2_WANDERER) )
 	{
+		/* Flow away from the players */
+		if (get_moves_aux(p_ptr, m_idx, &y2, &x2, TRUE))
+		{
+			y = m_ptr->fy - y2;
+			x = m_ptr->fx - x2;
+		}
+
 		/* XXX XXX Not very "smart" */
-		y = (-y), x = (-x);
+		else
+		{
+			y = y2 - m_ptr->fy;
+			x = x2 - m_ptr->fx;
+		}
+	}
+
+	/* Chasing the player */
+	else
+	{
+		/* Flow towards the player */
+		if (!wander) (void)get_moves_aux(p_ptr, m_idx, &y2, &x2, FALSE);
+
+		/* Extract the "pseudo-direction" */
+		y = m_ptr->fy - y2;
+		x = m_ptr->fx - x2;
 	}
 
 
@@ -2524,7 +2516,7 @@ static void process_monster(int Ind, int m_idx)
 				m_ptr->csleep -= d;
 
 				/* Notice the "not waking up" */
-				if (p_ptr->mon_vis[m_idx])
+				if (vis_has(p_ptr->mon_vis, m_idx))
 				{
 					/* Hack -- Count the ignores */
 					if (l_ptr->ignore < MAX_UCHAR) l_ptr->ignore++;
@@ -2538,7 +2530,7 @@ static void process_monster(int Ind, int m_idx)
 				m_ptr->csleep = 0;
 
 				/* Notice the "waking up" */
-				if (p_ptr->mon_vis[m_idx])
+				if (vis_has(p_ptr->mon_vis, m_idx))
 				{
 					char m_name[80];
 
@@ -2588,7 +2580,7 @@ static void process_monster(int Ind, int m_idx)
 			m_ptr->stunned = 0;
 
 			/* Message if visible */
-			if (p_ptr->mon_vis[m_idx])
+			if (vis_has(p_ptr->mon_vis, m_idx))
 			{
 				char m_name[80];
 
@@ -2628,7 +2620,7 @@ static void process_monster(int Ind, int m_idx)
 			m_ptr->confused = 0;
 
 			/* Message if visible */
-			if (p_ptr->mon_vis[m_idx])
+			if (vis_has(p_ptr->mon_vis, m_idx))
 			{
 				char m_name[80];
 
@@ -2661,7 +2653,7 @@ static void process_monster(int Ind, int m_idx)
 			m_ptr->monfear = 0;
 
 			/* Visual note */
-			if (p_ptr->mon_vis[m_idx])
+			if (vis_has(p_ptr->mon_vis, m_idx))
 			{
 				char m_name[80];
 				char m_poss[80];
@@ -2705,7 +2697,7 @@ static void process_monster(int Ind, int m_idx)
 				if (multiply_monster(m_idx))
 				{
 					/* Take note if visible */
-					if (p_ptr->mon_vis[m_idx])
+					if (vis_has(p_ptr->mon_vis, m_idx))
 					{
 						l_ptr->flags2 |= RF2_MULTIPLY;
 
@@ -2742,8 +2734,8 @@ static void process_monster(int Ind, int m_idx)
 	         (randint0(100) < 75))
 	{
 		/* Memorize flags */
-		if (p_ptr->mon_vis[m_idx]) l_ptr->flags1 |= RF1_RAND_50;
-		if (p_ptr->mon_vis[m_idx]) l_ptr->flags1 |= RF1_RAND_25;
+		if (vis_has(p_ptr->mon_vis, m_idx)) l_ptr->flags1 |= RF1_RAND_50;
+		if (vis_has(p_ptr->mon_vis, m_idx)) l_ptr->flags1 |= RF1_RAND_25;
 
 		/* Try four "random" directions */
 		mm[0] = mm[1] = mm[2] = mm[3] = 5;
@@ -2754,7 +2746,7 @@ static void process_monster(int Ind, int m_idx)
 	         (randint0(100) < 50))
 	{
 		/* Memorize flags */
-		if (p_ptr->mon_vis[m_idx]) l_ptr->flags1 |= RF1_RAND_50;
+		if (vis_has(p_ptr->mon_vis, m_idx)) l_ptr->flags1 |= RF1_RAND_50;
 
 		/* Try four "random" directions */
 		mm[0] = mm[1] = mm[2] = mm[3] = 5;
@@ -2765,7 +2757,7 @@ static void process_monster(int Ind, int m_idx)
 	         (randint0(100) < 25))
 	{
 		/* Memorize flags */
-		if (p_ptr->mon_vis[m_idx]) l_ptr->flags1 |= RF1_RAND_25;
+		if (vis_has(p_ptr->mon_vis, m_idx)) l_ptr->flags1 |= RF1_RAND_25;
 
 		/* Try four "random" directions */
 		mm[0] = mm[1] = mm[2] = mm[3] = 5;
@@ -3012,7 +3004,7 @@ static void process_monster(int Ind, int m_idx)
 		    (r_ptr->flags1 & RF1_NEVER_BLOW))
 		{
 			/* Hack -- memorize lack of attacks */
-			if (p_ptr->mon_vis[m_idx]) l_ptr->flags1 |= RF1_NEVER_BLOW;
+			if (vis_has(p_ptr->mon_vis, m_idx)) l_ptr->flags1 |= RF1_NEVER_BLOW;
 
 			/* Do not move */
 			do_move = FALSE;
@@ -3049,7 +3041,7 @@ static void process_monster(int Ind, int m_idx)
 		if (do_move && (r_ptr->flags1 & RF1_NEVER_MOVE))
 		{
 			/* Hack -- memorize lack of attacks */
-			if (p_ptr->mon_vis[m_idx]) l_ptr->flags1 |= RF1_NEVER_MOVE;
+			if (vis_has(p_ptr->mon_vis, m_idx)) l_ptr->flags1 |= RF1_NEVER_MOVE;
 
 			/* Do not move */
 			do_move = FALSE;
@@ -3136,9 +3128,9 @@ static void process_monster(int Ind, int m_idx)
 			everyone_lite_spot(Depth, ny, nx);
 
 			/* Possible disturb */
-			if (p_ptr->mon_vis[m_idx] &&
+			if (vis_has(p_ptr->mon_vis, m_idx) &&
 			    (option_p(p_ptr,DISTURB_MOVE) ||
-			     (p_ptr->mon_los[m_idx] &&
+			     (vis_has(p_ptr->mon_los, m_idx) &&
 			      option_p(p_ptr,DISTURB_NEAR))))
 			{
 				/* Disturb */
@@ -3287,7 +3279,7 @@ static void process_monster(int Ind, int m_idx)
 	  l_ptr = p_ptr->l_list + m_ptr->r_idx;
 
 	/* Learn things from observable monster */
-	if (p_ptr->mon_vis[m_idx])
+	if (vis_has(p_ptr->mon_vis, m_idx))
 	{
 		/* Monster opened a door */
 		if (did_open_door) l_ptr->flags2 |= RF2_OPEN_DOOR;
@@ -3322,7 +3314,7 @@ static void process_monster(int Ind, int m_idx)
 		m_ptr->monfear = 0;
 
 		/* Message if seen */
-		if (p_ptr->mon_vis[m_idx])
+		if (vis_has(p_ptr->mon_vis, m_idx))
 		{
 			char m_name[80];
 
@@ -3360,21 +3352,311 @@ static void process_monster(int Ind, int m_idx)
  * Most of the rest of the time is spent in "update_view()" and "lite_spot()",
  * especially when the player is running.
  *
- * Note the use of the new special "m_fast" array, which allows us to only
- * process monsters which are alive (or at least recently alive), which may
- * provide some optimization, especially when resting.  Note that monsters
- * which are only recently alive are excised, using a simple "excision"
- * method relying on the fact that the array is processed backwards.
+ * Only the levels which have players on them are processed, walking
+ * the per-depth lists of "live" monsters, so monsters on abandoned
+ * levels simply wait (and keep their energy) until somebody arrives.
+ *
+ * Note that "new" monsters are always added by "m_pop()" at the head
+ * of their depth list, and that each list is copied before it is
+ * processed, so monsters born or killed this turn are handled safely.
+ *
+ * With "level threads" enabled, the search for each monster's closest
+ * player is done up front for every level at once, on the worker pool
+ * (see "level_threads_run()"), and only the monster turns themselves
+ * are taken serially.  This is the only part done in parallel.  Once
+ * anything the search looked at has changed (a player moved, was hurt
+ * or left, a view on that level was updated, or the monster itself
+ * was moved), the monster searches again, so the result never depends
+ * on the option.
+ */
+
+/*
+ * Level threads, a small pool of workers which run one job per
+ * populated level in parallel (see "process_monsters()").
  *
- * Note that "new" monsters are always added by "m_pop()" and they are
- * always added at the end of the "m_fast" array.
+ * The jobs must only read shared game state and write to their own
+ * level's slots, as nothing else in the server is thread-safe.
  */
- 
- 
+#if defined(HAVE_PTHREAD_CREATE) && defined(HAVE_PTHREAD_H) && !defined(WINDOWS)
+#define USE_LEVEL_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef USE_LEVEL_THREADS
+
+static pthread_t *level_thread;
+static int level_thread_num;
+static pthread_mutex_t level_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t level_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t level_done = PTHREAD_COND_INITIALIZER;
+static u32b level_generation;	/* Bumped for each new batch of jobs */
+static bool level_quit;
+static void (*level_job)(int);
+static int level_jobs, level_next, level_left;
+
+/* Take jobs of the current batch until there are none left */
+/* Note -- called and returns with "level_lock" held */
+static void level_threads_work(void)
+{
+	while (level_next < level_jobs)
+	{
+		int j = level_next++;
+
+		pthread_mutex_unlock(&level_lock);
+		(*level_job)(j);
+		pthread_mutex_lock(&level_lock);
+
+		/* Last one wakes the game thread */
+		if (--level_left == 0) pthread_cond_signal(&level_done);
+	}
+}
+
+static void *level_thread_main(void *arg)
+{
+	u32b seen = 0;
+
+	pthread_mutex_lock(&level_lock);
+	while (!level_quit)
+	{
+		/* Wait for a new batch */
+		if (level_generation == seen)
+		{
+			pthread_cond_wait(&level_wake, &level_lock);
+			continue;
+		}
+		seen = level_generation;
+
+		level_threads_work();
+	}
+	pthread_mutex_unlock(&level_lock);
+
+	return NULL;
+}
+
+/*
+ * Run "job" for 0..n-1, on the level threads and the calling thread,
+ * and return once all of them are done.
+ */
+void level_threads_run(void (*job)(int), int n)
+{
+	int j;
+
+	/* Not worth waking anybody */
+	if (!level_thread_num || n < 2)
+	{
+		for (j = 0; j < n; j++) (*job)(j);
+		return;
+	}
+
+	pthread_mutex_lock(&level_lock);
+	level_job = job;
+	level_jobs = level_left = n;
+	level_next = 0;
+	level_generation++;
+	pthread_cond_broadcast(&level_wake);
+
+	/* Help out */
+	level_threads_work();
+
+	/* Wait for the stragglers */
+	while (level_left) pthread_cond_wait(&level_done, &level_lock);
+	pthread_mutex_unlock(&level_lock);
+}
+
+/* Start "num" level threads, return the number actually started */
+int level_threads_start(int num)
+{
+	int i;
+
+	C_MAKE(level_thread, num, pthread_t);
+	level_quit = FALSE;
+	for (i = 0; i < num; i++)
+	{
+		if (pthread_create(&level_thread[i], NULL, level_thread_main, NULL)) break;
+	}
+	level_thread_num = i;
+
+	return (i);
+}
+
+void level_threads_stop(void)
+{
+	int i;
+
+	if (!level_thread) return;
+
+	pthread_mutex_lock(&level_lock);
+	level_quit = TRUE;
+	pthread_cond_broadcast(&level_wake);
+	pthread_mutex_unlock(&level_lock);
+
+	for (i = 0; i < level_thread_num; i++) pthread_join(level_thread[i], NULL);
+
+	KILL(level_thread);
+	level_thread_num = 0;
+}
+
+#else /* USE_LEVEL_THREADS */
+
+/* No threads, do it all here */
+void level_threads_run(void (*job)(int), int n)
+{
+	int j;
+	for (j = 0; j < n; j++) (*job)(j);
+}
+int level_threads_start(int num) { return 0; }
+void level_threads_stop(void) { }
+
+#endif /* USE_LEVEL_THREADS */
+
+/* Snapshot of the monsters to process this turn, all levels together */
+static s16b m_turn_idx[MAX_M_IDX];
+static s16b m_turn_closest[MAX_M_IDX];
+static byte m_turn_dis[MAX_M_IDX];
+static bool m_turn_los[MAX_M_IDX];
+static byte m_turn_fy[MAX_M_IDX];
+static byte m_turn_fx[MAX_M_IDX];
+
+/* The populated levels, their slice of the above, and their players */
+static struct
+{
+	int Depth;
+	int m_start, m_end;
+	int p_start, p_end;
+	u32b epoch;	/* "view_epoch[Depth]" when collected */
+} m_turn_level[MAX_PLAYERS];
+static int m_turn_levels;
+static s16b m_turn_players[MAX_PLAYERS];
+
+/* What the search saw of each of those players */
+static struct
+{
+	int Depth;
+	byte py, px;
+	s16b chp;
+	bool away;	/* Dead, leaving or shopping */
+} m_turn_seen[MAX_PLAYERS];
+
+/* Remember what the closest player search looks at */
+static void monster_closest_seen(int pn)
+{
+	player_type *p_ptr = Players[m_turn_players[pn]];
+
+	m_turn_seen[pn].Depth = p_ptr->dun_depth;
+	m_turn_seen[pn].py = p_ptr->py;
+	m_turn_seen[pn].px = p_ptr->px;
+	m_turn_seen[pn].chp = p_ptr->chp;
+	m_turn_seen[pn].away = (!p_ptr->alive || p_ptr->death ||
+	    p_ptr->new_level_flag || p_ptr->store_num != -1);
+}
+
+/* Check if the players of a level are still as the search saw them */
+static bool monster_closest_valid(int lev)
+{
+	player_type *p_ptr;
+	int pn;
+
+	if (view_epoch[m_turn_level[lev].Depth] != m_turn_level[lev].epoch) return (FALSE);
+
+	for (pn = m_turn_level[lev].p_start; pn < m_turn_level[lev].p_end; pn++)
+	{
+		p_ptr = Players[m_turn_players[pn]];
+		if (p_ptr->dun_depth != m_turn_seen[pn].Depth ||
+		    p_ptr->py != m_turn_seen[pn].py || p_ptr->px != m_turn_seen[pn].px ||
+		    p_ptr->chp != m_turn_seen[pn].chp ||
+		    (!p_ptr->alive || p_ptr->death || p_ptr->new_level_flag ||
+		    p_ptr->store_num != -1) != m_turn_seen[pn].away)
+			return (FALSE);
+	}
+	return (TRUE);
+}
+
+/*
+ * Find the player a monster cares about most: the closest one in LoS,
+ * or else the closest one (the weakest one in case of a tie).
+ */
+static int monster_closest_player(monster_type *m_ptr, int p_start, int p_end, int *dis, bool *los)
+{
+	player_type *p_ptr;
+	int closest = -1, dis_to_closest = 9999, lowhp = 9999;
+	bool closest_in_los = FALSE;
+	int pn, pl;
+
+	for (pn = p_start; pn < p_end; pn++)
+	{
+		int j;
+		bool in_los;
+
+		pl = m_turn_players[pn];
+		p_ptr = Players[pl];
+
+		/* Hack -- notice death or departure */
+		if (!p_ptr->alive || p_ptr->death || p_ptr->new_level_flag)
+			continue;
+
+		/* Make sure he's on the same dungeon level */
+		if (p_ptr->dun_depth != m_ptr->dun_depth)
+			continue;
+
+		/* Hack -- Skip him if he's shopping */
+		if (p_ptr->store_num != -1)
+			continue;
+
+		/* Hack -- make the dungeon master invisible to monsters */
+		if (p_ptr->dm_flags & DM_MONSTER_FRIEND) continue;
+
+		/* Compute distance */
+		j = distance(p_ptr->py, p_ptr->px, m_ptr->fy, m_ptr->fx);
+
+		/* Compute los */
+		in_los = player_has_los_bold(p_ptr, m_ptr->fy, m_ptr->fx);
+
+		/* Skip if _not_ in LoS while closest _is_ in */
+		if (!in_los && closest_in_los) continue;
+	
+		/* Only check distance if they share LoS properties */		
+		else if (closest_in_los == in_los) 
+		{
+			/* Skip if further than closest */
+			if (j > dis_to_closest) continue;
+
+			/* Skip if same distance and stronger */
+			if (j == dis_to_closest && p_ptr->chp > lowhp) continue;
+		}
+		/* Remember this player */
+		dis_to_closest = j;
+		closest = pl;
+		lowhp = p_ptr->chp;
+		closest_in_los = in_los;
+	}
+
+	*dis = dis_to_closest;
+	*los = closest_in_los;
+	return closest;
+}
+
+/*
+ * Find the closest players for all the monsters of one level
+ * (run by the level threads, so it must not change anything else)
+ */
+static void monster_closest_level(int lev)
+{
+	int k, dis;
+
+	for (k = m_turn_level[lev].m_start; k < m_turn_level[lev].m_end; k++)
+	{
+		m_turn_closest[k] = monster_closest_player(&m_list[m_turn_idx[k]],
+		    m_turn_level[lev].p_start, m_turn_level[lev].p_end,
+		    &dis, &m_turn_los[k]);
+		m_turn_dis[k] = (dis < 255) ? dis : 255;
+	}
+}
+
 void process_monsters(void)
 {
-	int			k, i, e, pl;
+	int			k, n, i, e, dp, lev;
 	int			fx, fy;
+	int			Depth;
 
 	bool		test;
 
@@ -3383,199 +3665,200 @@ void process_monsters(void)
 
 
 
-	/* Process the monsters */
-	for (k = m_top - 1; k >= 0; k--)
+	/* Collect each populated level once */
+	m_turn_levels = n = 0;
+	for (dp = 1; dp <= NumPlayers; dp++)
 	{
-		player_type *p_ptr;
-		int closest = -1, dis_to_closest = 9999, lowhp = 9999;
-		bool closest_in_los = FALSE;
-
-		/* Access the index */
-		i = m_fast[k];
+		Depth = Players[dp]->dun_depth;
 
-		/* Access the monster */
-		m_ptr = &m_list[i];
+		/* Skip levels already collected */
+		for (k = 1; k < dp; k++)
+			if (Players[k]->dun_depth == Depth) break;
+		if (k < dp) continue;
 
+		lev = m_turn_levels++;
+		m_turn_level[lev].Depth = Depth;
+		m_turn_level[lev].epoch = view_epoch[Depth];
 
-		/* Excise "dead" monsters */
-		if (!m_ptr->r_idx)
+		/* Collect the players on this level */
+		m_turn_level[lev].p_start = (lev ? m_turn_level[lev - 1].p_end : 0);
+		m_turn_level[lev].p_end = m_turn_level[lev].p_start;
+		for (k = dp; k <= NumPlayers; k++)
 		{
-			/* Excise the monster */
-			m_fast[k] = m_fast[--m_top];
+			if (Players[k]->dun_depth != Depth) continue;
+			m_turn_players[m_turn_level[lev].p_end] = k;
+			monster_closest_seen(m_turn_level[lev].p_end++);
+		}
 
-			/* Skip */
-			continue;
+		/* Copy the "live" monsters of this level */
+		m_turn_level[lev].m_start = n;
+		for (i = m_depth_first[Depth]; i; i = m_depth_next[i])
+		{
+			m_turn_fy[n] = m_list[i].fy;
+			m_turn_fx[n] = m_list[i].fx;
+			m_turn_idx[n++] = i;
 		}
+		m_turn_level[lev].m_end = n;
+	}
 
+	/* Find everybody's closest player in parallel */
+	if (cfg_level_threads) level_threads_run(monster_closest_level, m_turn_levels);
 
-		/* Find the closest player */
-		for (pl = 1; pl <= NumPlayers; pl++)
-		{
-			int j;
-			bool in_los;
+	/* Process the monsters of each level */
+	for (lev = 0; lev < m_turn_levels; lev++)
+	{
+		Depth = m_turn_level[lev].Depth;
 
-			p_ptr = Players[pl];
+		for (k = m_turn_level[lev].m_start; k < m_turn_level[lev].m_end; k++)
+		{
+			player_type *p_ptr;
+			int closest, dis_to_closest;
+			bool closest_in_los;
 
-			/* Hack -- notice death or departure */
-			if (!p_ptr->alive || p_ptr->death || p_ptr->new_level_flag)
-				continue;
+			/* Access the index */
+			i = m_turn_idx[k];
 
-			/* Make sure he's on the same dungeon level */
-			if (p_ptr->dun_depth != m_ptr->dun_depth)
-				continue;
+			/* Access the monster */
+			m_ptr = &m_list[i];
 
-			/* Hack -- Skip him if he's shopping */
-			if (p_ptr->store_num != -1)
-				continue;
 
-			/* Hack -- make the dungeon master invisible to monsters */
-			if (p_ptr->dm_flags & DM_MONSTER_FRIEND) continue;
+			/* Skip monsters which died (or moved away) meanwhile */
+			if (!m_ptr->r_idx || m_ptr->dun_depth != Depth) continue;
 
-			/* Compute distance */
-			j = distance(p_ptr->py, p_ptr->px, m_ptr->fy, m_ptr->fx);
 
-			/* Compute los */
-			in_los = player_has_los_bold(p_ptr, m_ptr->fy, m_ptr->fx);
+			/* Use the closest player found in advance */
+			closest = -1;
+			if (cfg_level_threads && m_ptr->fy == m_turn_fy[k] &&
+			    m_ptr->fx == m_turn_fx[k] && monster_closest_valid(lev))
+			{
+				closest = m_turn_closest[k];
+				dis_to_closest = m_turn_dis[k];
+				closest_in_los = m_turn_los[k];
+			}
 
-			/* Skip if _not_ in LoS while closest _is_ in */
-			if (!in_los && closest_in_los) continue;
-			
-			/* Only check distance if they share LoS properties */		
-			else if (closest_in_los == in_los) 
+			/* Find the closest player */
+			if (closest == -1)
 			{
-				/* Skip if further than closest */
-				if (j > dis_to_closest) continue;
-	
-				/* Skip if same distance and stronger */
-				if (j == dis_to_closest && p_ptr->chp > lowhp) continue;
+				closest = monster_closest_player(m_ptr,
+				    m_turn_level[lev].p_start, m_turn_level[lev].p_end,
+				    &dis_to_closest, &closest_in_los);
 			}
-			/* Remember this player */
-			dis_to_closest = j;
-			closest = pl;
-			lowhp = p_ptr->chp;
-			closest_in_los = in_los;
-		}
 
-		/* Obtain the energy boost */
-		e = extract_energy[m_ptr->mspeed];
+			/* Obtain the energy boost */
+			e = extract_energy[m_ptr->mspeed];
 		
-		/* If we are within a players time bubble, scale our energy */
-		if(closest > -1)
-		{
-			e = e * ((float)time_factor(Players[closest]) / 100);
-		}
+			/* If we are within a players time bubble, scale our energy */
+			if(closest > -1)
+			{
+				e = e * ((float)time_factor(Players[closest]) / 100);
+			}
 
-		/* Give this monster some energy */
-		m_ptr->energy += e;
+			/* Give this monster some energy */
+			m_ptr->energy += e;
 
-		/* Make sure we don't store up too much energy */
-		if (m_ptr->energy > level_speed(m_ptr->dun_depth))
-			m_ptr->energy = level_speed(m_ptr->dun_depth);
+			/* Make sure we don't store up too much energy */
+			if (m_ptr->energy > level_speed(m_ptr->dun_depth))
+				m_ptr->energy = level_speed(m_ptr->dun_depth);
 
-		/* Not enough energy to move */
-		if (m_ptr->energy < level_speed(m_ptr->dun_depth)) continue;
+			/* Not enough energy to move */
+			if (m_ptr->energy < level_speed(m_ptr->dun_depth)) continue;
 		
-		/* Use some energy */
-		m_ptr->energy -= level_speed(m_ptr->dun_depth);
-
-		/* Paranoia -- Make sure we found a closest player */
-		if (closest == -1)
-			continue;
+			/* Use some energy */
+			m_ptr->energy -= level_speed(m_ptr->dun_depth);
 
-		p_ptr = Players[closest];
+			/* Paranoia -- Make sure we found a closest player */
+			if (closest == -1)
+				continue;
 
-		/* Hack -- calculate the "player noise" */
-		/* noise = (1L << (30 - p_ptr->skill_stl)); // we can do better */
+			p_ptr = Players[closest];
 
-		/* If player has acted this turn, use that noise value (cap to 30) */
-		if (p_ptr->noise)
-		{
-			noise = (1L << (MIN(30, p_ptr->noise)));
-		}
-		/* If player hasn't acted, 1/100 chance to make noise */
-		else if (randint1(100) == 1)
-		{
-			noise = (1L << (30 - p_ptr->skill_stl));
-		}
-		/* Player is totally silent */
-		else noise = 0;
+			/* Hack -- calculate the "player noise" */
+			/* noise = (1L << (30 - p_ptr->skill_stl)); // we can do better */
 
-		m_ptr->cdis = dis_to_closest;
-		m_ptr->closest_player = closest;
+			/* If player has acted this turn, use that noise value (cap to 30) */
+			if (p_ptr->noise)
+			{
+				noise = (1L << (MIN(30, p_ptr->noise)));
+			}
+			/* If player hasn't acted, 1/100 chance to make noise */
+			else if (randint1(100) == 1)
+			{
+				noise = (1L << (30 - p_ptr->skill_stl));
+			}
+			/* Player is totally silent */
+			else noise = 0;
 
-		/* Access the race */
-		r_ptr = &r_info[m_ptr->r_idx];
+			m_ptr->cdis = dis_to_closest;
+			m_ptr->closest_player = closest;
 
-		/* Hack -- Require proximity unless this is a wanderer */
-		if ( !(r_ptr->flags2 & RF2_WANDERER) )
-		{
-			if (m_ptr->cdis >= 100) continue;
-		}
+			/* Access the race */
+			r_ptr = &r_info[m_ptr->r_idx];
 
-		/* Access the location */
-		fx = m_ptr->fx;
-		fy = m_ptr->fy;
+			/* Hack -- Require proximity unless this is a wanderer */
+			if ( !(r_ptr->flags2 & RF2_WANDERER) )
+			{
+				if (m_ptr->cdis >= 100) continue;
+			}
 
-		/* Assume no move */
-		test = FALSE;
+			/* Access the location */
+			fx = m_ptr->fx;
+			fy = m_ptr->fy;
 
-		/* Handle "sensing radius" */
-		if (m_ptr->cdis <= r_ptr->aaf)
-		{
-			/* We can "sense" the player */
-			test = TRUE;
-		}
+			/* Assume no move */
+			test = FALSE;
 
-		/* Handle "sight" and "aggravation" */
-		else if ((m_ptr->cdis <= MAX_SIGHT) &&
-		         (closest_in_los || p_ptr->aggravate))
-		{
-			/* We can "see" or "feel" the player */
-			test = TRUE;
-		}
+			/* Handle "sensing radius" */
+			if (m_ptr->cdis <= r_ptr->aaf)
+			{
+				/* We can "sense" the player */
+				test = TRUE;
+			}
 
-#ifdef MONSTER_FLOW
-		/* Hack -- Monsters can "smell" the player from far away */
-		/* Note that most monsters have "aaf" of "20" or so */
-		else if (flow_by_sound &&
-		         (cave[py][px].when == cave[fy][fx].when) &&
-		         (cave[fy][fx].cost < MONSTER_FLOW_DEPTH) &&
-		         (cave[fy][fx].cost < r_ptr->aaf))
-		{
-			/* We can "smell" the player */
-			test = TRUE;
-		}
-#endif
+			/* Handle "sight" and "aggravation" */
+			else if ((m_ptr->cdis <= MAX_SIGHT) &&
+			         (closest_in_los || p_ptr->aggravate))
+			{
+				/* We can "see" or "feel" the player */
+				test = TRUE;
+			}
 
-		/* Do nothing unless a wanderer */
-		if (!test && !(r_ptr->flags2 & RF2_WANDERER) ) continue;
+			/* Do nothing unless a wanderer */
+			if (!test && !(r_ptr->flags2 & RF2_WANDERER) ) continue;
 
 
-		/* Process the monster */
-		process_monster(closest, i);
+			/* Process the monster */
+			process_monster(closest, i);
+		}
 	}
 
 	/* Only when needed, every five game turns */
 	if (scan_monsters && (!(turn.turn%5)))
 	{
-		/* Shimmer multi-hued monsters */
-		for (i = 1; i < m_max; i++)
+		/* Shimmer multi-hued monsters on populated levels */
+		for (dp = 1; dp <= NumPlayers; dp++)
 		{
-			monster_race *r_ptr;
+			Depth = Players[dp]->dun_depth;
 
-			m_ptr = &m_list[i];
+			/* Skip levels already handled */
+			for (k = 1; k < dp; k++)
+				if (Players[k]->dun_depth == Depth) break;
+			if (k < dp) continue;
 
-			/* Skip dead monsters */
-			if (!m_ptr->r_idx) continue;
+			for (i = m_depth_first[Depth]; i; i = m_depth_next[i])
+			{
+				monster_race *r_ptr;
 
-			/* Access the monster race */
-			r_ptr = &r_info[m_ptr->r_idx];
+				m_ptr = &m_list[i];
 
-			/* Skip non-multi-hued monsters */
-			if (!(r_ptr->flags1 & RF1_ATTR_MULTI)) continue;
+				/* Access the monster race */
+				r_ptr = &r_info[m_ptr->r_idx];
 
-			/* Shimmer Multi-Hued Monsters */
-			everyone_lite_spot(m_ptr->dun_depth, m_ptr->fy, m_ptr->fx);
+				/* Skip non-multi-hued monsters */
+				if (!(r_ptr->flags1 & RF1_ATTR_MULTI)) continue;
+
+				/* Shimmer Multi-Hued Monsters */
+				everyone_lite_spot(m_ptr->dun_depth, m_ptr->fy, m_ptr->fx);
+			}
 		}
 	}
 }
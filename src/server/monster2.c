@@ -35,6 +35,33 @@ bool allow_unique_level(int r_idx, int Depth)
 }
 
 
+/*
+ * Add a monster to the list of "live" monsters on its depth
+ */
+static void m_depth_link(int i, int Depth)
+{
+	int head = m_depth_first[Depth];
+
+	m_depth_prev[i] = 0;
+	m_depth_next[i] = head;
+	if (head) m_depth_prev[head] = i;
+	m_depth_first[Depth] = i;
+}
+
+/*
+ * Remove a monster from the list of "live" monsters on its depth
+ */
+static void m_depth_unlink(int i, int Depth)
+{
+	int prev = m_depth_prev[i], next = m_depth_next[i];
+
+	if (prev) m_depth_next[prev] = next;
+	else if (m_depth_first[Depth] == i) m_depth_first[Depth] = next;
+	if (next) m_depth_prev[next] = prev;
+	m_depth_prev[i] = m_depth_next[i] = 0;
+}
+
+
 /*
  * Delete a monster by index.
  *
@@ -42,7 +69,8 @@ bool allow_unique_level(int r_idx, int Depth)
  * all intents and purposes.  The monster record is left in place
  * but the record is wiped, marking it as "dead" (no race index)
  * so that it can be "skipped" when scanning the monster array,
- * and "excised" from the "m_fast" array when needed.
+ * and it is removed from the "live" list of its depth at once,
+ * and put on the list of dead monsters for "m_pop()" to reuse.
  *
  * Thus, anyone who makes direct reference to the "m_list[]" array
  * using monster indexes that may have become invalid should be sure
@@ -64,6 +92,13 @@ void delete_monster_idx(int i)
 	x = m_ptr->fx;
 	Depth = m_ptr->dun_depth;
 
+	/* Paranoia -- already dead */
+	if (!m_ptr->r_idx) return;
+
+	/* No longer "live" */
+	m_depth_unlink(i, Depth);
+	m_top--;
+
 
 	/* Hack -- Reduce the racial counter */
 	r_ptr->cur_num--;
@@ -107,6 +142,10 @@ void delete_monster_idx(int i)
 
 	/* Wipe the Monster */
 	WIPE(m_ptr, monster_type);
+
+	/* Ready for reuse */
+	m_depth_next[i] = m_free;
+	m_free = i;
 }
 
 
@@ -180,12 +219,14 @@ static void compact_monsters_aux(int i1, int i2)
 	for (Ind = 1; Ind <= NumPlayers; Ind++)
 	{
 
-		Players[Ind]->mon_vis[i2] = Players[Ind]->mon_vis[i1];
-		Players[Ind]->mon_los[i2] = Players[Ind]->mon_los[i1];
-		Players[Ind]->mon_det[i2] = Players[Ind]->mon_det[i1];
+		vis_set(Players[Ind]->mon_vis, i2, vis_has(Players[Ind]->mon_vis, i1));
+		if (vis_has(Players[Ind]->mon_los, i2)) Players[Ind]->mon_los_num--;
+		vis_set(Players[Ind]->mon_los, i2, vis_has(Players[Ind]->mon_los, i1));
+		vis_off(Players[Ind]->mon_los, i1);
+		move_monster_detection(Players[Ind], i1, i2);
 		
 		/* Hack -- copy hurt flag */
-		Players[Ind]->mon_hrt[i2] = Players[Ind]->mon_hrt[i1];;
+		vis_set(Players[Ind]->mon_hrt, i2, vis_has(Players[Ind]->mon_hrt, i1));;
 
 		/* Hack -- Update the target */
 		if (Players[Ind]->target_who == (int)(i1)) Players[Ind]->target_who = i2;
@@ -291,18 +332,21 @@ void compact_monsters(int size)
 		m_max--;
 	}
 
-	/* Reset "m_nxt" */
-	m_nxt = m_max;
+	/* No more dead monsters */
+	m_free = 0;
 
 
 	/* Reset "m_top" */
 	m_top = 0;
 
-	/* Collect "live" monsters */
-	for (i = 1; i < m_max; i++)
+	/* Forget the old depth lists */
+	C_WIPE(&m_depth_first[-MAX_WILD], MAX_DEPTH + MAX_WILD, s16b);
+
+	/* Collect "live" monsters (backwards, so each list is in order) */
+	for (i = m_max - 1; i >= 1; i--)
 	{
-		/* Collect indexes */
-		m_fast[m_top++] = i;
+		m_depth_link(i, m_list[i].dun_depth);
+		m_top++;
 	}
 }
 
@@ -359,16 +403,10 @@ void wipe_m_list(int Depth)
 #endif
 
 	/* Delete all the monsters */
-	for (i = m_max - 1; i >= 1; i--)
+	while ((i = m_depth_first[Depth]))
 	{
-		monster_type *m_ptr = &m_list[i];
-
-		if (m_ptr->dun_depth == Depth)
-			delete_monster_idx(i);
+		delete_monster_idx(i);
 	}
-
-	/* Compact the monster list */
-	compact_monsters(0);
 }
 
 
@@ -377,60 +415,49 @@ void wipe_m_list(int Depth)
  *
  * This routine should almost never fail, but it *can* happen.
  *
- * Note that this function must maintain the special "m_fast"
- * array of indexes of "live" monsters.
+ * Note that this function must maintain the "live" monster list
+ * of the given depth, the caller is expected to place the monster
+ * there by setting "dun_depth" to the same "Depth".
+ *
+ * Dead monsters (see "delete_monster_idx()") are reused first, so we
+ * never have to search the monster array for a free slot.
  */
-s16b m_pop(void)
+s16b m_pop(int Depth)
 {
-	int i, n, k;
+	int i;
 
 
-	/* Normal allocation */
-	if (m_max < MAX_M_IDX)
+	/* Reuse a dead monster */
+	if (m_free)
 	{
-		/* Access the next hole */
-		i = m_max;
+		i = m_free;
 
-		/* Expand the array */
-		m_max++;
+		/* Remove it from the dead list */
+		m_free = m_depth_next[i];
 
-		/* Update "m_fast" */
-		m_fast[m_top++] = i;
+		/* Update the "live" list */
+		m_depth_link(i, Depth);
+		m_top++;
 
-		/* Return the index */
+		/* Use this monster */
 		return (i);
 	}
 
 
-	/* Check for some space */
-	for (n = 1; n < MAX_M_IDX; n++)
+	/* Normal allocation */
+	if (m_max < MAX_M_IDX)
 	{
-		/* Get next space */
-		i = m_nxt;
-
-		/* Advance (and wrap) the "next" pointer */
-		if (++m_nxt >= MAX_M_IDX) m_nxt = 1;
-
-		/* Skip monsters in use */
-		if (m_list[i].r_idx) continue;
-
-		/* Verify space XXX XXX */
-		if (m_top >= MAX_M_IDX) continue;
-
-		/* Verify not allocated */
-		for (k = 0; k < m_top; k++)
-		{
-			/* Hack -- Prevent errors */
-			if (m_fast[k] == i) i = 0;
-		}
+		/* Access the next hole */
+		i = m_max;
 
-		/* Oops XXX XXX */
-		if (!i) continue;
+		/* Expand the array */
+		m_max++;
 
-		/* Update "m_fast" */
-		m_fast[m_top++] = i;
+		/* Update the "live" list */
+		m_depth_link(i, Depth);
+		m_top++;
 
-		/* Use this monster */
+		/* Return the index */
 		return (i);
 	}
 
@@ -520,7 +547,6 @@ s16b get_mon_num(int level)
 	long		value, total;
 
 	monster_race	*r_ptr;
-	monster_type	*m_ptr;
 
 	alloc_entry		*table = alloc_race_table;
 
@@ -541,17 +567,7 @@ s16b get_mon_num(int level)
 	j = 0;
 	if (level == 0)
 	{
-		for (i = m_top - 1; i >= 0; i--)
-		{
-			/* Access the index */
-			p = m_fast[i];
-
-			/* Access the monster */
-			m_ptr = &m_list[p];
-			
-			/* Count townies */
-			if (m_ptr->dun_depth == 0) j++;
-		}
+		for (p = m_depth_first[0]; p; p = m_depth_next[p]) j++;
 	}
 	if (j > cfg_max_townies) return(0);
 	
@@ -745,7 +761,7 @@ void display_monlist(player_type *p_ptr)
 		m_ptr = &m_list[idx];
 
 		/* Only visible monsters */
-		if (!p_ptr->mon_vis[idx]) continue;
+		if (!vis_has(p_ptr->mon_vis, idx)) continue;
 
 		/* Hack -- ignore mimics, unless DM */
 		if (m_ptr->mimic_k_idx && !(p_ptr->dm_flags & DM_SEE_MONSTERS)) continue;
@@ -762,7 +778,7 @@ void display_monlist(player_type *p_ptr)
 		m_ptr = &m_list[idx];
 
 		/* Only visible monsters */
-		if (!p_ptr->mon_vis[idx]) continue;
+		if (!vis_has(p_ptr->mon_vis, idx)) continue;
 
 		/* Do each race only once */
 		if (!race_counts[m_ptr->r_idx]) continue;
@@ -812,7 +828,7 @@ void display_monlist(player_type *p_ptr)
 	for (idx = 1; idx <= NumPlayers; idx++)
 	{
 		/* Only visible players */
-		if (!p_ptr->play_vis[idx]) continue;
+		if (!vis_has(p_ptr->play_vis, idx)) continue;
 
 		q_ptr = Players[idx];
 
@@ -909,7 +925,7 @@ void monster_desc(player_type *p_ptr, char *desc, int m_idx, int mode)
 	if (p_ptr)
 	{
 		/* Can we "see" it (exists + forced, or visible + not unforced) */
-		seen = (m_ptr && ((mode & 0x80) || (!(mode & 0x40) && p_ptr->mon_vis[m_idx])));
+		seen = (m_ptr && ((mode & 0x80) || (!(mode & 0x40) && vis_has(p_ptr->mon_vis, m_idx))));
 	}
 	else
 	{
@@ -1125,7 +1141,7 @@ s16b monster_carry(player_type *p_ptr, int m_idx, object_type *j_ptr)
 
 
 	/* Make an object */
-	o_idx = o_pop();
+	o_idx = o_pop(m_ptr->dun_depth);
 
 	/* Success */
 	if (o_idx)
@@ -1144,6 +1160,9 @@ s16b monster_carry(player_type *p_ptr, int m_idx, object_type *j_ptr)
 		/* Forget location */
 		o_ptr->iy = o_ptr->ix = 0;
 
+		/* Same level as the monster */
+		o_ptr->dun_depth = m_ptr->dun_depth;
+
 		/* Link the object to the monster */
 		o_ptr->held_m_idx = m_idx;
 
@@ -1218,18 +1237,129 @@ void reveal_mimic(int m_idx)
 		/* Skip players on different depth */
 		if (p_ptr->dun_depth != m_ptr->dun_depth) continue;
 		/* Skip players who don't see this monster */
-		if (!p_ptr->mon_vis[m_idx]) continue;
+		if (!vis_has(p_ptr->mon_vis, m_idx)) continue;
 
 		lite_spot(p_ptr, m_ptr->fy, m_ptr->fx);
 		p_ptr->window |= PW_ITEMLIST | PW_MONLIST;
 	}
 }
 
+/*
+ * Monster detection.  Detected monsters are marked in the "mon_det" bit
+ * set, and how long each of them stays detected is kept in a short list
+ * ("mon_det_idx[]"/"mon_det_pow[]") which is only as long as needed.
+ */
+static int find_monster_detection(player_type *p_ptr, int m_idx)
+{
+	int k;
+
+	for (k = 0; k < p_ptr->mon_det_num; k++)
+	{
+		if (p_ptr->mon_det_idx[k] == m_idx) return (k);
+	}
+
+	return (-1);
+}
+
+/* Return the detection counter of a monster (zero if not detected) */
+byte monster_detection(player_type *p_ptr, int m_idx)
+{
+	int k;
+
+	if (!vis_has(p_ptr->mon_det, m_idx)) return (0);
+
+	k = find_monster_detection(p_ptr, m_idx);
+
+	return (k < 0 ? 0 : p_ptr->mon_det_pow[k]);
+}
+
+/* Increase the detection counter of a monster */
+void add_monster_detection(player_type *p_ptr, int m_idx, int power)
+{
+	int k = -1, i;
+
+	if (vis_has(p_ptr->mon_det, m_idx)) k = find_monster_detection(p_ptr, m_idx);
+
+	/* New entry */
+	if (k < 0)
+	{
+		/* List is full, drop the one about to fade anyway */
+		if (p_ptr->mon_det_num >= MAX_DETECTED)
+		{
+			for (k = 0, i = 1; i < p_ptr->mon_det_num; i++)
+			{
+				if (p_ptr->mon_det_pow[i] < p_ptr->mon_det_pow[k]) k = i;
+			}
+			vis_off(p_ptr->mon_det, p_ptr->mon_det_idx[k]);
+		}
+		else k = p_ptr->mon_det_num++;
+
+		p_ptr->mon_det_idx[k] = m_idx;
+		p_ptr->mon_det_pow[k] = 0;
+		vis_on(p_ptr->mon_det, m_idx);
+	}
+
+	p_ptr->mon_det_pow[k] = MIN((int)p_ptr->mon_det_pow[k] + power, 255);
+}
+
+/* Stop detecting a monster */
+void forget_monster_detection(player_type *p_ptr, int m_idx)
+{
+	int k;
+
+	if (!vis_has(p_ptr->mon_det, m_idx)) return;
+	vis_off(p_ptr->mon_det, m_idx);
+
+	k = find_monster_detection(p_ptr, m_idx);
+	if (k < 0) return;
+
+	/* Fill the hole with the last entry */
+	p_ptr->mon_det_num--;
+	p_ptr->mon_det_idx[k] = p_ptr->mon_det_idx[p_ptr->mon_det_num];
+	p_ptr->mon_det_pow[k] = p_ptr->mon_det_pow[p_ptr->mon_det_num];
+}
+
+/* A detected monster was moved to another index */
+void move_monster_detection(player_type *p_ptr, int i1, int i2)
+{
+	int k;
+
+	forget_monster_detection(p_ptr, i2);
+
+	if (!vis_has(p_ptr->mon_det, i1)) return;
+	vis_off(p_ptr->mon_det, i1);
+
+	k = find_monster_detection(p_ptr, i1);
+	if (k < 0) return;
+
+	p_ptr->mon_det_idx[k] = i2;
+	vis_on(p_ptr->mon_det, i2);
+}
+
+/*
+ * Fade monster detection over time
+ */
+void fade_monster_detection(player_type *p_ptr)
+{
+	int k, m_idx;
+
+	/* Backwards, as faded entries are replaced by the last one */
+	for (k = p_ptr->mon_det_num - 1; k >= 0; k--)
+	{
+		if (--p_ptr->mon_det_pow[k] == 0)
+		{
+			m_idx = p_ptr->mon_det_idx[k];
+			forget_monster_detection(p_ptr, m_idx);
+			update_mon(m_idx, FALSE);
+		}
+	}
+}
+
 /* Clear all visibility and tracking flags. */
 void forget_monster(player_type *p_ptr, int m_idx, bool deleted)
 {
 	/* Was visible? Update monster list then */
-	if (p_ptr->mon_vis[m_idx]) p_ptr->window |= (PW_MONLIST);
+	if (vis_has(p_ptr->mon_vis, m_idx)) p_ptr->window |= (PW_MONLIST);
 
 	/* Remove cursor tracking */
 	if (p_ptr->cursor_who == m_idx)
@@ -1249,12 +1379,13 @@ void forget_monster(player_type *p_ptr, int m_idx, bool deleted)
 	if (p_ptr->health_who == m_idx) health_track(p_ptr, 0);
 
 	/* Clear all visibility flags */
-	p_ptr->mon_vis[m_idx] = FALSE;
-	p_ptr->mon_los[m_idx] = FALSE;
-	p_ptr->mon_det[m_idx] = 0;
+	vis_off(p_ptr->mon_vis, m_idx);
+	if (vis_has(p_ptr->mon_los, m_idx)) p_ptr->mon_los_num--;
+	vis_off(p_ptr->mon_los, m_idx);
+	forget_monster_detection(p_ptr, m_idx);
 
 	/* Remove hurt flag (only if monster is completely dead) */
-	if (deleted) p_ptr->mon_hrt[m_idx] = FALSE;
+	if (deleted) vis_off(p_ptr->mon_hrt, m_idx);
 }
 
 /*
@@ -1452,16 +1583,16 @@ void update_mon(int m_idx, bool dist)
 		}
 
 		/* HACK ! - Detected via magical means, counts as "hard" */
-		if (p_ptr->mon_det[m_idx]) hard = flag = TRUE;
+		if (vis_has(p_ptr->mon_det, m_idx)) hard = flag = TRUE;
 
 		/* The monster is now visible */
 		if (flag)
 		{
 			/* It was previously unseen */
-			if (!p_ptr->mon_vis[m_idx])
+			if (!vis_has(p_ptr->mon_vis, m_idx))
 			{
 				/* Mark as visible */
-				p_ptr->mon_vis[m_idx] = TRUE;
+				vis_on(p_ptr->mon_vis, m_idx);
 
 				/* Draw the monster */
 				lite_spot(p_ptr, fy, fx);
@@ -1496,10 +1627,10 @@ void update_mon(int m_idx, bool dist)
 		else
 		{
 			/* It was previously seen */
-			if (p_ptr->mon_vis[m_idx])
+			if (vis_has(p_ptr->mon_vis, m_idx))
 			{
 				/* Mark as not visible */
-				p_ptr->mon_vis[m_idx] = FALSE;
+				vis_off(p_ptr->mon_vis, m_idx);
 
 				/* Erase the monster */
 				lite_spot(p_ptr, fy, fx);
@@ -1520,10 +1651,11 @@ void update_mon(int m_idx, bool dist)
 		if (easy || (hard && nearby))
 		{
 			/* Change */
-			if (!p_ptr->mon_los[m_idx])
+			if (!vis_has(p_ptr->mon_los, m_idx))
 			{
 				/* Mark as easily visible */
-				p_ptr->mon_los[m_idx] = TRUE;
+				vis_on(p_ptr->mon_los, m_idx);
+				p_ptr->mon_los_num++;
 
 				/* Disturb on appearance */
 				if (option_p(p_ptr,DISTURB_NEAR)) disturb(p_ptr, 1, 0);
@@ -1534,10 +1666,11 @@ void update_mon(int m_idx, bool dist)
 		else
 		{
 			/* Change */
-			if (p_ptr->mon_los[m_idx])
+			if (vis_has(p_ptr->mon_los, m_idx))
 			{
 				/* Mark as not easily visible */
-				p_ptr->mon_los[m_idx] = FALSE;
+				vis_off(p_ptr->mon_los, m_idx);
+				p_ptr->mon_los_num--;
 
 				/* Disturb on disappearance */
 				if (option_p(p_ptr,DISTURB_NEAR)) disturb(p_ptr, 1, 0);
@@ -1553,6 +1686,9 @@ void update_mon(int m_idx, bool dist)
 
 /*
  * This function simply updates all the (non-dead) monsters (see above).
+ *
+ * Note that this handles every level, which is only needed when a player
+ * changes level; see "update_monsters_depth()" for the usual case.
  */
 void update_monsters(bool dist)
 {
@@ -1575,6 +1711,24 @@ void update_monsters(bool dist)
 }
 
 
+/*
+ * This function updates all the monsters on the given level (see above).
+ *
+ * Every player's view is updated, not only the one who asked, as the
+ * "CAVE_LITE" and "CAVE_GLOW" grids are shared by the whole level.
+ */
+void update_monsters_depth(int Depth, bool dist)
+{
+	int i;
+
+	/* Update each monster on this level */
+	for (i = m_depth_first[Depth]; i; i = m_depth_next[i])
+	{
+		update_mon(i, dist);
+	}
+}
+
+
 /*
  * This function updates the visiblity flags for everyone who may see
  * this player.
@@ -1682,10 +1836,10 @@ void update_player(player_type *q_ptr)
 		if (flag)
 		{
 			/* It was previously unseen */
-			if (!p_ptr->play_vis[q_ptr->Ind])
+			if (!vis_has(p_ptr->play_vis, q_ptr->Ind))
 			{
 				/* Mark as visible */
-				p_ptr->play_vis[q_ptr->Ind] = TRUE;
+				vis_on(p_ptr->play_vis, q_ptr->Ind);
 
 				/* Draw the player */
 				lite_spot(p_ptr, py, px);
@@ -1706,10 +1860,10 @@ void update_player(player_type *q_ptr)
 		else
 		{
 			/* It was previously seen */
-			if (p_ptr->play_vis[q_ptr->Ind])
+			if (vis_has(p_ptr->play_vis, q_ptr->Ind))
 			{
 				/* Mark as not visible */
-				p_ptr->play_vis[q_ptr->Ind] = FALSE;
+				vis_off(p_ptr->play_vis, q_ptr->Ind);
 
 				/* Erase the player */
 				lite_spot(p_ptr, py, px);
@@ -1730,10 +1884,11 @@ void update_player(player_type *q_ptr)
 		if (easy || (hard && nearby))
 		{
 			/* Change */
-			if (!p_ptr->play_los[q_ptr->Ind])
+			if (!vis_has(p_ptr->play_los, q_ptr->Ind))
 			{
 				/* Mark as easily visible */
-				p_ptr->play_los[q_ptr->Ind] = TRUE;
+				vis_on(p_ptr->play_los, q_ptr->Ind);
+				p_ptr->play_los_num++;
 
 				/* Disturb on appearance */
 				if (option_p(p_ptr,DISTURB_NEAR) && check_hostile(p_ptr, q_ptr))
@@ -1748,10 +1903,11 @@ void update_player(player_type *q_ptr)
 		else
 		{
 			/* Change */
-			if (p_ptr->play_los[q_ptr->Ind])
+			if (vis_has(p_ptr->play_los, q_ptr->Ind))
 			{
 				/* Mark as not easily visible */
-				p_ptr->play_los[q_ptr->Ind] = FALSE;
+				vis_off(p_ptr->play_los, q_ptr->Ind);
+				p_ptr->play_los_num--;
 
 				/* Disturb on disappearance */
 				if (option_p(p_ptr,DISTURB_NEAR) && check_hostile(p_ptr, q_ptr))
@@ -1781,6 +1937,24 @@ void update_players(void)
 	}
 }
 
+/*
+ * This function updates all the players on the given level (see above).
+ */
+void update_players_depth(int Depth)
+{
+	int i;
+
+	/* Update each player on this level */
+	for (i = 1; i <= NumPlayers; i++)
+	{
+		/* Skip players elsewhere */
+		if (Players[i]->dun_depth != Depth) continue;
+
+		/* Update the player */
+		update_player(Players[i]);
+	}
+}
+
 
 /*
  * Attempt to place a monster of the given race at the given location.
@@ -1883,7 +2057,7 @@ static bool place_monster_one(int Depth, int y, int x, int r_idx, bool slp)
 	c_ptr = &cave[Depth][y][x];
 
 	/* Make a new monster */
-	c_ptr->m_idx = m_pop();
+	c_ptr->m_idx = m_pop(Depth);
 
 	/* Mega-Hack -- catch "failure" */
 	if (!c_ptr->m_idx) return (FALSE);
@@ -1961,10 +2135,11 @@ static bool place_monster_one(int Depth, int y, int x, int r_idx, bool slp)
 
 	for (Ind = 1; Ind <= NumPlayers; Ind++)
 	{
-		Players[Ind]->mon_los[c_ptr->m_idx] = FALSE;
-		Players[Ind]->mon_vis[c_ptr->m_idx] = FALSE;
-		Players[Ind]->mon_det[c_ptr->m_idx] = 0;
-		Players[Ind]->mon_hrt[c_ptr->m_idx] = FALSE;		
+		if (vis_has(Players[Ind]->mon_los, c_ptr->m_idx)) Players[Ind]->mon_los_num--;
+		vis_off(Players[Ind]->mon_los, c_ptr->m_idx);
+		vis_off(Players[Ind]->mon_vis, c_ptr->m_idx);
+		forget_monster_detection(Players[Ind], c_ptr->m_idx);
+		vis_off(Players[Ind]->mon_hrt, c_ptr->m_idx);		
 	}
 
 	/* Update the monster */
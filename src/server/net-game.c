@@ -18,9 +18,45 @@ static int		(*pcommands[256])(player_type *p_ptr);
 static byte		command_pkt[256];
 static byte		pkt_command[256];
 static u16b		pcommand_energy_cost[256];
+static int		custom_scheme_sizes[SCHEME_LAST+1]; /* See "cq_scheme_size" */
+
+/* Streams of the main dungeon view, which can be sent as row-deltas */
+#define DELTA_STREAM(ST) ((ST) <= STREAM_DUNGEON_GRAF2)
+
+/* Traffic accounting -- note that packet "pkt" is about to be queued.
+ * Bytes queued since the previous call are accounted to the previous
+ * packet, so we don't care how each packet is built or rolled back. */
+static void packet_out(connection_type *ct, byte pkt)
+{
+	player_type *p_ptr;
+	s64b total;
+	int bytes;
+
+	/* Not a player (yet) */
+	if (ct->user < 0)
+	{
+		server_pkt_out[pkt].count++;
+		return;
+	}
+	p_ptr = players->list[(int)ct->user]->data2;
+
+	total = ct->wsent + cq_len(&ct->wbuf);
+	bytes = (int)(total - p_ptr->pkt_out_mark);
+
+	/* Hack -- buffer was cleared (see "send_quit") */
+	if (bytes < 0) bytes = 0;
+
+	p_ptr->pkt_out[p_ptr->pkt_out_last].bytes += bytes;
+	server_pkt_out[p_ptr->pkt_out_last].bytes += bytes;
+
+	count_packet(p_ptr->pkt_out, server_pkt_out, pkt, 0, 0);
+	p_ptr->pkt_out_last = pkt;
+	p_ptr->pkt_out_mark = total;
+}
 
 int send_play(connection_type *ct, byte mode) 
 {
+	packet_out(ct, PKT_PLAY);
 	if (!cq_printf(&ct->wbuf, "%c%b", PKT_PLAY, mode))
 	{
 		client_withdraw(ct);
@@ -31,6 +67,7 @@ int send_play(connection_type *ct, byte mode)
 int send_quit(connection_type *ct, const char *reason) 
 {
 	/* Initial attempt might fail due to buffer overflow */
+	packet_out(ct, PKT_QUIT);
 	if (cq_printf(&ct->wbuf, "%c%S", PKT_QUIT, reason) > 0) return 1;
 
 	/* In this case, clear the buffer and try again */
@@ -46,6 +83,7 @@ int send_server_info(connection_type *ct)
 	/* Begin cq "transaction" */
 	int start_pos = ct->wbuf.len;
 
+	packet_out(ct, PKT_BASIC_INFO);
 	if (!cq_printf(&ct->wbuf, "%c%b%b%b%b", PKT_BASIC_INFO, serv_info.val1, serv_info.val2, serv_info.val3, serv_info.val4))
 	{
 		ct->wbuf.len = start_pos; /* rewind */
@@ -63,6 +101,7 @@ int send_server_info(connection_type *ct)
 
 int send_char_info(connection_type *ct, player_type *p_ptr)
 {
+	packet_out(ct, PKT_CHAR_INFO);
 	if (!cq_printf(&ct->wbuf, "%c%d%d%d%d", PKT_CHAR_INFO, p_ptr->state, p_ptr->prace, p_ptr->pclass, p_ptr->male))
 	{
 		client_withdraw(ct);
@@ -76,6 +115,7 @@ int send_stats_info(connection_type *ct)
 
 	int start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
+	packet_out(ct, PKT_STRUCT_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c", PKT_STRUCT_INFO, STRUCT_INFO_STATS) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rollback */
@@ -105,6 +145,7 @@ int send_race_info(connection_type *ct)
 
 	int start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
+	packet_out(ct, PKT_STRUCT_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c", PKT_STRUCT_INFO, STRUCT_INFO_RACE) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rollback */
@@ -136,6 +177,7 @@ int send_class_info(connection_type *ct)
 
 	int start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
+	packet_out(ct, PKT_STRUCT_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c", PKT_STRUCT_INFO, STRUCT_INFO_CLASS) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rollback */
@@ -168,6 +210,7 @@ int send_optgroups_info(connection_type *ct)
 
 	int start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
+	packet_out(ct, PKT_STRUCT_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c", PKT_STRUCT_INFO, STRUCT_INFO_OPTGROUP) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rollback */
@@ -197,6 +240,7 @@ int send_option_info_DEPRECATED(connection_type *ct, int id)
 {
 	const option_type *opt_ptr = &option_info[id];
 
+	packet_out(ct, PKT_OPTION);
 	if (cq_printf(&ct->wbuf, "%c%c%s%s", PKT_OPTION, 
 		opt_ptr->o_page, opt_ptr->o_text, opt_ptr->o_desc) <= 0)
 	{
@@ -210,6 +254,7 @@ int send_option_info(connection_type *ct, player_type *p_ptr, int id)
 
 	if (!client_version_atleast(p_ptr->version,1,5,3)) return send_option_info_DEPRECATED(ct, id);
 
+	packet_out(ct, PKT_OPTION);
 	if (cq_printf(&ct->wbuf, "%c" "%c%c%s%s", PKT_OPTION,
 		opt_ptr->o_page, opt_ptr->o_norm,
 		opt_ptr->o_text, opt_ptr->o_desc) <= 0)
@@ -227,6 +272,7 @@ int send_inventory_info_DEPRECATED(connection_type *ct)
 
 	int start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
+	packet_out(ct, PKT_STRUCT_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c", PKT_STRUCT_INFO, STRUCT_INFO_INVEN) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rollback */
@@ -266,6 +312,7 @@ int send_inventory_info(connection_type *ct)
 
 	int start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
+	packet_out(ct, PKT_STRUCT_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c", PKT_STRUCT_INFO, STRUCT_INFO_INVEN) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rollback */
@@ -311,6 +358,7 @@ int send_objflags_info(connection_type *ct)
 
 	int start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
+	packet_out(ct, PKT_STRUCT_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c", PKT_STRUCT_INFO, STRUCT_INFO_OBJFLAGS) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rollback */
@@ -333,6 +381,7 @@ int send_floor_info(connection_type *ct)
 
 	int start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
+	packet_out(ct, PKT_STRUCT_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c", PKT_STRUCT_INFO, STRUCT_INFO_FLOOR) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rollback */
@@ -353,6 +402,7 @@ int send_indicator_info(connection_type *ct, int id)
 	const indicator_type *i_ptr = &indicators[id];
 	if (!i_ptr->mark) return 1; /* Last one */
 
+	packet_out(ct, PKT_INDICATOR);
 	if (cq_printf(&ct->wbuf, "%c%c%c%c%c%d%d%ul%S%s", PKT_INDICATOR,
 		i_ptr->pkt, i_ptr->type, i_ptr->amnt,
 		i_ptr->win, i_ptr->row, i_ptr->col,
@@ -384,6 +434,46 @@ int send_indication(player_type *p_ptr, int id, ...)
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
 
+	packet_out(ct, i_ptr->pkt);
+
+	/* Numeric indicators have fixed size, pack them straight */
+	if (i_ptr->type != INDITYPE_STRING)
+	{
+		char *w;
+		int width = (i_ptr->type == INDITYPE_TINY ? 1 :
+		            (i_ptr->type == INDITYPE_NORMAL ? 2 : 4));
+
+		if (!(w = cq_reserve(&ct->wbuf, 1 + MAX(i_ptr->amnt, 1) * width)))
+		{
+			client_withdraw(ct);
+		}
+		PACK_PTR_8(w, i_ptr->pkt);
+
+		va_start( marker, id );
+		do
+		{
+			if (i_ptr->type == INDITYPE_TINY)
+			{
+				tiny_c = (signed char) va_arg (marker, unsigned int);
+				PACK_PTR_8(w, tiny_c);
+			}
+			else if (i_ptr->type == INDITYPE_NORMAL)
+			{
+				normal_c = (s16b) va_arg (marker, unsigned int);
+				PACK_PTR_16(w, normal_c);
+			}
+			else
+			{
+				large_c = (s32b) va_arg (marker, s32b);
+				PACK_PTR_32(w, large_c);
+			}
+		} while (++i < i_ptr->amnt);
+		va_end( marker );
+
+		cq_commit(&ct->wbuf, w);
+		return 0;
+	}
+
 	start_pos = ct->wbuf.len; /* begin cq "transaction" */
 
 	if (!cq_printf(&ct->wbuf, "%c", i_ptr->pkt))
@@ -435,6 +525,7 @@ int send_stream_info(connection_type *ct, int id)
 	const stream_type *s_ptr = &streams[id];
 	if (!s_ptr->pkt) return 1; /* Last one */
 
+	packet_out(ct, PKT_STREAM);
 	if (cq_printf(&ct->wbuf, "%c" "%c%c%c%c" "%s%s" "%ud%c%ud%c", PKT_STREAM,
 		s_ptr->pkt, s_ptr->addr, s_ptr->rle, s_ptr->flag,
 		s_ptr->mark, s_ptr->window_desc,
@@ -453,6 +544,7 @@ int send_stream_size(connection_type *ct, int st, int y, int x)
 	if (!ct) return -1;
 
 	/* Acknowledge new size for stream */
+	packet_out(ct, PKT_RESIZE);
 	if (cq_printf(&ct->wbuf, "%c" "%b%ud%b", PKT_RESIZE, (byte)st, (u16b)y, (byte)x) <= 0)
 	{
 		client_withdraw(ct);
@@ -466,7 +558,8 @@ int stream_char_raw(player_type *p_ptr, int st, int y, int x, byte a, char c, by
 	connection_type *ct;
 	const stream_type *stream = &streams[st];
 	u16b l;
-	int n;
+	bool trn;
+	char *w;
 
 	/* Programmer error */
 	if (y > 127 || x > 255) { printf("stream_char is limited to y <= 127, x <= 255, you are using y %d, x %d\n", y, x); return -1; }
@@ -480,14 +573,34 @@ int stream_char_raw(player_type *p_ptr, int st, int y, int x, byte a, char c, by
 
 	/* Header + Body (with or without transperancy) */
 	l = ((y << 8) & 0x7F00) | (x & 0x00FF) | 0x8000;
-	if (stream->flag & SF_TRANSPARENT)
-		n = cq_printf(&ct->wbuf, "%c%d%c%c%c%c", stream->pkt, l, a, c, a, c);
-	else
-		n = cq_printf(&ct->wbuf, "%c%d%c%c", stream->pkt, l, a, c);
-	if (n <= 0)
+	trn = (stream->flag & SF_TRANSPARENT) ? TRUE : FALSE;
+	packet_out(ct, stream->pkt);
+	if (!(w = cq_reserve(&ct->wbuf, trn ? 7 : 5)))
 	{
 		client_withdraw(ct);
 	}
+	PACK_PTR_8(w, stream->pkt);
+	PACK_PTR_16(w, l);
+	PACK_PTR_8(w, a);
+	PACK_PTR_8(w, c);
+	if (trn)
+	{
+		PACK_PTR_8(w, a);
+		PACK_PTR_8(w, c);
+	}
+	cq_commit(&ct->wbuf, w);
+
+	/* Client memorizes it */
+	if (DELTA_STREAM(st) && y < MAX_HGT && x < MAX_WID)
+	{
+		p_ptr->sent_info[y][x].a = a;
+		p_ptr->sent_info[y][x].c = c;
+		if (trn)
+		{
+			p_ptr->sent_trn[y][x].a = a;
+			p_ptr->sent_trn[y][x].c = c;
+		}
+	}
 
 	/* Ok */
 	return 1;
@@ -499,7 +612,8 @@ int stream_char(player_type *p_ptr, int st, int y, int x)
 	const stream_type *stream = &streams[st];
 	cave_view_type *source = p_ptr->stream_cave[st] + y * MAX_WID;
 	u16b l;
-	int n;
+	bool trn;
+	char *w;
 
 	/* Programmer error */
 	if (y > 127 || x > 255) { printf("stream_char is limited to y <= 127, x <= 255, you are using y %d, x %d\n", y, x); return -1; }
@@ -513,14 +627,29 @@ int stream_char(player_type *p_ptr, int st, int y, int x)
 
 	/* Header + Body (with or without transperancy) */
 	l = ((y << 8) & 0x7F00) | (x & 0x00FF) | 0x8000;
-	if (stream->flag & SF_TRANSPARENT)
-		n = cq_printf(&ct->wbuf, "%c%ud%c%c%c%c", stream->pkt, l, source[x].a, source[x].c, p_ptr->trn_info[y][x].a, p_ptr->trn_info[y][x].c);
-	else
-		n = cq_printf(&ct->wbuf, "%c%ud%c%c", stream->pkt, l, source[x].a, source[x].c);
-	if (n <= 0)
+	trn = (stream->flag & SF_TRANSPARENT) ? TRUE : FALSE;
+	packet_out(ct, stream->pkt);
+	if (!(w = cq_reserve(&ct->wbuf, trn ? 7 : 5)))
 	{
 		client_withdraw(ct);
 	}
+	PACK_PTR_8(w, stream->pkt);
+	PACK_PTR_16(w, l);
+	PACK_PTR_8(w, source[x].a);
+	PACK_PTR_8(w, source[x].c);
+	if (trn)
+	{
+		PACK_PTR_8(w, p_ptr->trn_info[y][x].a);
+		PACK_PTR_8(w, p_ptr->trn_info[y][x].c);
+	}
+	cq_commit(&ct->wbuf, w);
+
+	/* Client memorizes it */
+	if (DELTA_STREAM(st) && y < MAX_HGT && x < MAX_WID)
+	{
+		p_ptr->sent_info[y][x] = source[x];
+		if (trn) p_ptr->sent_trn[y][x] = p_ptr->trn_info[y][x];
+	}
 
 	/* Ok */
 	return 1;
@@ -555,6 +684,7 @@ int stream_line_as(player_type *p_ptr, int st, int y, int as_y)
 	start_pos = ct->wbuf.len;
 
 	/* Packet header */
+	packet_out(ct, stream->pkt);
 	if (cq_printf(&ct->wbuf, "%c%ud", stream->pkt, as_y) <= 0)
 	{
 		ct->wbuf.len = start_pos; /* rewind */
@@ -573,6 +703,33 @@ int stream_line_as(player_type *p_ptr, int st, int y, int as_y)
 		client_withdraw(ct);
 	}
 
+	/* Row-delta */
+	if (DELTA_STREAM(st) && (p_ptr->client_caps & CAPS_DELTA_ROWS) && as_y < MAX_HGT)
+	{
+		/* Also encode it as a difference against client's copy,
+		 * and keep whichever version is shorter */
+		if (p_ptr->sent_ok[as_y])
+		{
+			int full_pos = ct->wbuf.len;
+			int full_len = full_pos - start_pos;
+
+			if (cq_printf(&ct->wbuf, "%c%ud", stream->pkt, as_y | STREAM_DELTA_ROW) > 0
+			 && (!trn || cq_printd(&ct->wbuf, p_ptr->trn_info[y], p_ptr->sent_trn[as_y], cols) > 0)
+			 && cq_printd(&ct->wbuf, source, p_ptr->sent_info[as_y], cols) > 0
+			 && ct->wbuf.len - full_pos < full_len)
+			{
+				memmove(&ct->wbuf.buf[start_pos], &ct->wbuf.buf[full_pos], ct->wbuf.len - full_pos);
+				ct->wbuf.len -= full_len;
+			}
+			else ct->wbuf.len = full_pos; /* rewind */
+		}
+
+		/* Remember what client has now */
+		C_COPY(p_ptr->sent_info[as_y], source, cols, cave_view_type);
+		if (trn) C_COPY(p_ptr->sent_trn[as_y], p_ptr->trn_info[y], cols, cave_view_type);
+		p_ptr->sent_ok[as_y] = TRUE;
+	}
+
 	/* Ok */
 	return 1;
 }
@@ -595,6 +752,8 @@ int send_term_info(player_type *p_ptr, byte flag, u16b line)
 		p_ptr->remote_term = (byte)line;
 	}
 
+	packet_out(ct, PKT_TERM);
+
 	/* Send (with additional parameter?) */
 	if (flag & 0xF0)
 		n = cq_printf(&ct->wbuf, "%c%b%ud", PKT_TERM, flag, line);
@@ -616,6 +775,7 @@ int send_term_header(player_type *p_ptr, byte hint, cptr header)
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
 
+	packet_out(ct, PKT_TERM_INIT);
 	if (!cq_printf(&ct->wbuf, "%c%b%s", PKT_TERM_INIT, hint, header))
 	{
 		client_withdraw(ct);
@@ -626,6 +786,7 @@ int send_term_header(player_type *p_ptr, byte hint, cptr header)
 int send_term_writefile(connection_type *ct, byte fmode, cptr filename)
 {
 	if (ct == NULL) return -1;
+	packet_out(ct, PKT_TERM_WRITE);
 	if (!cq_printf(&ct->wbuf, "%c" "%b%s", PKT_TERM_WRITE, fmode, filename))
 	{
 		client_withdraw(ct);
@@ -648,10 +809,14 @@ int send_cursor(player_type *p_ptr, byte vis, byte x, byte y)
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
 
+	packet_out(ct, PKT_CURSOR);
 	if (!cq_printf(&ct->wbuf, "%c" "%c%c%c", PKT_CURSOR, vis, x, y))
 	{
 		client_withdraw(ct);
 	}
+
+	/* Don't let cursor lag behind */
+	push_connection(ct);
 	return 1;
 }
 
@@ -660,6 +825,7 @@ int send_target_info(player_type *p_ptr, byte x, byte y, byte win, cptr str)
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_TARGET_INFO);
 	if (!cq_printf(&ct->wbuf, "%c" "%c%c%c%s", PKT_TARGET_INFO, x, y, win, str))
 	{
 		client_withdraw(ct);
@@ -690,6 +856,7 @@ int send_custom_command_info(connection_type *ct, int id)
 		}
 	}
 
+	packet_out(ct, PKT_COMMAND);
 	if (cq_printf(&ct->wbuf, "%c%c%c%d%ul%c%S%s", PKT_COMMAND,
 		command_pkt[id], cc_ptr->scheme, cc_ptr->m_catch, cc_ptr->flag, cc_ptr->tval, cc_ptr->prompt, cc_ptr->display) <= 0)
 	{
@@ -710,6 +877,7 @@ int send_item_tester_info(connection_type *ct, int id)
 
 	if (!it_ptr->tval[0] && !it_ptr->flag) return 1; /* Last one */
 
+	packet_out(ct, PKT_ITEM_TESTER);
 	if (cq_printf(&ct->wbuf, "%c%c%c", PKT_ITEM_TESTER,
 		(byte)id, item_tester[id].flag) <= 0)
 	{
@@ -735,6 +903,7 @@ int send_slash_fx(player_type *p_ptr, byte y, byte x, byte dir, byte fx)
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
 	if (!p_ptr->supports_slash_fx) return 1;
+	packet_out(ct, PKT_SLASH_FX);
 	if (cq_printf(&ct->wbuf, "%c" "%c%c" "%c%b", PKT_SLASH_FX, y, x, dir, fx) <= 0)
 	{
 		/* No space in buffer, but we don't really care for this packet */
@@ -748,6 +917,7 @@ int send_air_char(player_type *p_ptr, byte y, byte x, char a, char c, u16b delay
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_AIR);
 	if (cq_printf(&ct->wbuf, "%c" "%c%c" "%c%c" "%ud%ud", PKT_AIR, y, x, a, c, delay, fade) <= 0)
 	{
 		/* No space in buffer, but we don't really care for this packet */
@@ -761,6 +931,7 @@ int send_floor_DEPRECATED(player_type *p_ptr, byte attr, int amt, byte tval, byt
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_FLOOR);
 	if (cq_printf(&ct->wbuf, "%c" "%c%c%d%c%b%b%s", PKT_FLOOR, 0, attr, amt, tval, flag, s_tester, name) <= 0)
 	{
 		client_withdraw(ct);
@@ -778,6 +949,7 @@ int send_floor(player_type *p_ptr, byte ga, char gc, byte attr, int amt, byte tv
 	}
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_FLOOR);
 	if (cq_printf(&ct->wbuf, "%b" "%c%c%c%c" "%d%c%b%b%s%s", PKT_FLOOR,
 		0, ga, gc, attr,
 		amt, tval, flag, s_tester, name, name_one) <= 0)
@@ -792,6 +964,7 @@ int send_inven_DEPRECATED(player_type *p_ptr, char pos, byte attr, int wgt, int
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_INVEN);
 	if (cq_printf(&ct->wbuf, "%c" "%c%c%ud%d%c%b%b%s", PKT_INVEN, pos, attr, wgt, amt, tval, flag, s_tester, name) <= 0)
 	{
 		client_withdraw(ct);
@@ -809,6 +982,7 @@ int send_inven(player_type *p_ptr, char pos, byte ga, char gc, byte attr, int wg
 	}
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_INVEN);
 	if (cq_printf(&ct->wbuf, "%b" "%c%c%c%c" "%ud%d%c%b%b%s%s", PKT_INVEN,
 		pos, ga, gc, attr,
 		wgt, amt, tval, flag, s_tester, name, name_one) <= 0)
@@ -823,6 +997,7 @@ int send_equip(player_type *p_ptr, char pos, byte attr, int wgt, byte tval, byte
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_EQUIP);
 	if (cq_printf(&ct->wbuf, "%c" "%c%c%ud%c%b%s", PKT_EQUIP, pos, attr, wgt, tval, flag, name) <= 0)
 	{
 		client_withdraw(ct);
@@ -835,6 +1010,7 @@ int send_spell_info(player_type *p_ptr, u16b book, u16b i, byte flag, byte item_
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_SPELL_INFO);
 	if (!cq_printf(&ct->wbuf, "%c" "%b%b%ud%ud%s", PKT_SPELL_INFO, flag, item_tester, book, i, out_val))
 	{
 		client_withdraw(ct);
@@ -855,6 +1031,7 @@ int send_ghost(player_type *p_ptr)
 	if (p_ptr->ghost) mode = PALIVE_GHOST;
 	else if (p_ptr->fruit_bat) mode = PALIVE_FRUITBAT;
 
+	packet_out(ct, PKT_GHOST);
 	if (!cq_printf(&ct->wbuf, "%c%d", PKT_GHOST, mode))
 	{
 		client_withdraw(ct);
@@ -883,6 +1060,7 @@ int send_objflags(player_type *p_ptr, int line)
 	ct = Conn[p_ptr->conn];
 
 	/* Header */
+	packet_out(ct, PKT_OBJFLAGS);
 	if (cq_printf(&ct->wbuf, "%c%d", PKT_OBJFLAGS, line) <= 0)
 	{
 		client_withdraw(ct);
@@ -912,6 +1090,7 @@ int send_message_DEPRECATED(player_type *p_ptr, cptr msg, u16b typ)
 	strncpy(buf, msg, 78);
 	buf[78] = '\0';
 
+	packet_out(ct, PKT_MESSAGE);
 	if (!cq_printf(&ct->wbuf, "%c%ud%s", PKT_MESSAGE, typ, buf))
 	{
 		client_withdraw(ct);
@@ -923,7 +1102,8 @@ int send_message_DEPRECATED(player_type *p_ptr, cptr msg, u16b typ)
 int send_message(player_type *p_ptr, cptr msg, u16b typ)
 {
 	connection_type *ct;
-	char buf[MSG_LEN];
+	int len;
+	char *w;
 
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
@@ -938,12 +1118,20 @@ int send_message(player_type *p_ptr, cptr msg, u16b typ)
 	}
 
 	/* Clip end of msg if too long */
-	my_strcpy(buf, msg, MSG_LEN);
+	len = strlen(msg);
+	if (len > MSG_LEN - 1) len = MSG_LEN - 1;
 
-	if (!cq_printf(&ct->wbuf, "%c%ud%S", PKT_MESSAGE, typ, buf))
+	/* Same as "%c%ud%S" */
+	packet_out(ct, PKT_MESSAGE);
+	if (!(w = cq_reserve(&ct->wbuf, 1 + 2 + len + 1)))
 	{
 		client_withdraw(ct);
 	}
+	PACK_PTR_8(w, PKT_MESSAGE);
+	PACK_PTR_16(w, typ);
+	PACK_PTR_NSTR(w, msg, len);
+	PACK_PTR_8(w, '\0');
+	cq_commit(&ct->wbuf, w);
 	return 1;
 }
 
@@ -954,6 +1142,7 @@ int send_message_repeat(player_type *p_ptr, u16b typ)
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
 
+	packet_out(ct, PKT_MESSAGE_REPEAT);
 	if (!cq_printf(&ct->wbuf, "%c%ud", PKT_MESSAGE_REPEAT, typ))
 	{
 		client_withdraw(ct);
@@ -966,6 +1155,7 @@ int send_sound(player_type *p_ptr, u16b sound)
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_SOUND);
 	if (!cq_printf(&ct->wbuf, "%c%ud", PKT_SOUND, sound))
 	{
 		client_withdraw(ct);
@@ -978,6 +1168,7 @@ int send_channel(player_type *p_ptr, char mode, u16b id, cptr name)
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_CHANNEL);
 	if (!cq_printf(&ct->wbuf, "%c%ud%c%s", PKT_CHANNEL, id, mode, name))
 	{
 		client_withdraw(ct);
@@ -1090,14 +1281,25 @@ int recv_command(connection_type *ct, player_type *p_ptr)
 			byte cmd = ct->rbuf.buf[ct->rbuf.pos-1];
 			/* "cmd" is the 'id' we just copied above */
 			next_scheme = custom_command_schemes[custom_commands[cmd].scheme];
+			next_scheme_size = custom_scheme_sizes[custom_commands[cmd].scheme];
 		}
 	}
 
 	/* Copy command to player's "command buffer" */
-	if (!fail && next_scheme && cq_copyf(&ct->rbuf, next_scheme, &p_ptr->cbuf) < 0)
+	if (!fail && next_scheme)
 	{
-		/* Unable to... */
-		fail = 1;
+		/* Fixed-size scheme, copy it in one go */
+		if (next_scheme_size >= 0)
+		{
+			if (cq_copyn(&ct->rbuf, next_scheme_size, &p_ptr->cbuf) < 0)
+				fail = 1;
+		}
+		/* Variable-size, parse it */
+		else if (cq_copyf(&ct->rbuf, next_scheme, &p_ptr->cbuf) < 0)
+		{
+			/* Unable to... */
+			fail = 1;
+		}
 	}
 
 	if (fail)
@@ -1127,8 +1329,12 @@ int recv_keepalive(connection_type *ct, player_type *p_ptr)
 		return 0;
 	}
 
+	packet_out(ct, PKT_KEEPALIVE);
 	cq_printf(&ct->wbuf, "%c%l", PKT_KEEPALIVE, ctime);
 
+	/* Reply right away, client measures latency with this */
+	push_connection(ct);
+
 	/* Ok */
 	return 1;
 }
@@ -1477,6 +1683,7 @@ int recv_settings(connection_type *ct, player_type *p_ptr) {
 			case 0: p_ptr->use_graphics  = val; break;
 			case 3: p_ptr->hitpoint_warn = (byte_hack)val; break;
 			case 5: p_ptr->supports_slash_fx = (bool)val; break;
+			case 14: p_ptr->client_caps = (u16b)val; break;
 			default: break;
 		}
 		/* Hack -- light offsets for graphics mode */
@@ -1516,6 +1723,18 @@ int recv_settings(connection_type *ct, player_type *p_ptr) {
 		}
 	}
 
+	/* Client can inflate, start compressing (once) */
+	if (cfg_compress_output && (p_ptr->client_caps & CAPS_DEFLATE) && !ct->zout && !ct->send_cb)
+	{
+		packet_out(ct, PKT_DEFLATE);
+		cq_printf(&ct->wbuf, "%c", PKT_DEFLATE);
+		if (compress_connection(ct, cfg_compress_output) < 0)
+		{
+			plog(format("Unable to compress output for %s", p_ptr->name));
+			return -1;
+		}
+	}
+
 	/* Ok */
 	return 1;
 }
@@ -1583,6 +1802,12 @@ int recv_stream_size(connection_type *ct, player_type *p_ptr) {
 		}
 	}
 
+	/* Client re-allocates it's buffer, forget what it had */
+	if (stg <= STREAM_DUNGEON_GRAF2)
+	{
+		C_WIPE(p_ptr->sent_ok, MAX_HGT, bool);
+	}
+
 	/* Ack it */
 	send_stream_size(ct, stg, y, x);
 
@@ -2256,6 +2481,7 @@ int send_store_DEPRECATED(player_type *p_ptr, char pos, byte attr, s16b wgt, s16
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_STORE);
 	if (cq_printf(&ct->wbuf, "%b" "%c%c%d%d%ul%s", PKT_STORE, pos, attr, wgt, number, price, name) <= 0)
 	{
 		client_withdraw(ct);
@@ -2273,6 +2499,7 @@ int send_store(player_type *p_ptr, char pos, byte ga, char gc, byte attr, s16b w
 	}
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_STORE);
 	if (cq_printf(&ct->wbuf, "%b" "%b%c%c%c%d%d%ul%s", PKT_STORE, pos, ga, gc, attr, wgt, number, price, name) <= 0)
 	{
 		client_withdraw(ct);
@@ -2285,6 +2512,7 @@ int send_store_info(player_type *p_ptr, byte flag, cptr name, char *owner, int i
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_STORE_INFO);
 	if (cq_printf(&ct->wbuf, "%c%c%s%s%d%l", PKT_STORE_INFO, flag, name, owner, items, purse) <= 0)
 	{
 		client_withdraw(ct);
@@ -2297,6 +2525,7 @@ int send_confirm_request(player_type *p_ptr, byte type, cptr buf)
 	connection_type *ct;
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
+	packet_out(ct, PKT_CONFIRM);
 	if (!cq_printf(&ct->wbuf, "%c" "%c%c%s", PKT_CONFIRM, type, 0x00, buf))
 	{
 		client_withdraw(ct);
@@ -2322,6 +2551,7 @@ int send_store_leave(player_type *p_ptr)
 	if (p_ptr->conn == -1) return -1;
 	ct = Conn[p_ptr->conn];
 
+	packet_out(ct, PKT_STORE_LEAVE);
 	if (!cq_printf(&ct->wbuf, "%c", PKT_STORE_LEAVE))
 	{
 		client_withdraw(ct);
@@ -2341,6 +2571,7 @@ int send_party_info(player_type *p_ptr)
 		name = parties[p_ptr->party].name;
 		owner = parties[p_ptr->party].owner;
 	}
+	packet_out(ct, PKT_PARTY);
 	if (!cq_printf(&ct->wbuf, "%c" "%s%s", PKT_PARTY, name, owner))
 	{
 		client_withdraw(ct);
@@ -2414,6 +2645,7 @@ int process_player_commands(player_type *p_ptr)
 	byte pkt;
 	int result = 1;
 	int start_pos = 0;
+	s64b start_time;
 
 	/* parse */
 	while ( cq_len(&p_ptr->cbuf) )
@@ -2425,7 +2657,11 @@ int process_player_commands(player_type *p_ptr)
 		/* pre-execute hacks */
 		do_cmd__before(p_ptr, pkt);
 		/* execute command */
+		start_time = monotonic_timer();
 		result = (*pcommands[pkt])(p_ptr);
+		/* account executed commands */
+		if (result != 0) count_packet(p_ptr->pkt_cmd, server_pkt_cmd, pkt,
+			p_ptr->cbuf.pos - start_pos, monotonic_timer() - start_time);
 		/* post-execute hacks */
 		if (result) do_cmd__after(p_ptr, pkt, result);
 		/* not a "continuing success" */
@@ -2469,6 +2705,12 @@ void setup_tables(sccb receiv[256], cptr *scheme)
 #undef PACKET
 #undef PCOMMAND
 
+	/* Compile custom command schemes */
+	for (i = 0; i <= SCHEME_LAST; i++)
+	{
+		custom_scheme_sizes[i] = cq_scheme_size(custom_command_schemes[i]);
+	}
+
 	/* Setup custom commands */
 	for (i = 0; i < MAX_CUSTOM_COMMANDS; i++)
 	{
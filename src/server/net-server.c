@@ -18,6 +18,9 @@
 #define ONE_SECOND	1000000 /* 1 million "microseconds" */
 
 int ticks = 0;
+int last_ticks = 0; /* Number of dungeon ticks during last second */
+timer_type *tick_timer = NULL; /* Timer driving the dungeon ticks */
+static bool tick_output = FALSE; /* Dungeon ticked, time to flush output */
 
 /* List heads */
 eptr first_connection = NULL;
@@ -31,6 +34,11 @@ int *Get_Ind; 	/* Pass "ind", get "Ind" */
 connection_type **Conn; /* Pass "ind", get "connection_type" */
 connection_type **PConn; /* Pass "Ind", get "connection_type" */
 
+/* Traffic accounting, server-wide (per-player ones are in "player_type") */
+packet_stat server_pkt_in[256];
+packet_stat server_pkt_cmd[256];
+packet_stat server_pkt_out[256];
+
 /* Callbacks */
 #define def_cb(A) int A(int data1, data data2)
 def_cb(report_to_meta);
@@ -48,11 +56,13 @@ def_cb(websocket_close);
 
 static int		(*handlers[256])(connection_type *ct, player_type *p_ptr);
 static cptr		schemes[256];
+static int		scheme_sizes[256]; /* Compiled "schemes", see "cq_scheme_size" */
 
 bool client_names_ok(char *nick_name, char *real_name, char *host_name);
 
 /* Scheme to use for parsing next packet */ 
 cptr next_scheme = NULL;
+int next_scheme_size = 0;
 byte next_pkt = 0;
 
 server_setup_t serv_info = 
@@ -128,17 +138,18 @@ void reindex_player(int oldPInd, int newPInd)
 			if (newPInd == 0) p_ptr->redraw |= PR_HEALTH;
 		}
 
-		/* Visibility flags */
-		p_ptr->play_vis[newPInd] = p_ptr->play_vis[oldPInd];
-		p_ptr->play_los[newPInd] = p_ptr->play_los[oldPInd];
+		/* Visibility flags (index 0 is not counted in "play_los_num") */
+		if (vis_has(p_ptr->play_los, newPInd ? newPInd : oldPInd)) p_ptr->play_los_num--;
+		vis_set(p_ptr->play_vis, newPInd, vis_has(p_ptr->play_vis, oldPInd));
+		vis_set(p_ptr->play_los, newPInd, vis_has(p_ptr->play_los, oldPInd));
 		p_ptr->play_det[newPInd] = p_ptr->play_det[oldPInd];
 
 		/* Vanishing player was visible, update list */
-		if (newPInd == 0 && p_ptr->play_vis[oldPInd]) p_ptr->window |= (PW_MONLIST);
+		if (newPInd == 0 && vis_has(p_ptr->play_vis, oldPInd)) p_ptr->window |= (PW_MONLIST);
 
 		/* And forget about old index */
-		p_ptr->play_vis[oldPInd] = FALSE;
-		p_ptr->play_los[oldPInd] = FALSE;
+		vis_off(p_ptr->play_vis, oldPInd);
+		vis_off(p_ptr->play_los, oldPInd);
 		p_ptr->play_det[oldPInd] = 0;
 	}
 }
@@ -423,15 +434,18 @@ void player_drop(int ind)
 /* Init */
 void setup_network_server()
 {
+	int i;
+
+	/** Prepare FD_SETS **/
+	network_reset();
+
 	/** Add timers **/
 	/* Dungeon Turn */
 	first_timer = add_timer(NULL, (ONE_SECOND / cfg_fps), (callback)dungeon_tick);
+	tick_timer = (timer_type*)first_timer->data2;
 	/* Every Second */
 	add_timer(first_timer, (ONE_SECOND), (callback)second_tick);
 
-	/** Prepare FD_SETS **/
-	network_reset();
-
 	/** Add UDP */
 	/* Meta-server */
 	first_sender = add_sender(NULL, cfg_meta_address, 8800, ONE_SECOND * 4, report_to_meta);
@@ -450,11 +464,24 @@ void setup_network_server()
 		quit("Unable to create console interface");
 	}
 
+	/** Network thread **/
+	if (cfg_network_thread && network_thread_start() < 0)
+	{
+		plog("Unable to start network thread, running without it");
+		cfg_network_thread = FALSE;
+	}
+
 	/** Allocate some memory */
 	alloc_server_memory();	
 
 	/** Setup packet handling functions **/
 	setup_tables(handlers, schemes);
+
+	/* Compile schemes */
+	for (i = 0; i < 256; i++)
+	{
+		scheme_sizes[i] = cq_scheme_size(schemes[i]);
+	}
 }
 
 /* Player commands */
@@ -505,19 +532,34 @@ void network_loop()
 		first_listener = handle_listeners(first_listener);
 		first_connection = handle_connections(first_connection);
 		first_sender = handle_senders(first_sender, static_timer(1));
-		first_timer = handle_timers(first_timer, static_timer(0));
+		first_timer = handle_timers(first_timer);
 
 		post_process_players(); /* Execute all commands */
 
-		network_pause(2000); /* 0.002 ms "sleep" */
+		/* Tick boundary -- send everything this tick has produced */
+		if (tick_output)
+		{
+			flush_connections(first_connection);
+			tick_output = FALSE;
+		}
+
+		/* Sleep until next timer is due or until something arrives,
+		 * but don't sleep at all if there's output to flush */
+		if (connections_pending(first_connection))
+			network_pause(0);
+		else
+			network_pause(timers_delay(ONE_SECOND));
 	}
 }
 
 /* Close */
 void close_network_server()
 {
+	/* Stop network thread, it closes connections it handles */
+	network_thread_stop();
+
 	/* Remove timers, listeners and connections */
-	e_release_all(first_timer, 0, 1);
+	release_timers(first_timer);
 	e_release_all(first_listener, 0, 1);
 
 	/* TODO: Inform meta ...? */
@@ -657,7 +699,7 @@ int report_to_meta(int data1, data data2) {
 int second_tick(int data1, data data2) {
 	int i;
 
-	/* plog("A Second Passed"); */ ticks = 0;
+	/* plog("A Second Passed"); */ last_ticks = ticks; ticks = 0;
 
 	/* Update shutdown timer */
 	if (shutdown_timer) 
@@ -701,6 +743,7 @@ int dungeon_tick(int data1, data data2) {
 
 	/* Game Turn */
 	dungeon();
+	tick_output = TRUE;
 	return 2;
 }
 					/* data1 is (int)fd */
@@ -784,6 +827,25 @@ int hub_close(int data1, data data2) {
 }
 
 
+/* Account packet "pkt" in player's ("mine") and server-wide ("all") stats */
+void count_packet(packet_stat *mine, packet_stat *all, byte pkt, int bytes, s64b usec)
+{
+	mine[pkt].count++;
+	mine[pkt].bytes += bytes;
+	mine[pkt].usec += usec;
+	all[pkt].count++;
+	all[pkt].bytes += bytes;
+	all[pkt].usec += usec;
+}
+
+/* Forget player's traffic stats */
+void reset_packet_stats(player_type *p_ptr)
+{
+	C_WIPE(p_ptr->pkt_in, 256, packet_stat);
+	C_WIPE(p_ptr->pkt_cmd, 256, packet_stat);
+	C_WIPE(p_ptr->pkt_out, 256, packet_stat);
+}
+
 int client_read(int data1, data data2) { /* return -1 on error */
 	connection_type *ct = (connection_type *)data2;
 	player_type *p_ptr = players->list[(int)ct->user]->data2;
@@ -791,6 +853,7 @@ int client_read(int data1, data data2) { /* return -1 on error */
 	byte pkt;
 	int result;
 	int start_pos;
+	s64b start_time;
 
 	/* Reset timeout timer */
 	p_ptr->idle = 0;
@@ -802,8 +865,17 @@ int client_read(int data1, data data2) { /* return -1 on error */
 		pkt = CQ_GET(&ct->rbuf);
 		next_pkt = pkt;
 		next_scheme = schemes[pkt];
+		next_scheme_size = scheme_sizes[pkt];
+		start_time = monotonic_timer();
 		result = (*handlers[pkt])(ct, p_ptr);
 
+		/* Account complete packets */
+		if (result != 0)
+		{
+			count_packet(p_ptr->pkt_in, server_pkt_in, pkt,
+				ct->rbuf.pos - start_pos, monotonic_timer() - start_time);
+		}
+
 		/* Do not continue */
 		if (result != 1) break;
 	}
@@ -976,6 +1048,15 @@ int client_login(int data1, data data2) { /* return -1 on error */
 	ct->user = p_ptr->conn;
 	Conn[p_ptr->conn] = ct;
 
+	/* New client, assume it knows nothing */
+	p_ptr->client_caps = 0;
+	C_WIPE(p_ptr->sent_ok, MAX_HGT, bool);
+
+	/* Start counting traffic anew */
+	reset_packet_stats(p_ptr);
+	p_ptr->pkt_out_last = PKT_UNDEFINED;
+	p_ptr->pkt_out_mark = ct->wsent + cq_len(&ct->wbuf);
+
 	if (p_ptr->state == PLAYER_LEAVING)
 	{
 		/* Fix other lists */
@@ -991,6 +1072,12 @@ int client_login(int data1, data data2) { /* return -1 on error */
 	/* Advance to next stage */
 	ct->receive_cb = client_read;
 
+	/* From now on, coalesce output to one write per tick */
+	ct->cork = cfg_cork_output;
+
+	/* Let the network thread do the actual reading and writing */
+	if (cfg_network_thread) thread_connection(ct);
+
 	/* Since LOGIN is the first command ever, it's a good time to send basics */
 	if (client_version_atleast(p_ptr->version, 1,5,3)) send_stats_info(ct);
 	send_race_info(ct);
@@ -1215,15 +1302,14 @@ u16b connection_type_ok(u16b conntype)
  * WebSocket (RFC6455) Interface.
  */
 
-/* Add websocket frame header and then send bytes as-is. */
+/* Prepare websocket frame header for the next "data1" bytes of output.
+ * The bytes themselves are then sent as-is. */
 int websocket_send(int data1, data data2)
 {
 	static bool initialized = FALSE;
 	static cq tmp_buf;
-	int i, n, header_len;
 	connection_type *ct = data2;
-	char* mesg = (char*) ct->uptr;
-	int len;
+	int len = data1;
 
 	/* Prepare frame header */
 	bool FIN = TRUE;
@@ -1236,7 +1322,6 @@ int websocket_send(int data1, data data2)
 		| (RSV3 ? 1 << 4 : 0)
 		| (OPCODE & 0x0F);
 
-	len = cq_len(&ct->wbuf);
 	if (!len) return 0;
 
 	if (!initialized)
@@ -1250,19 +1335,16 @@ int websocket_send(int data1, data data2)
 	cq_printf(&tmp_buf, "%uv", len);
 
 	/* Dump header */
-	header_len = cq_len(&tmp_buf);
-	n = cq_read(&tmp_buf, &mesg[0], PD_LARGE_BUFFER);
-	if (n < header_len)
+	ct->whead_len = cq_len(&tmp_buf);
+	if (ct->whead_len > (int)sizeof(ct->whead))
 	{
 		return -1;
 	}
-	/* Dump body */
-	n = cq_read(&ct->wbuf, &mesg[n], PD_LARGE_BUFFER);
-	if (n < len)
-	{
-		return -1;
-	}
-	return n + header_len;
+	memcpy(ct->whead, CQ_PEEK(&tmp_buf), ct->whead_len);
+	ct->whead_pos = 0;
+
+	/* Frame covers all of it */
+	return len;
 }
 
 
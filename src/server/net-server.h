@@ -20,7 +20,11 @@ typedef int (*sccb)	(connection_type *ct, player_type *p_ptr); /* "Static Comman
 extern server_setup_t serv_info;
 extern eptr first_connection;
 
+extern int last_ticks;
+extern timer_type *tick_timer;
+
 extern cptr next_scheme;
+extern int next_scheme_size;
 extern byte next_pkt;
 
 extern int *Get_Conn;	/* Pass "Ind", get "ind" */
@@ -28,6 +32,12 @@ extern int *Get_Ind; 	/* Pass "ind", get "Ind" */
 extern connection_type **Conn; /* Pass "ind", get "connection_type" */
 extern connection_type **PConn; /* Pass "Ind", get "connection_type" */
 
+extern packet_stat server_pkt_in[256];
+extern packet_stat server_pkt_cmd[256];
+extern packet_stat server_pkt_out[256];
+extern void count_packet(packet_stat *mine, packet_stat *all, byte pkt, int bytes, s64b usec);
+extern void reset_packet_stats(player_type *p_ptr);
+
 #define client_abort(CT, REASON) send_quit(CT, REASON); return -1
 extern int client_kill(connection_type *ct, cptr reason);
 #ifdef DEBUG
@@ -110,8 +110,8 @@ static void excise_object_idx(int o_idx)
 		/* No one can see it anymore */
 		for (i = 1; i <= NumPlayers; i++)
 		{
-			if (Players[i]->obj_vis[o_idx]) Players[i]->window |= (PW_ITEMLIST);
-			Players[i]->obj_vis[o_idx] = FALSE;
+			if (vis_has(Players[i]->obj_vis, o_idx)) Players[i]->window |= (PW_ITEMLIST);
+			vis_off(Players[i]->obj_vis, o_idx);
 		}
 	}
 }
@@ -230,6 +230,62 @@ void delete_object(int Depth, int y, int x)
 } 
 
 
+/*
+ * Position of each "live" object in the "o_fast" array
+ */
+static s16b o_fast_pos[MAX_O_IDX];
+
+/*
+ * Depth of the list each object is on (its "dun_depth" is lost
+ * as soon as it is wiped)
+ */
+static s16b o_depth_of[MAX_O_IDX];
+
+
+/*
+ * Add an object to the "live" array, and to the list of its depth
+ */
+static void o_link(int i, int Depth)
+{
+	int head = o_depth_first[Depth];
+
+	/* Live */
+	o_fast_pos[i] = o_top;
+	o_fast[o_top++] = i;
+
+	/* On the depth */
+	o_depth_of[i] = Depth;
+	o_depth_prev[i] = 0;
+	o_depth_next[i] = head;
+	if (head) o_depth_prev[head] = i;
+	o_depth_first[Depth] = i;
+}
+
+
+/*
+ * Give the slot of a dead object back, for "o_pop()" to reuse
+ */
+static void o_release(int i)
+{
+	int prev = o_depth_prev[i], next = o_depth_next[i];
+	int last;
+
+	/* Excise it from the "live" array */
+	last = o_fast[--o_top];
+	o_fast[o_fast_pos[i]] = last;
+	o_fast_pos[last] = o_fast_pos[i];
+
+	/* Remove it from its depth */
+	if (prev) o_depth_next[prev] = next;
+	else o_depth_first[o_depth_of[i]] = next;
+	if (next) o_depth_prev[next] = prev;
+	o_depth_prev[i] = o_depth_next[i] = 0;
+
+	/* Ready for reuse */
+	o_free[o_free_num++] = i;
+}
+
+
 /* 
  * Move an object from index i1 to index i2 in the object list 
  */ 
@@ -297,7 +353,7 @@ static void compact_objects_aux(int i1, int i2)
 
 	/* Copy the visibility flags for each player */
 	for (Ind = 1; Ind <= NumPlayers; Ind++)
-		Players[Ind]->obj_vis[i2] = Players[Ind]->obj_vis[i1];
+		vis_set(Players[Ind]->obj_vis, i2, vis_has(Players[Ind]->obj_vis, i1));
 
 	/* Hack -- move object */
 	COPY(&o_list[i2], &o_list[i1], object_type);
@@ -344,17 +400,19 @@ void compact_objects(int size)
 			o_max--;
 		}
 
-		/* Reset "o_nxt" */
-		o_nxt = o_max;
+		/* No more dead objects */
+		o_free_num = 0;
 
 		/* Reset "o_top" */
 		o_top = 0;
 
-		/* Collect "live" objects */
-		for (i = 1; i < o_max; i++)
+		/* Forget the old depth lists */
+		C_WIPE(&o_depth_first[-MAX_WILD], MAX_DEPTH + MAX_WILD, s16b);
+
+		/* Collect "live" objects (backwards, so each list is in order) */
+		for (i = o_max - 1; i >= 1; i--)
 		{
-			/* Collect indexes */
-			o_fast[o_top++] = i;
+			o_link(i, o_list[i].dun_depth);
 		}
 
 		return;
@@ -454,6 +512,30 @@ void compact_objects(int size)
 
 
 
+/*
+ * Move any dead objects from the "o_fast" array to the "o_free" array.
+ *
+ * Objects are deleted in many ways, all of which simply wipe them,
+ * so the "live" array is only cleaned up here and in "process_objects()".
+ */
+static void excise_dead_objects(void)
+{
+	int i, k;
+
+	for (k = o_top - 1; k >= 0; k--)
+	{
+		/* Access index */
+		i = o_fast[k];
+
+		/* Skip live objects */
+		if (o_list[i].k_idx) continue;
+
+		/* Excise it */
+		o_release(i);
+	}
+}
+
+
 /*
  * Delete all the items when player leaves the level
  *
@@ -466,16 +548,16 @@ void wipe_o_list(int Depth)
 	int i;//, house_depth;
 
 	/* Delete the existing objects */
-	for (i = 1; i < o_max; i++)
+	while ((i = o_depth_first[Depth]))
 	{
 		object_type *o_ptr = &o_list[i];
 
-		/* Skip dead objects */
-		if (!o_ptr->k_idx) continue;
-
-		/* Skip objects not on this depth */
-		if (o_ptr->dun_depth != Depth)
+		/* Free dead objects */
+		if (!o_ptr->k_idx)
+		{
+			o_release(i);
 			continue;
+		}
 
 		/* Mega-Hack -- preserve artifacts */
 		/* Hack -- Preserve unknown artifacts */
@@ -514,10 +596,10 @@ void wipe_o_list(int Depth)
 
 		/* Wipe the object */
 		WIPE(o_ptr, object_type);
-	}
 
-	/* Compact the object list */
-	compact_objects(0);
+		/* Free it */
+		o_release(i);
+	}
 }
 
 
@@ -529,56 +611,45 @@ void wipe_o_list(int Depth)
  *
  * Note that this function must maintain the special "o_fast"
  * array of pointers to "live" objects.
+ *
+ * Dead objects are reused first, from the "o_free" array, so we never
+ * have to search the object array for a free slot.
  */
-s16b o_pop(void)
+s16b o_pop(int Depth)
 {
-	int i, n, k;
+	int i;
 
 
-	/* Initial allocation */
-	if (o_max < MAX_O_IDX)
+	/* Look for dead objects when the array is full */
+	if (!o_free_num && (o_max >= MAX_O_IDX)) excise_dead_objects();
+
+	/* Reuse a dead object */
+	while (o_free_num)
 	{
-		/* Get next space */
-		i = o_max;
+		i = o_free[--o_free_num];
 
-		/* Expand object array */
-		o_max++;
+		/* Paranoia -- skip objects in use */
+		if (o_list[i].k_idx) continue;
 
-		/* Update "o_fast" */
-		o_fast[o_top++] = i;
+		/* Update "o_fast" and the depth list */
+		o_link(i, Depth);
 
 		/* Use this object */
 		return (i);
 	}
 
 
-	/* Check for some space */
-	for (n = 1; n < MAX_O_IDX; n++)
+	/* Initial allocation */
+	if (o_max < MAX_O_IDX)
 	{
 		/* Get next space */
-		i = o_nxt;
-
-		/* Advance (and wrap) the "next" pointer */
-		if (++o_nxt >= MAX_O_IDX) o_nxt = 1;
-
-		/* Skip objects in use */
-		if (o_list[i].k_idx) continue;
-
-		/* Verify space XXX XXX */
-		if (o_top >= MAX_O_IDX) continue;
-
-		/* Verify not allocated */
-		for (k = 0; k < o_top; k++)
-		{
-			/* Hack -- Prevent errors */
-			if (o_fast[k] == i) i = 0;
-		}
+		i = o_max;
 
-		/* Oops XXX XXX */
-		if (!i) continue;
+		/* Expand object array */
+		o_max++;
 
-		/* Update "o_fast" */
-		o_fast[o_top++] = i;
+		/* Update "o_fast" and the depth list */
+		o_link(i, Depth);
 
 		/* Use this object */
 		return (i);
@@ -3551,7 +3622,7 @@ bool place_specific_object(int Depth, int y1, int x1, object_type *forge, int le
 			/* Place a great object */
 			
 			/* Make an object */
-			o_idx = o_pop();
+			o_idx = o_pop(Depth);
 		
 			/* Success */
 			if (o_idx)
@@ -3577,7 +3648,7 @@ bool place_specific_object(int Depth, int y1, int x1, object_type *forge, int le
 				for (i = 1; i <= NumPlayers; i++)
 				{
 					/* He can't see it */
-					Players[i]->obj_vis[o_idx] = FALSE;
+					vis_off(Players[i]->obj_vis, o_idx);
 				}
 			
 				
@@ -3696,7 +3767,7 @@ object_type* place_object(int Depth, int y, int x, bool good, bool great, byte o
 
 
 	/* Make an object */
-	o_idx = o_pop();
+	o_idx = o_pop(Depth);
 
 	/* Success */
 	if (o_idx)
@@ -3731,7 +3802,7 @@ object_type* place_object(int Depth, int y, int x, bool good, bool great, byte o
 		for (i = 1; i <= NumPlayers; i++)
 		{
 			/* He can't see it */
-			Players[i]->obj_vis[o_idx] = FALSE;
+			vis_off(Players[i]->obj_vis, o_idx);
 		}
 
 		/* Add origin */
@@ -3891,7 +3962,7 @@ void place_gold(int Depth, int y, int x)
 
 
 	/* Make an object */
-	o_idx = o_pop();
+	o_idx = o_pop(Depth);
 
 	/* Success */
 	if (o_idx)
@@ -3917,7 +3988,7 @@ void place_gold(int Depth, int y, int x)
 		for (j = 1; j <= NumPlayers; j++)
 		{
 			/* This player can't see it */
-			Players[j]->obj_vis[o_idx] = FALSE;
+			vis_off(Players[j]->obj_vis, o_idx);
 		}
 	}
 
@@ -4076,7 +4147,7 @@ void drop_near(object_type *o_ptr, int chance, int Depth, int y, int x)
 			delete_object(Depth, ny, nx);
 	
 			/* Make a new object */
-			o_idx = o_pop();
+			o_idx = o_pop(Depth);
 	
 			/* Success */
 			if (o_idx)
@@ -4119,7 +4190,7 @@ void drop_near(object_type *o_ptr, int chance, int Depth, int y, int x)
 			for (k = 1; k <= NumPlayers; k++)
 			{
 				/* This player cannot see it */
-				Players[k]->obj_vis[o_idx] = FALSE;
+				vis_off(Players[k]->obj_vis, o_idx);
 			}
 
 			/* Note the spot */
@@ -4432,7 +4503,7 @@ void floor_item_notify(player_type *p_ptr, s16b o_idx, bool force)
 	if (o_idx) for (i = 1; i <= NumPlayers; i++)
 	{
 		if (Players[i]->dun_depth != p_ptr->dun_depth) continue;
-		if (Players[i]->obj_vis[o_idx]) Players[i]->window |= (PW_ITEMLIST);
+		if (vis_has(Players[i]->obj_vis, o_idx)) Players[i]->window |= (PW_ITEMLIST);
 	}
 
 	if (!force && p_ptr->delta_floor_item == o_idx) return;
@@ -4941,7 +5012,7 @@ static void notify_player_standing_on(int o_idx)
 	for (Ind = 1; Ind <= NumPlayers; Ind++)
 	{
 		p_ptr = Players[Ind];
-		if (p_ptr->obj_vis[o_idx]) p_ptr->window |= (PW_ITEMLIST);
+		if (vis_has(p_ptr->obj_vis, o_idx)) p_ptr->window |= (PW_ITEMLIST);
 	}
 }
 
@@ -4972,7 +5043,7 @@ void process_objects(void)
 		if (!o_ptr->k_idx)
 		{
 			/* Excise it */
-			o_fast[k] = o_fast[--o_top];
+			o_release(i);
 
 			/* Skip */
 			continue;
@@ -5053,6 +5124,28 @@ void setup_objects(void)
 	}
 }
 
+/*
+ * Same as above, for the objects of a single level
+ */
+void setup_level_objects(int Depth)
+{
+	int i;
+
+	/* Paranoia -- level not allocated */
+	if (!cave[Depth]) return;
+
+	for (i = o_depth_first[Depth]; i; i = o_depth_next[i])
+	{
+		object_type *o_ptr = &o_list[i];
+
+		/* Skip dead objects */
+		if (!o_ptr->k_idx) continue;
+
+		/* Set the o_idx correctly */
+		cave[Depth][o_ptr->iy][o_ptr->ix].o_idx = i;
+	}
+}
+
 
 
 /* Takes a (partial) item_kind name and returns an index, or 0 if no match
@@ -5397,7 +5490,7 @@ int scan_floor(player_type *p_ptr, int *items, int max_size, int y, int x, int m
 			continue;
 #else
 		/* MAngband-specific: squelch/mode 0x02 alternative */
-		if ((mode & 0x02) && !(p_ptr->obj_vis[this_o_idx])) continue;
+		if ((mode & 0x02) && !(vis_has(p_ptr->obj_vis, this_o_idx))) continue;
 #endif
 
 		/* Accept this item */
@@ -5486,14 +5579,62 @@ int scan_floor_mimics(player_type *p_ptr, int y, int x, int *dst, object_type *o
 #define ODESC_FULL 2
 #define squelch_item_ok(O_PTR) FALSE
 
+/*
+ * Add an item to the sorted list of "display_itemlist()"
+ *
+ * Returns FALSE if the list is full.
+ */
+static bool itemlist_add(player_type *p_ptr, object_type *o_ptr, object_type **types, int *counts, unsigned *counter)
+{
+	unsigned j;
+
+	/* Skip gold/squelched */
+	if (o_ptr->tval == TV_GOLD || squelch_item_ok(o_ptr))
+		return (TRUE);
+
+	/* See if we've already seen a similar item; if so, just add */
+	/* to its count */
+	for (j = 0; j < *counter; j++)
+	{
+		if (object_similar(p_ptr, o_ptr, types[j]))
+		{
+			counts[j] += o_ptr->number;
+			return (TRUE);
+		}
+	}
+
+	/* We saw a new item. So insert it at the end of the list and */
+	/* then sort it forward using compare_items(). The types list */
+	/* is always kept sorted. */
+	types[j] = o_ptr;
+	counts[j] = o_ptr->number;
+
+	while (j > 0 && compare_items(p_ptr, types[j - 1], types[j]) > 0)
+	{
+		object_type *tmp_o = types[j - 1];
+		int tmpcount;
+
+		types[j - 1] = types[j];
+		types[j] = tmp_o;
+		tmpcount = counts[j - 1];
+		counts[j - 1] = counts[j];
+		counts[j] = tmpcount;
+		j--;
+	}
+	(*counter)++;
+
+	/* Problem: we're out of stack space */
+	return ((*counter) < MAX_ITEMLIST - 1);
+}
+
 /*
  * Display visible items, similar to display_monlist
+ *
+ * Only the objects on the player's level are examined.
  */
 void display_itemlist(player_type *p_ptr)
 {
 	int max;
-	int mx, my;
-	unsigned num;
 	int line = 1, x = 0;
 	int cur_x;
 	unsigned i;
@@ -5505,90 +5646,50 @@ void display_itemlist(player_type *p_ptr)
 	int counts[MAX_ITEMLIST];
 	unsigned counter = 0;
 
-	int dungeon_hgt = MAX_HGT; /*p_ptr->depth == 0 ? TOWN_HGT : DUNGEON_HGT;*/
-	int dungeon_wid = MAX_WID; /*p_ptr->depth == 0 ? TOWN_WID : DUNGEON_WID;*/
+	int Depth = p_ptr->dun_depth;
+	int k;
 
 	byte attr;
 	char buf[80];
 
-	int floor_list[MAX_FLOOR_STACK + 1]; /* +1 for mimics */
 	object_type fake_objects[8]; /* Allow up to 8 mimics */
 	int mimic_hack = 0;
 
 	/* Begin */
 	text_out_init(p_ptr);
 
-	/* Look at each square of the dungeon for items */
-	for (my = 0; my < dungeon_hgt; my++)
+	/* Look at each item on the level */
+	for (k = o_depth_first[Depth]; k; k = o_depth_next[k])
 	{
-		for (mx = 0; mx < dungeon_wid; mx++)
-		{
-			num = scan_floor(p_ptr, floor_list, MAX_FLOOR_STACK, my, mx, 0x02);
+		object_type *o_ptr = &o_list[k];
 
-			/* Hack -- also add mimics (can't trick the DM, though)*/
-			if (mimic_hack < 8 && !(p_ptr->dm_flags & DM_SEE_MONSTERS))
-			num += scan_floor_mimics(p_ptr, my, mx, &floor_list[num], fake_objects, &mimic_hack);
+		/* Skip dead and carried items */
+		if (!o_ptr->k_idx || o_ptr->held_m_idx) continue;
 
-			/* Iterate over all the items found on this square */
-			for (i = 0; i < num; i++)
-			{
-				object_type *o_ptr;
-				unsigned j;
+		/* Skip unseen items */
+		if (!vis_has(p_ptr->obj_vis, k)) continue;
 
-				if (floor_list[i] < 0)
-				{ printf("Use fake object: [%d]-> %d\n",floor_list[i], 0 - floor_list[i] - 1);
-					o_ptr = &fake_objects[0 - floor_list[i] - 1];
-				}
-				else
-					o_ptr = &o_list[floor_list[i]];
+		/* Add it, until we run out of space */
+		if (!itemlist_add(p_ptr, o_ptr, types, counts, &counter)) break;
+	}
 
-				/* Skip gold/squelched */
-				if (o_ptr->tval == TV_GOLD || squelch_item_ok(o_ptr))
-					continue;
+	/* Hack -- also add mimics (can't trick the DM, though)*/
+	if (!(p_ptr->dm_flags & DM_SEE_MONSTERS))
+	{
+		for (k = m_depth_first[Depth]; k && (mimic_hack < 8); k = m_depth_next[k])
+		{
+			monster_type *m_ptr = &m_list[k];
 
-				/* See if we've already seen a similar item; if so, just add */
-				/* to its count */
-				for (j = 0; j < counter; j++)
-				{
-					if (object_similar(p_ptr, o_ptr, types[j]))
-					{
-						counts[j] += o_ptr->number;
-						break;
-					}
-				}
+			/* Only mimics */
+			if (!m_ptr->mimic_k_idx) continue;
 
-				/* We saw a new item. So insert it at the end of the list and */
-				/* then sort it forward using compare_items(). The types list */
-				/* is always kept sorted. */
-				if (j == counter)
-				{
-					types[counter] = o_ptr;
-					counts[counter] = o_ptr->number;
+			/* Fake an object */
+			invwipe(&fake_objects[mimic_hack]);
+			invcopy(&fake_objects[mimic_hack], m_ptr->mimic_k_idx);
 
-					while (j > 0 && compare_items(p_ptr, types[j - 1], types[j]) > 0)
-					{
-						object_type *tmp_o = types[j - 1];
-						int tmpcount;
-
-						types[j - 1] = types[j];
-						types[j] = tmp_o;
-						tmpcount = counts[j - 1];
-						counts[j - 1] = counts[j];
-						counts[j] = tmpcount;
-						j--;
-					}
-					counter++;
-					/* Problem: we're out of stack space */
-					if (counter >= MAX_ITEMLIST - 1) break;
-				}
-				/* long breakout */
-				if (counter >= MAX_ITEMLIST - 1) break;
-			}
-			/* long breakout */
-			if (counter >= MAX_ITEMLIST - 1) break;
+			/* Add it, until we run out of space */
+			if (!itemlist_add(p_ptr, &fake_objects[mimic_hack++], types, counts, &counter)) break;
 		}
-		/* long breakout */
-		if (counter >= MAX_ITEMLIST - 1) break;
 	}
 
 	/* Note no visible items */
@@ -520,7 +520,7 @@ int party_mark_members(player_type *p_ptr, int m_idx)
 		q_ptr = Players[i];
 		q_ptr->in_hack = FALSE;
 		if (same_player(q_ptr, p_ptr) || ((p_ptr->party) &&
-			(!m_idx || q_ptr->mon_hrt[m_idx]) &&
+			(!m_idx || vis_has(q_ptr->mon_hrt, m_idx)) &&
 			(q_ptr->dun_depth == p_ptr->dun_depth) &&
 			(q_ptr->party == p_ptr->party) &&
 			((cfg_party_sharelevel == -1) || (abs(q_ptr->lev - p_ptr->lev) <= cfg_party_sharelevel))
@@ -542,10 +542,9 @@ void party_share_hurt(player_type *p_ptr, player_type  *q_ptr)
 		return;
 
 	/* Copy hurt */
-	for (i = 0; i < MAX_M_IDX; i++)
+	for (i = 0; i < VIS_SIZE(MAX_M_IDX); i++)
 	{
-		if (q_ptr->mon_hrt[i])
-			p_ptr->mon_hrt[i] = TRUE;
+		p_ptr->mon_hrt[i] |= q_ptr->mon_hrt[i];
 	}
 }
 
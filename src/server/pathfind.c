@@ -16,205 +16,246 @@
 
 
 /*** Constants ***/
-#define DUNGEON_WID MAX_WID
-#define DUNGEON_HGT MAX_HGT
 
+/* Size of the search window, centered on the starting grid */
+#define PF_SIZE MAX_PF_RADIUS
 
+/* Number of "open list" buckets (one per possible estimate) */
+#define PF_BUCKETS (MAX_PF_LENGTH + PF_SIZE)
+
+/* States of a window grid */
+#define PF_UNSEEN	0
+#define PF_OPEN 	1
+#define PF_CLOSED	2
 
-/*** Globals ***/
 
-static int terrain[MAX_PF_RADIUS][MAX_PF_RADIUS];
-/*char pf_result[MAX_PF_LENGTH];
-int pf_result_index;*/
+/*** Globals ***/
 
-static int ox, oy, ex, ey;
 static int dir_search[8] = {2,4,6,8,1,3,7,9};
 
 
-/*** Pathfinding code ***/
+/*
+ * Scratch space for a single search.
+ *
+ * This lives on the caller's stack, so searches are re-entrant and
+ * nothing has to be cleared between them except the window itself.
+ */
+typedef struct pf_scratch pf_scratch;
 
-static bool is_valid_pf(player_type *p_ptr, int y, int x)
+struct pf_scratch
 {
-	int Depth = p_ptr->dun_depth;
-	cave_type *c_ptr;
+	s16b cost[PF_SIZE * PF_SIZE];	/* Steps from the start */
+	byte state[PF_SIZE * PF_SIZE];	/* PF_UNSEEN, PF_OPEN or PF_CLOSED */
+	byte from[PF_SIZE * PF_SIZE];	/* Direction we entered the grid by */
 
-	/* Unvisited means allowed */
-	if (!(p_ptr->cave_flag[y][x] & (CAVE_MARK))) return (TRUE);
+	s16b next[PF_SIZE * PF_SIZE];	/* Bucket list links */
+	s16b prev[PF_SIZE * PF_SIZE];
 
-	/* Require open space */
-	if (!cave_floor_bold(Depth, y, x)) return (FALSE);
+	s16b bucket[PF_BUCKETS];	/* First grid of each bucket, or -1 */
+};
 
-	/* Hack -- don't step into traps */
-	c_ptr = &cave[Depth][y][x];
-	if ((p_ptr->cave_flag[y][x] & (CAVE_MARK)) /* Known location */
-	&& (c_ptr->feat >= FEAT_TRAP_HEAD) /* Visible trap */
-	&& (c_ptr->feat <= FEAT_TRAP_TAIL)) return (FALSE);
 
-	return (TRUE);
+/*** Pathfinding code ***/
+
+/*
+ * Open list -- add grid "g" to bucket "f"
+ */
+static void pf_push(pf_scratch *pf, int g, int f)
+{
+	pf->prev[g] = -1;
+	pf->next[g] = pf->bucket[f];
+	if (pf->bucket[f] >= 0) pf->prev[pf->bucket[f]] = g;
+	pf->bucket[f] = g;
 }
 
-static void fill_terrain_info(player_type *p_ptr)
+/*
+ * Open list -- remove grid "g" from bucket "f"
+ */
+static void pf_unlink(pf_scratch *pf, int g, int f)
 {
-	int i, j;
+	if (pf->prev[g] >= 0) pf->next[pf->prev[g]] = pf->next[g];
+	else pf->bucket[f] = pf->next[g];
+	if (pf->next[g] >= 0) pf->prev[pf->next[g]] = pf->prev[g];
+}
 
-	ox = MAX(p_ptr->px - MAX_PF_RADIUS / 2, 0);
-	oy = MAX(p_ptr->py - MAX_PF_RADIUS / 2, 0);
 
-	ex = MIN(p_ptr->px + MAX_PF_RADIUS / 2 - 1, DUNGEON_WID);
-	ey = MIN(p_ptr->py + MAX_PF_RADIUS / 2 - 1, DUNGEON_HGT);
+/*
+ * Find the shortest path from (y1, x1) to (y2, x2) on a level.
+ *
+ * This is an A* search over a MAX_PF_RADIUS square window centered on
+ * the start, using the "king's move" distance as the estimate.  Every
+ * step costs one, so the open list is simply a bucket per estimate,
+ * and the search stops as soon as the target is reached.
+ *
+ * Grids are walkable if "pass" says so; the target itself always is,
+ * so that one can path to a monster or a closed door.
+ *
+ * On success, the directions (1-9) are stored in "path" in reverse
+ * order (the first step is "path[n-1]") and the number of steps "n"
+ * is returned.  If there is no path within the window and "max" steps,
+ * -1 is returned.
+ */
+int path_search(int Depth, int y1, int x1, int y2, int x2,
+		path_hook pass, vptr data, byte *path, int max)
+{
+	pf_scratch pf;
 
-	for (j = 0; j < MAX_PF_RADIUS; j++)
-	for (i = 0; i < MAX_PF_RADIUS; i++)
-		terrain[j][i] = -1;
+	int oy = y1 - PF_SIZE / 2;
+	int ox = x1 - PF_SIZE / 2;
+	int i, f, g, n, y, x, dir, start, goal;
 
-	for (j = oy; j < ey; j++)
-		for (i = ox; i < ex; i++)
-			if (is_valid_pf(p_ptr, j, i))
-				terrain[j - oy][i - ox] = MAX_PF_LENGTH;
+	/* Target must be inside the window */
+	if ((y2 < oy) || (y2 >= oy + PF_SIZE) || (x2 < ox) || (x2 >= ox + PF_SIZE))
+		return (-1);
 
-	terrain[p_ptr->py - oy][p_ptr->px - ox] = 1;
-}
+	if (max > MAX_PF_LENGTH) max = MAX_PF_LENGTH;
 
-#define MARK_DISTANCE(c,d) if ((c <= MAX_PF_LENGTH) && (c > d)) { c = d; try_again = (TRUE); }
+	/* Nothing to do */
+	if ((y1 == y2) && (x1 == x2)) return (0);
 
-bool findpath(player_type *p_ptr, int y, int x)
-{
-	int i, j, k;
-	int dir = 10;
-	bool try_again;
-	int cur_distance;
+	/* Prepare the scratch space */
+	C_WIPE(pf.state, PF_SIZE * PF_SIZE, byte);
+	for (i = 0; i < PF_BUCKETS; i++) pf.bucket[i] = -1;
 
-	fill_terrain_info(p_ptr);
+	start = (y1 - oy) * PF_SIZE + (x1 - ox);
+	goal = (y2 - oy) * PF_SIZE + (x2 - ox);
 
-	terrain[p_ptr->py - oy][p_ptr->px - ox] = 1;
+	/* Start from the starting grid */
+	pf.cost[start] = 0;
+	pf.state[start] = PF_OPEN;
+	f = MAX(ABS(y2 - y1), ABS(x2 - x1));
+	pf_push(&pf, start, f);
 
-	if ((x >= ox) && (x < ex) && (y >= oy) && (y < ey))
+	/* Process the open list in order of estimated length */
+	for (; f < PF_BUCKETS; f++)
 	{
-		if ((cave[p_ptr->dun_depth][y][x].m_idx > 0) && (p_ptr->mon_los[cave[p_ptr->dun_depth][y][x].m_idx ]))
+		while ((g = pf.bucket[f]) >= 0)
 		{
-			terrain[y - oy][x - ox] = MAX_PF_LENGTH;
-		}
+			/* Close the grid */
+			pf_unlink(&pf, g, f);
+			pf.state[g] = PF_CLOSED;
 
-#if 0
-		else if (terrain[y-oy][x-ox] != MAX_PF_LENGTH)
-		{
-		   bell();
-		   return (FALSE);
-		}
-#endif
+			/* Done */
+			if (g == goal) goto found;
 
-		terrain[y - oy][x - ox] = MAX_PF_LENGTH;
-	}
-	else
-	{
-		bell();
-		return (FALSE);
-	}
+			/* Too long */
+			n = pf.cost[g] + 1;
+			if (n > max) continue;
 
-	if (terrain[y - oy][x - ox] == -1)
-	{
-		bell();
-		return (FALSE);
-	}
+			y = oy + g / PF_SIZE;
+			x = ox + g % PF_SIZE;
 
+			/* Look at the neighbours, orthogonal ones first */
+			for (i = 0; i < 8; i++)
+			{
+				int ny, nx, ng, nf;
 
-	/* 
-	 * And now starts the very naive and very 
-	 * inefficient pathfinding algorithm
-	 */
-	do
-	{
-		try_again = FALSE;
+				dir = dir_search[i];
+				ny = y + ddy[dir];
+				nx = x + ddx[dir];
 
-		for (j = oy + 1; j < ey - 1; j++)
-		{
-			for (i = ox + 1; i < ex - 1; i++)
-			{
-				cur_distance = terrain[j - oy][i - ox] + 1;
+				/* Stay inside the window and the level */
+				if ((ny < oy) || (ny >= oy + PF_SIZE) ||
+				    (nx < ox) || (nx >= ox + PF_SIZE)) continue;
+				if (!in_bounds2(Depth, ny, nx)) continue;
+
+				ng = (ny - oy) * PF_SIZE + (nx - ox);
 
-				if ((cur_distance > 0) && (cur_distance < MAX_PF_LENGTH))
+				/* Already done */
+				if (pf.state[ng] == PF_CLOSED) continue;
+
+				/* Not an improvement */
+				if ((pf.state[ng] == PF_OPEN) && (pf.cost[ng] <= n)) continue;
+
+				/* Check the terrain (once) */
+				if (pf.state[ng] == PF_UNSEEN)
 				{
-					for (dir = 1; dir < 10; dir++)
+					if ((ng != goal) && !(*pass)(data, ny, nx))
 					{
-						if (dir == 5)
-							dir++;
-
-						MARK_DISTANCE(terrain[j - oy + ddy[dir]][i - ox + ddx[dir]], cur_distance);
+						pf.state[ng] = PF_CLOSED;
+						continue;
 					}
 				}
-			}
-		}
 
-		if (terrain[y - oy][x - ox] < MAX_PF_LENGTH)
-			try_again = (FALSE);
+				/* Forget the old estimate */
+				else pf_unlink(&pf, ng, pf.cost[ng] +
+					MAX(ABS(y2 - ny), ABS(x2 - nx)));
 
+				/* (Re-)open the grid */
+				nf = n + MAX(ABS(y2 - ny), ABS(x2 - nx));
+				pf.cost[ng] = n;
+				pf.from[ng] = dir;
+				pf.state[ng] = PF_OPEN;
+				pf_push(&pf, ng, nf);
+			}
+		}
 	}
-	while (try_again);
 
 	/* Failure */
-	if (terrain[y - oy][x - ox] == MAX_PF_LENGTH)
+	return (-1);
+
+found:
+
+	/* Walk back from the target */
+	for (n = 0, g = goal; g != start; n++)
 	{
-		bell();
-		return (FALSE);
+		dir = pf.from[g];
+		path[n] = dir;
+		g -= ddy[dir] * PF_SIZE + ddx[dir];
 	}
 
 	/* Success */
-	i = x;
-	j = y;
+	return (n);
+}
 
-	p_ptr->pf_result_index = 0;
 
-	while ((i != p_ptr->px) || (j != p_ptr->py))
-	{
-		cur_distance = terrain[j - oy][i - ox] - 1;
-		for (k = 0; k < 8; k++)
-		{
-			dir = dir_search[k];
+/*
+ * Can a player walk through a grid, as far as he knows?
+ */
+static bool is_valid_pf(vptr data, int y, int x)
+{
+	player_type *p_ptr = (player_type *)data;
+	int Depth = p_ptr->dun_depth;
+	cave_type *c_ptr;
 
-			/* Paranoia -- stay in terrain[][] bounds */
-			if (j - oy + ddy[dir] < 0 ||
-			    j - oy + ddy[dir] >= MAX_PF_RADIUS ||
-			    i - ox + ddx[dir] < 0 ||
-			    i - ox + ddx[dir] >= MAX_PF_RADIUS)
-			{
-				/* Skip this direction */
-				dir = 5;
-				continue;
-			}
+	/* Unvisited means allowed */
+	if (!(p_ptr->cave_flag[y][x] & (CAVE_MARK))) return (TRUE);
 
-			if (terrain[j - oy + ddy[dir]][i - ox + ddx[dir]] == cur_distance)
-				break;
-		}
+	/* Require open space */
+	if (!cave_floor_bold(Depth, y, x)) return (FALSE);
 
-		/* Should never happend */
-		if (dir == 10)
-		{
-			bell();
-			return (FALSE);
-		}
+	/* Hack -- don't step into traps */
+	c_ptr = &cave[Depth][y][x];
+	if ((p_ptr->cave_flag[y][x] & (CAVE_MARK)) /* Known location */
+	&& (c_ptr->feat >= FEAT_TRAP_HEAD) /* Visible trap */
+	&& (c_ptr->feat <= FEAT_TRAP_TAIL)) return (FALSE);
 
-		else if (dir == 5)
-		{
-			bell();
-			return (FALSE);
-		}
+	return (TRUE);
+}
+
+/*
+ * Plan a "travel" path for a player to the given grid
+ */
+bool findpath(player_type *p_ptr, int y, int x)
+{
+	byte path[MAX_PF_LENGTH];
+	int i, n;
 
-		p_ptr->pf_result[p_ptr->pf_result_index++] = '0' + (char)(10 - dir);
-		i += ddx[dir];
-		j += ddy[dir];
+	n = path_search(p_ptr->dun_depth, p_ptr->py, p_ptr->px, y, x,
+		is_valid_pf, (vptr)p_ptr, path, MAX_PF_LENGTH);
 
-		/* Paranoia -- stay in pf_result[MAX_PF_LENGTH] bounds */
-		if (p_ptr->pf_result_index >= MAX_PF_LENGTH)
-		{
-			bell();
-			return (FALSE);
-		}
+	/* Failure */
+	if (n <= 0)
+	{
+		bell();
+		return (FALSE);
 	}
 
-	p_ptr->pf_result_index--;
+	/* Success */
+	for (i = 0; i < n; i++)
+		p_ptr->pf_result[i] = '0' + (char)path[i];
+
+	p_ptr->pf_result_index = n - 1;
 
 	return (TRUE);
 }
-
-
-
@@ -14,87 +14,154 @@ static ang_file* file_handle;		/* Current save "file" */
 static u32b	v_stamp = 0L;	/* A simple "checksum" on the actual values */
 static u32b	x_stamp = 0L;	/* A simple "checksum" on the encoded bytes */
 
-static int xml_indent = 0L;
-static char xml_buf[32];
-static char *xml_prefix = xml_buf;
+/*
+ * The savefile is assembled in memory and written out in one go
+ */
+static char *save_buf = NULL;	/* Record buffer */
+static size_t save_len = 0;	/* Bytes used */
+static size_t save_size = 0;	/* Bytes allocated */
+
+static size_t save_section[SAVE_MAX_SECTIONS];	/* Open section length fields */
+static int save_depth = 0;
+
+/* Append raw bytes */
+static void wr_bytes(const void *data, size_t len)
+{
+	if (save_len + len > save_size)
+	{
+		char *old_buf = save_buf;
+		size_t size = save_size ? save_size : 65536;
+
+		while (save_len + len > size) size *= 2;
+
+		C_MAKE(save_buf, size, char);
+		if (old_buf)
+		{
+			memcpy(save_buf, old_buf, save_len);
+			FREE(old_buf);
+		}
+		save_size = size;
+	}
+	memcpy(save_buf + save_len, data, len);
+	save_len += len;
+}
+
+/* Append a little-endian number of 'len' bytes */
+static void wr_number(huge value, int len)
+{
+	byte buf[8];
+	int i;
+	for (i = 0; i < len; i++)
+	{
+		buf[i] = (byte)(value & 0xFF);
+		value >>= 8;
+	}
+	wr_bytes(buf, len);
+}
+
+/* Start a record */
+static void wr_record(byte type, cptr name)
+{
+	size_t len = strlen(name);
+	if (len > 255) len = 255;
+	wr_number(type, 1);
+	wr_number(len, 1);
+	wr_bytes(name, len);
+}
+
+/* Start a new savefile */
+static void wr_begin(void)
+{
+	save_len = 0;
+	save_depth = 0;
+	wr_bytes(SAVEFILE_MAGIC, SAVEFILE_MAGIC_LEN);
+	wr_number(SAVEFILE_VERSION, 2);
+}
+
+/* Write the finished savefile */
+static bool wr_finish(void)
+{
+	if (save_depth) return FALSE;
+	return file_write(file_handle, save_buf, save_len);
+}
 
 /* Start a section */
 static void start_section(char* name)
 {
-	int i;
-	if(xml_indent == 0) xml_prefix[0] = '\0';
-	file_putf(file_handle, "%s<%s>\n", xml_prefix,name);
-	xml_indent += 2;
-	for(i = 0;i<xml_indent;i++) xml_buf[i] = ' ';
-	xml_buf[xml_indent] = '\0';
+	wr_record(SAVE_REC_SECTION, name);
+	save_section[save_depth++] = save_len;
+	wr_number(0, 4);
 }
 
 /* End a section */
 static void end_section(char* name)
 {
+	size_t pos = save_section[--save_depth];
+	u32b len;
 	int i;
-	xml_indent -= 2;
-	for(i = 0;i<xml_indent;i++) xml_buf[i] = ' ';
-	xml_buf[xml_indent] = '\0';
-	file_putf(file_handle, "%s</%s>\n", xml_prefix, name);
+
+	wr_record(SAVE_REC_END, name);
+
+	/* Fill in the section length */
+	len = save_len - (pos + 4);
+	for (i = 0; i < 4; i++)
+	{
+		save_buf[pos + i] = (char)(len & 0xFF);
+		len >>= 8;
+	}
 }
 
 /* Write an integer */
 static void write_int(char* name, int value)
 {
-	file_putf(file_handle, "%s%s = %i\n", xml_prefix, name, value);
+	wr_record(SAVE_REC_INT, name);
+	wr_number((u32b)value, 4);
 }
 
 /* Write an unsigned integer value */
 static void write_uint(const char* name, unsigned int value)
 {
-	file_putf(file_handle, "%s%s = %u\n", xml_prefix, name, value);
+	wr_record(SAVE_REC_UINT, name);
+	wr_number(value, 4);
 }
 
 /* Write an signed long value */
 static void write_huge(char* name, huge value)
 {
-	file_putf(file_handle, "%s%s = %" PRIu64 "\n", xml_prefix,name, value);
+	wr_record(SAVE_REC_HUGE, name);
+	wr_number(value, 8);
 }
 
 /* Write an hturn */
 static void write_hturn(char* name, hturn *value)
 {
-	file_putf(file_handle, "%s%s = %" PRIu64 " %" PRIu64 "\n", xml_prefix, name, value->era, value->turn);
+	wr_record(SAVE_REC_HTURN, name);
+	wr_number(value->era, 8);
+	wr_number(value->turn, 8);
 }
 
 /* Write a string */
 static void write_str(char* name, char* value)
 {
-	file_putf(file_handle, "%s%s = %s\n", xml_prefix, name, value);
+	size_t len = strlen(value);
+	if (len > 1023) len = 1023;
+	wr_record(SAVE_REC_STR, name);
+	wr_number(len, 2);
+	wr_bytes(value, len);
 }
 
 /* Write a quark (as string) */
 static void write_quark(char* name, u16b quark)
 {
-	char *value = quark ? (char*)quark_str(quark) : "";
-	file_putf(file_handle, "%s%s = %s\n", xml_prefix, name, value);
+	write_str(name, quark ? (char*)quark_str(quark) : "");
 }
 
-#if 0
-static void write_float(char* name, float value)
-{
-	file_putf(file_handle, "%s%s = %f\n", xml_prefix, name, value);
-}
-#endif
 /* Write binary data */
 static void write_binary(char* name, char* data, int len)
 {
-	int i;
-	byte b;
-	file_putf(file_handle, "%s%s = ", xml_prefix, name);
-	for(i=0;i<len;i++)
-	{
-		b = data[i];
-		file_putf(file_handle, "%2x", b);
-	}
-	//fprintf(file_handle,"\n",name);
-	file_putf(file_handle, "\n");
+	wr_record(SAVE_REC_BINARY, name);
+	wr_number(len, 2);
+	wr_bytes(data, len);
 }
 
 
@@ -756,6 +823,7 @@ static void wr_dungeon(int Depth)
 /* HACK -- Write to file */
 bool wr_dungeon_special_ext(int Depth, cptr levelname)
 {
+	bool ok = FALSE;
 	char filename[1024];
 	ang_file* fhandle;
 	ang_file* server_handle;
@@ -771,17 +839,17 @@ bool wr_dungeon_special_ext(int Depth, cptr levelname)
 			file_handle = fhandle;
 
 			/* save the level */
+			wr_begin();
 			wr_dungeon(Depth);
+			ok = wr_finish();
 
 			/* swap the file pointers back */
 			file_handle = server_handle;
 
 			/* close the level file */
-			file_close(fhandle);
-
-			return TRUE;
+			if (!file_close(fhandle)) ok = FALSE;
 	}
-	return FALSE;
+	return ok;
 }
 
 /* Write a players memory of a cave, simmilar to the above function. */
@@ -1020,7 +1088,8 @@ static bool save_player_aux(player_type *p_ptr, char *name)
 	if (file_handle)
 	{
 		/* Write the savefile */
-		if (wr_savefile_new(p_ptr)) ok = TRUE;
+		wr_begin();
+		if (wr_savefile_new(p_ptr) && wr_finish()) ok = TRUE;
 
 		/* Attempt to close it */
 		if (!file_close(file_handle)) ok = FALSE;
@@ -1620,7 +1689,8 @@ static bool save_server_aux(char *name)
         if (file_handle)
         {
                 /* Write the savefile */
-                if (wr_server_savefile()) ok = TRUE;
+                wr_begin();
+                if (wr_server_savefile() && wr_finish()) ok = TRUE;
 
                 /* Attempt to close it */
                 if (!file_close(file_handle)) ok = FALSE;
@@ -1767,3 +1837,246 @@ bool save_server_info(void)
 	/* Return the result */
 	return (result);
 }
+
+
+/*
+ * Convert one line of a textual savefile into a binary record.
+ *
+ * The text format does not record value types, so we pick the record
+ * type whose textual form reproduces the value exactly.  The binary
+ * readers fall back to parsing that textual form whenever a record of
+ * an unexpected type is found, so the conversion is always lossless.
+ */
+static bool convert_line(char *line)
+{
+	char buf[1024];
+	char *name, *value, *c;
+	huge num, num2;
+	s64b snum;
+	int len;
+
+	/* Skip indentation */
+	for (name = line; *name == ' '; name++) /* loop */;
+
+	/* Ignore blank lines */
+	if (!*name) return TRUE;
+
+	/* Section markers */
+	if (*name == '<')
+	{
+		if (!(c = strchr(name, '>'))) return FALSE;
+		*c = '\0';
+
+		if (name[1] == '/')
+		{
+			if (!save_depth) return FALSE;
+			end_section(name + 2);
+		}
+		else
+		{
+			if (save_depth >= SAVE_MAX_SECTIONS) return FALSE;
+			start_section(name + 1);
+		}
+		return TRUE;
+	}
+
+	/* Named values */
+	if (!(c = strstr(name, " = "))) return FALSE;
+	*c = '\0';
+	value = c + 3;
+
+	/* Integers */
+	if (sscanf(value, "%" SCNd64, &snum) == 1)
+	{
+		if (snum >= -2147483647L - 1 && snum <= 2147483647L)
+		{
+			strnfmt(buf, sizeof(buf), "%d", (int)snum);
+			if (streq(buf, value))
+			{
+				write_int(name, (int)snum);
+				return TRUE;
+			}
+		}
+		if (snum >= 0 && snum <= 4294967295LL)
+		{
+			strnfmt(buf, sizeof(buf), "%u", (unsigned int)snum);
+			if (streq(buf, value))
+			{
+				write_uint(name, (unsigned int)snum);
+				return TRUE;
+			}
+		}
+	}
+	if (sscanf(value, "%" SCNu64, &num) == 1)
+	{
+		strnfmt(buf, sizeof(buf), "%" PRIu64, num);
+		if (streq(buf, value))
+		{
+			write_huge(name, num);
+			return TRUE;
+		}
+	}
+
+	/* Turn counters */
+	if (sscanf(value, "%" SCNu64 " %" SCNu64, &num, &num2) == 2)
+	{
+		strnfmt(buf, sizeof(buf), "%" PRIu64 " %" PRIu64, num, num2);
+		if (streq(buf, value))
+		{
+			hturn ht;
+			ht.era = num;
+			ht.turn = num2;
+			write_hturn(name, &ht);
+			return TRUE;
+		}
+	}
+
+	/* Binary data, as written by the old "%2x" encoder */
+	len = strlen(value);
+	if (len && !(len % 2) && len / 2 < (int)sizeof(buf))
+	{
+		unsigned int abyte;
+		int i;
+
+		/* Each byte is " x" or "xx", without a leading zero */
+		for (i = 0; i < len; i += 2)
+		{
+			if (!strchr("0123456789abcdef", value[i + 1])) break;
+			if (value[i] != ' ' && !strchr("123456789abcdef", value[i])) break;
+		}
+		if (i == len)
+		{
+			for (i = 0; i < len; i += 2)
+			{
+				char hex[3];
+				hex[0] = value[i];
+				hex[1] = value[i + 1];
+				hex[2] = '\0';
+				sscanf(hex, "%2x", &abyte);
+				buf[i / 2] = (char)abyte;
+			}
+			write_binary(name, buf, len / 2);
+			return TRUE;
+		}
+	}
+
+	/* Anything else is a string */
+	write_str(name, value);
+	return TRUE;
+}
+
+/*
+ * Convert a textual savefile into the binary format.
+ *
+ * The original is kept as "<name>.old".
+ */
+static bool convert_savefile(cptr name)
+{
+	char buf[1024];
+	char safe[1024];
+	char temp[1024];
+	bool ok = TRUE;
+
+	/* Read the text */
+	file_handle = file_open(name, MODE_READ, -1);
+	if (!file_handle) return FALSE;
+
+	wr_begin();
+	while (ok && file_getl(file_handle, buf, sizeof(buf)))
+	{
+		ok = convert_line(buf);
+	}
+	if (file_error(file_handle)) ok = FALSE;
+	file_close(file_handle);
+
+	/* Unbalanced sections */
+	if (!ok || save_depth) return FALSE;
+
+	/* Write the records */
+	strnfmt(safe, sizeof(safe), "%s.new", name);
+	file_delete(safe);
+	file_handle = file_open(safe, MODE_WRITE, FTYPE_SAVE);
+	if (!file_handle) return FALSE;
+	if (!wr_finish()) ok = FALSE;
+	if (!file_close(file_handle)) ok = FALSE;
+	if (!ok)
+	{
+		file_delete(safe);
+		return FALSE;
+	}
+
+	/* Keep the original around */
+	strnfmt(temp, sizeof(temp), "%s.old", name);
+	file_delete(temp);
+	if (!file_move(name, temp))
+	{
+		file_delete(safe);
+		return FALSE;
+	}
+
+	/* Put the original back if the new file can't take its place */
+	if (!file_move(safe, name))
+	{
+		file_move(temp, name);
+		file_delete(safe);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Convert every textual savefile in the save directory to the binary
+ * format.  Text savefiles are still loaded, and are converted anyway
+ * the next time they are saved, but this spares the server from
+ * parsing them at runtime.
+ */
+void convert_savefiles(void)
+{
+	ang_dir *dir;
+	ang_file *fd;
+	char fname[1024];
+	char path[1024];
+	char first;
+	int done = 0, failed = 0;
+
+	dir = my_dopen(ANGBAND_DIR_SAVE);
+	if (!dir)
+	{
+		plog(format("Cannot open save directory %s", ANGBAND_DIR_SAVE));
+		return;
+	}
+
+	while (my_dread(dir, fname, sizeof(fname)))
+	{
+		/* Skip backups and unfinished saves */
+		if (suffix(fname, ".old") || suffix(fname, ".new")) continue;
+
+		path_build(path, sizeof(path), ANGBAND_DIR_SAVE, fname);
+
+		/* Textual savefiles start with a section */
+		fd = file_open(path, MODE_READ, -1);
+		if (!fd) continue;
+		do
+		{
+			first = '\0';
+			file_read(fd, &first, 1);
+		}
+		while (first == ' ');
+		file_close(fd);
+		if (first != '<') continue;
+
+		if (convert_savefile(path))
+		{
+			done++;
+		}
+		else
+		{
+			plog(format("Cannot convert savefile %s", path));
+			failed++;
+		}
+	}
+	my_dclose(dir);
+
+	plog(format("Converted %d savefiles (%d failed)", done, failed));
+}
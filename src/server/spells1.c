@@ -1617,6 +1617,7 @@ static bool project_f(int who, int r, int Depth, int y, int x, int dam, int typ)
 
 				/* Destroy the tree */
 				c_ptr->feat = FEAT_DIRT;
+				update_wall_spot(Depth, y, x);
 				if (Depth == 0) trees_in_town--;
 			}
 
@@ -2185,7 +2186,7 @@ static bool project_i(int who, int r, int Depth, int y, int x, int dam, int typ)
 					object_known(o_ptr);
 
 					/* Notice */
-					if (!quiet && p_ptr->obj_vis[c_ptr->o_idx])
+					if (!quiet && vis_has(p_ptr->obj_vis, c_ptr->o_idx))
 					{
 						msg_print(p_ptr, "Click!");
 						obvious = TRUE;
@@ -2202,7 +2203,7 @@ static bool project_i(int who, int r, int Depth, int y, int x, int dam, int typ)
 	if (do_kill)
 	{
 		/* Effect "observed" */
-		if (!quiet && p_ptr->obj_vis[c_ptr->o_idx])
+		if (!quiet && vis_has(p_ptr->obj_vis, c_ptr->o_idx))
 		{
 			obvious = TRUE;
 			object_desc(p_ptr, o_name, sizeof(o_name), o_ptr, FALSE, 0);
@@ -2212,7 +2213,7 @@ static bool project_i(int who, int r, int Depth, int y, int x, int dam, int typ)
 		if (is_art || ignore)
 		{
 			/* Observe the resist */
-			if (!quiet && p_ptr->obj_vis[c_ptr->o_idx])
+			if (!quiet && vis_has(p_ptr->obj_vis, c_ptr->o_idx))
 			{
 				msg_format(p_ptr, "The %s %s unaffected!",
 				           o_name, (plural ? "are" : "is"));
@@ -2223,7 +2224,7 @@ static bool project_i(int who, int r, int Depth, int y, int x, int dam, int typ)
 		else
 		{
 			/* Describe if needed */
-			if (!quiet && p_ptr->obj_vis[c_ptr->o_idx] && note_kill)
+			if (!quiet && vis_has(p_ptr->obj_vis, c_ptr->o_idx) && note_kill)
 			{
 				msg_format(p_ptr, "The %s%s", o_name, note_kill);
 				sound(p_ptr, MSG_DESTROY);
@@ -2372,7 +2373,7 @@ static bool project_m(int who, int r, int Depth, int y, int x, int dam, int typ)
 
 	/* Set the "seen" flag */
 	if (!quiet)
-		seen = p_ptr->mon_vis[c_ptr->m_idx];
+		seen = vis_has(p_ptr->mon_vis, c_ptr->m_idx);
 	else seen = FALSE;
 
 	/* Extract radius */
@@ -3440,7 +3441,7 @@ static bool project_m(int who, int r, int Depth, int y, int x, int dam, int typ)
 			else if (!quiet && dam > 0) message_pain(p_ptr, c_ptr->m_idx, dam);
 
 			/* Take note */
-			if (!quiet && (fear || do_fear) && (p_ptr->mon_vis[c_ptr->m_idx]) && !(r_ptr->flags2 & RF2_WANDERER))
+			if (!quiet && (fear || do_fear) && (vis_has(p_ptr->mon_vis, c_ptr->m_idx)) && !(r_ptr->flags2 & RF2_WANDERER))
 			{
 				/* Sound */
 				sound(p_ptr, MSG_FLEE);
@@ -4832,8 +4833,8 @@ bool project(int who, int rad, int Depth, int y, int x, int dam, int typ, int fl
 				if (m_idx > 0)
 				{
 					int r_idx = m_list[m_idx].r_idx;
-					if (p_ptr->mon_vis[m_idx]) monster_race_track(p_ptr, r_idx);
-					if (p_ptr->mon_vis[m_idx]) health_track(p_ptr, m_idx);
+					if (vis_has(p_ptr->mon_vis, m_idx)) monster_race_track(p_ptr, r_idx);
+					if (vis_has(p_ptr->mon_vis, m_idx)) health_track(p_ptr, m_idx);
 				}
 			}
 		}
@@ -4895,7 +4896,7 @@ bool project(int who, int rad, int Depth, int y, int x, int dam, int typ, int fl
 				/* Hack - auto-track player */
 				if (m_idx < 0)
 				{
-					if (p_ptr->play_vis[0 - m_idx]) health_track(p_ptr, m_idx);
+					if (vis_has(p_ptr->play_vis, 0 - m_idx)) health_track(p_ptr, m_idx);
 				}
 			}
 		}		
@@ -73,6 +73,7 @@ void wipe_spell(int Depth, int cy, int cx, int r)
 			{
 				/* Turn into basic floor */
 				c_ptr->feat = FEAT_FLOOR;
+				update_wall_spot(Depth, yy, xx);
 			
 				/* Delete objects */
 				delete_object(Depth, yy, xx);
@@ -1365,13 +1366,13 @@ bool detect_treasure(player_type *p_ptr)
 			if (o_ptr->tval == TV_GOLD)
 			{
 				/* Notice new items */
-				if (!(p_ptr->obj_vis[c_ptr->o_idx]))
+				if (!(vis_has(p_ptr->obj_vis, c_ptr->o_idx)))
 				{
 					/* Detect */
 					detect = TRUE;
 
 					/* Hack -- memorize the item */
-					p_ptr->obj_vis[c_ptr->o_idx] = TRUE;
+					vis_on(p_ptr->obj_vis, c_ptr->o_idx);
 
 					/* Redraw */
 					lite_spot(p_ptr, y, x);
@@ -1447,13 +1448,13 @@ bool detect_objects_magic(player_type *p_ptr)
 			    ((o_ptr->to_a > 0) || (o_ptr->to_h + o_ptr->to_d > 0)))
 			{
 				/* Note new items */
-				if (!(p_ptr->obj_vis[c_ptr->o_idx]))
+				if (!(vis_has(p_ptr->obj_vis, c_ptr->o_idx)))
 				{
 					/* Detect */
 					detect = TRUE;
 
 					/* Memorize the item */
-					p_ptr->obj_vis[c_ptr->o_idx] = TRUE;
+					vis_on(p_ptr->obj_vis, c_ptr->o_idx);
 
 					/* Redraw */
 					lite_spot(p_ptr, i, j);
@@ -1482,7 +1483,7 @@ void give_detect(player_type *p_ptr, int m_idx)
 	power = 2 + ((p_ptr->lev + 2) / 5);
 
 	/* Also, let's scale down when spamming */
-	i = (m_idx < 0 ? p_ptr->play_det[0 - m_idx] : p_ptr->mon_det[m_idx]);
+	i = (m_idx < 0 ? p_ptr->play_det[0 - m_idx] : monster_detection(p_ptr, m_idx));
 	power = i ? 1 : power;
 
 	/* Players */
@@ -1495,8 +1496,7 @@ void give_detect(player_type *p_ptr, int m_idx)
 	/* Monsters */
 	else
 	{
-		p_ptr->mon_det[m_idx] = MIN(
-		    (int)p_ptr->mon_det[m_idx] + power, 255);
+		add_monster_detection(p_ptr, m_idx, power);
 	}
 }
 
@@ -1548,7 +1548,7 @@ bool detect_invisible(player_type *p_ptr, bool pause)
 			give_detect(p_ptr, i);
 
 			/* Skip visible monsters */
-			if (p_ptr->mon_vis[i]) continue;
+			if (vis_has(p_ptr->mon_vis, i)) continue;
 
 			/* Take note that they are invisible */
 			l_ptr->flags2 |= RF2_INVISIBLE;
@@ -1588,7 +1588,7 @@ bool detect_invisible(player_type *p_ptr, bool pause)
 			give_detect(p_ptr, 0 - i);
 
 			/* Skip visible players */
-			if (p_ptr->play_vis[0 - i]) continue;
+			if (vis_has(p_ptr->play_vis, i)) continue;
 
 			/* Trigger detect effects */
 			flag = TRUE;
@@ -1750,7 +1750,7 @@ bool detect_creatures(player_type *p_ptr, bool pause)
 			give_detect(p_ptr, i);
 
 			/* Skip visible monsters */
-			if (p_ptr->mon_vis[i]) continue;
+			if (vis_has(p_ptr->mon_vis, i)) continue;
 
 			flag = TRUE;
 		}
@@ -1780,7 +1780,7 @@ bool detect_creatures(player_type *p_ptr, bool pause)
 			give_detect(p_ptr, 0 - i);
 
 			/* Skip visible players */
-			if (p_ptr->play_vis[i]) continue;
+			if (vis_has(p_ptr->play_vis, i)) continue;
 
 			/* Trigger detect effects */
 			flag = TRUE;
@@ -1895,13 +1895,13 @@ bool detect_objects_normal(player_type *p_ptr)
 			if (o_ptr->tval == TV_GOLD) continue;
 
 			/* Note new objects */
-			if (!(p_ptr->obj_vis[c_ptr->o_idx]))
+			if (!(vis_has(p_ptr->obj_vis, c_ptr->o_idx)))
 			{
 				/* Detect */
 				detect = TRUE;
 
 				/* Hack -- memorize it */
-				p_ptr->obj_vis[c_ptr->o_idx] = TRUE;
+				vis_on(p_ptr->obj_vis, c_ptr->o_idx);
 
 				/* Redraw */
 				lite_spot(p_ptr, i, j);
@@ -3739,6 +3739,9 @@ void destroy_area(int Depth, int y1, int x1, int r, bool full)
 					/* Create floor */
 					c_ptr->feat = FEAT_FLOOR;
 				}
+
+				/* Update the walls */
+				update_wall_spot(Depth, y, x);
 			}
 		}
 	}
@@ -4234,6 +4237,9 @@ void earthquake(int Depth, int cy, int cx, int r)
 					/* Create floor */
 					c_ptr->feat = FEAT_FLOOR;
 				}
+
+				/* Update the walls */
+				update_wall_spot(Depth, yy, xx);
 			}
 		}
 	}
@@ -4344,7 +4350,7 @@ static void cave_temp_room_lite(player_type *p_ptr)
 				m_ptr->csleep = 0;
 
 				/* Notice the "waking up" */
-				if (p_ptr->mon_vis[c_ptr->m_idx])
+				if (vis_has(p_ptr->mon_vis, c_ptr->m_idx))
 				{
 					char m_name[80];
 
@@ -4857,8 +4863,8 @@ bool alter_reality(player_type *p_ptr, bool power)
 				/* Saving throw: perception (harder if hostile) */
 				if (randint0(127) < q_ptr->skill_fos * (pvp_okay(p_ptr, q_ptr, 0) ? 6 : 4))
 				{
-					msg_format(p_ptr, "%s sustains reality.", (p_ptr->play_los[i] ? q_ptr->name : "Someone"));
-					msg_format(q_ptr, "You resist %s's attempt to alter reality.", (q_ptr->play_los[p_ptr->Ind] ? p_ptr->name : "someone") );
+					msg_format(p_ptr, "%s sustains reality.", (vis_has(p_ptr->play_los, i) ? q_ptr->name : "Someone"));
+					msg_format(q_ptr, "You resist %s's attempt to alter reality.", (vis_has(q_ptr->play_los, p_ptr->Ind) ? p_ptr->name : "someone") );
 					return (FALSE);
 				}
 			}
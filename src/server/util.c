@@ -1387,31 +1387,71 @@ char inkey(int Ind)
  * index, which should greatly reduce the need for inscription space.
  *
  * Note that "quark zero" is NULL and should not be "dereferenced".
+ *
+ * The quarks are also kept in a hash table, so that looking for an
+ * existing quark does not compare the string with every other quark.
+ * Quarks with the same hash value are chained through "quark__next".
+ */
+static s16b quark__hash[QUARK_HASH_SIZE];
+static s16b quark__next[QUARK_MAX];
+
+
+/*
+ * Return the hash slot of a string
  */
+static int quark_slot(cptr str)
+{
+	u32b h = 5381;
+
+	/* Hash each character */
+	while (*str) h = (h * 33) ^ (byte)(*str++);
+
+	return (h & (QUARK_HASH_SIZE - 1));
+}
+
 
 /*
  * Add a new "quark" to the set of quarks.
  */
 s16b quark_add(cptr str)
 {
-	int i;
+	int i, slot;
+
+	/* Get the slot */
+	slot = quark_slot(str);
 
 	/* Look for an existing quark */
-	for (i = 1; i < quark__num; i++)
+	for (i = quark__hash[slot]; i; i = quark__next[i])
 	{
 		/* Check for equality */
 		if (streq(quark__str[i], str)) return (i);
 	}
 
 	/* Paranoia -- Require room */
-	if (quark__num == QUARK_MAX) return (0);
+	if (quark__num == QUARK_MAX)
+	{
+		static bool warned = FALSE;
+
+		/* Warn once */
+		if (!warned) plog("Too many quarks!");
+		warned = TRUE;
+
+		return (0);
+	}
+
+	/* Quark zero is never used */
+	if (!quark__num) quark__num = 1;
 
 	/* New maximal quark */
-	quark__num = i + 1;
+	i = quark__num++;
 
 	/* Add a new quark */
 	quark__str[i] = string_make(str);
 
+	/* Hash it */
+	quark__next[i] = quark__hash[slot];
+	quark__hash[slot] = i;
+
 	/* Return the index */
 	return (i);
 }
@@ -2070,7 +2110,7 @@ void msg_format_monster(int m_idx, player_type *q_ptr, u16b type, cptr fmt_vis,
 		    !(m_ptr->closest_player == qq_ptr->Ind)) continue;
 
 		/* Can he see this monster? */
-		if (qq_ptr->mon_vis[m_idx])
+		if (vis_has(qq_ptr->mon_vis, m_idx))
 		{
 			/* Send "normal" message */
 			msg_print_aux(qq_ptr, buf_vis, type);
@@ -155,14 +155,14 @@ bool scan_objects;		/* Hack -- optimize multi-hued code, etc */
 /*s16b inven_cnt;*/			/* Number of items in inventory */
 /*s16b equip_cnt;*/			/* Number of items in equipment */
 
-s32b o_nxt = 1;			/* Object free scanner */
-s32b m_nxt = 1;			/* Monster free scanner */
+s32b o_free_num = 0;		/* Number of dead objects in "o_free" */
+s32b m_free = 0;		/* First dead monster (see "m_pop()") */
 
 s32b o_max = 1;			/* Object heap size */
 s32b m_max = 1;			/* Monster heap size */
 
 s32b o_top = 0;			/* Object top size */
-s32b m_top = 0;			/* Monster top size */
+s32b m_top = 0;			/* Monster live count */
 
 s32b p_max = 0;			/* Player heap size */ 
 
@@ -180,6 +180,10 @@ char * cfg_dungeon_master = NULL;
 char * cfg_load_pref_file = NULL;
 bool cfg_secret_dungeon_master = 0;
 s16b cfg_fps = 12;
+bool cfg_cork_output = TRUE;
+s16b cfg_compress_output = 0;
+bool cfg_network_thread = FALSE;
+s16b cfg_level_threads = 0;
 s32b cfg_tcp_port = 18346;
 bool cfg_safe_recharge = FALSE;
 bool cfg_no_steal = 0;
@@ -424,9 +428,33 @@ u32b window_mask[8];*/
 s16b o_fast[MAX_O_IDX];
 
 /*
- * The array of indexes of "live" monsters
+ * The array of indexes of "dead" objects, ready for reuse.
+ * These are never in "o_fast" at the same time.
  */
-s16b m_fast[MAX_M_IDX];
+s16b o_free[MAX_O_IDX];
+
+/*
+ * The objects of each depth, kept as doubly linked lists like the
+ * monsters below.  Dead objects stay on their list until their slot
+ * is given back to "o_free", so users must check "k_idx".
+ */
+s16b o_depth_world[MAX_DEPTH+MAX_WILD];
+s16b *o_depth_first = &(o_depth_world[MAX_WILD]);
+s16b o_depth_next[MAX_O_IDX];
+s16b o_depth_prev[MAX_O_IDX];
+
+/*
+ * The "live" monsters of each depth, kept as doubly linked lists.
+ * The head of each list is "m_depth_first[Depth]", and the links
+ * are "m_depth_next[]" and "m_depth_prev[]", with zero ending a list.
+ *
+ * Dead monsters are kept in a list too, starting at "m_free" and
+ * linked by "m_depth_next[]", so that "m_pop()" can reuse them.
+ */
+s16b m_depth_world[MAX_DEPTH+MAX_WILD];
+s16b *m_depth_first = &(m_depth_world[MAX_WILD]);
+s16b m_depth_next[MAX_M_IDX];
+s16b m_depth_prev[MAX_M_IDX];
 
 
 /*
@@ -438,8 +466,8 @@ s16b m_fast[MAX_M_IDX];
    I currently have a huge number (4096?) of wilderness levels allocated.
    -APD-
 */ 
-cave_type **world[MAX_DEPTH+MAX_WILD]; 
-cave_type ***cave = &world[MAX_WILD];
+cave_row *world[MAX_DEPTH+MAX_WILD]; 
+cave_row **cave = &world[MAX_WILD];
 wilderness_type world_info[MAX_WILD+1];
 wilderness_type *wild_info=&(world_info[MAX_WILD]);
 
@@ -449,6 +477,25 @@ wilderness_type *wild_info=&(world_info[MAX_WILD]);
 hturn turn_worldgen[MAX_DEPTH+MAX_WILD];
 hturn *turn_cavegen = &turn_worldgen[MAX_WILD];
 
+/*
+ * Monster "flow" information for each level (allocated on demand)
+ */
+flow_type *flow_world[MAX_DEPTH+MAX_WILD];
+flow_type **cave_flow = &flow_world[MAX_WILD];
+
+/*
+ * Wall bitboard for each level (allocated on demand)
+ */
+wall_type *wall_world[MAX_DEPTH+MAX_WILD];
+wall_type **cave_wall = &wall_world[MAX_WILD];
+
+/*
+ * Bumped whenever the view of some player on a depth changes
+ * (see "update_view()"), indexed by depth like "cave"
+ */
+u32b view_epoch_world[MAX_DEPTH+MAX_WILD];
+u32b *view_epoch = &view_epoch_world[MAX_WILD];
+
 /*
  * The array of dungeon items [MAX_O_IDX]
  */
@@ -2247,7 +2247,7 @@ static void wilderness_gen_hack(int Depth)
 	Rand_quick = rand_old;
 
 	/* Hack -- reattach existing objects to the map */
-	setup_objects();
+	setup_level_objects(Depth);
 	/* Hack -- reattach existing monsters to the map */
 	setup_monsters();
 }
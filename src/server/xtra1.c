@@ -1191,7 +1191,7 @@ static void cursor_redraw(player_type *p_ptr)
 		}
 
 		/* Tracking an unseen player */
-		else if (!p_ptr->play_vis[0 - p_ptr->cursor_who])
+		else if (!vis_has(p_ptr->play_vis, 0 - p_ptr->cursor_who))
 		{
 			/* Should not be possible */
 			vis = 0;
@@ -1214,7 +1214,7 @@ static void cursor_redraw(player_type *p_ptr)
 	}
 
 	/* Tracking an unseen monster */
-	else if (!p_ptr->mon_vis[p_ptr->cursor_who])
+	else if (!vis_has(p_ptr->mon_vis, p_ptr->cursor_who))
 	{
 		/* Reset cursor */
 		vis = 0;
@@ -1309,7 +1309,7 @@ static void health_redraw(player_type *p_ptr)
 		}
 
 		/* Tracking an unseen player */
-		else if (!p_ptr->play_vis[0 - p_ptr->health_who])
+		else if (!vis_has(p_ptr->play_vis, 0 - p_ptr->health_who))
 		{
 			/* Indicate that the player health is "unknown" */
 			attr = TERM_WHITE;
@@ -1356,7 +1356,7 @@ static void health_redraw(player_type *p_ptr)
 	}
 
 	/* Tracking an unseen monster */
-	else if (!p_ptr->mon_vis[p_ptr->health_who])
+	else if (!vis_has(p_ptr->mon_vis, p_ptr->health_who))
 	{
 		/* Indicate that the monster health is "unknown" */
 		attr = TERM_WHITE;
@@ -3222,7 +3222,7 @@ void update_stuff(player_type *p_ptr)
 	if (p_ptr->update & PU_FLOW)
 	{
 		p_ptr->update &= ~(PU_FLOW);
-		update_flow();
+		update_flow(p_ptr->dun_depth);
 	}
 
 
@@ -3230,15 +3230,15 @@ void update_stuff(player_type *p_ptr)
 	{
 		p_ptr->update &= ~(PU_DISTANCE);
 		p_ptr->update &= ~(PU_MONSTERS);
-		update_monsters(TRUE);
-		update_players();
+		update_monsters_depth(p_ptr->dun_depth, TRUE);
+		update_players_depth(p_ptr->dun_depth);
 	}
 
 	if (p_ptr->update & PU_MONSTERS)
 	{
 		p_ptr->update &= ~(PU_MONSTERS);
-		update_monsters(FALSE);
-		update_players();
+		update_monsters_depth(p_ptr->dun_depth, FALSE);
+		update_players_depth(p_ptr->dun_depth);
 	}
 }
 
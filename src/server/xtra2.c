@@ -2159,7 +2159,7 @@ void monster_death(player_type *p_ptr, int m_idx)
 		q_ptr = Players[i];
 		if (q_ptr->in_hack)
 		{
-			bool visible = (q_ptr->mon_vis[m_idx] || unique);
+			bool visible = (vis_has(q_ptr->mon_vis, m_idx) || unique);
 
 			/* Take note of the killer (message) */
 			if (unique && !same_player(q_ptr, p_ptr))
@@ -2938,7 +2938,7 @@ bool mon_take_hit(player_type *p_ptr, int m_idx, int dam, bool *fear, cptr note)
 	if (m_idx == 0) return TRUE;
 
 	/* Remember that he hurt it */
-	p_ptr->mon_hrt[m_idx] = TRUE;
+	vis_on(p_ptr->mon_hrt, m_idx);
 
 	/* Redraw (later) if needed */
 	update_health(m_idx);
@@ -2981,7 +2981,7 @@ bool mon_take_hit(player_type *p_ptr, int m_idx, int dam, bool *fear, cptr note)
 		}
 
 		/* Death by physical attack -- invisible monster */
-		else if (!p_ptr->mon_vis[m_idx])
+		else if (!vis_has(p_ptr->mon_vis, m_idx))
 		{
 			msg_format_near(p_ptr, "%s has killed %s.", p_ptr->name, m_name);
 			msg_format(p_ptr, "You have killed %s.", m_name);
@@ -3052,7 +3052,7 @@ bool mon_take_hit(player_type *p_ptr, int m_idx, int dam, bool *fear, cptr note)
 		//if (r_ptr->flags1 & RF1_UNIQUE) r_ptr->max_num = 0;
 
 		/* Recall even invisible uniques or winners */
-		if (p_ptr->mon_vis[m_idx] || (r_ptr->flags1 & RF1_UNIQUE))
+		if (vis_has(p_ptr->mon_vis, m_idx) || (r_ptr->flags1 & RF1_UNIQUE))
 		{
 			/* Count kills by all players */
 			if (r_ptr->r_tkills < MAX_SHORT) r_ptr->r_tkills++;
@@ -3544,7 +3544,7 @@ bool target_able(player_type *p_ptr, int m_idx)
 		m_ptr = &m_list[m_idx];
 
 		/* Monster must be visible */
-		if (!p_ptr->mon_vis[m_idx]) return (FALSE);
+		if (!vis_has(p_ptr->mon_vis, m_idx)) return (FALSE);
 
 		/* Monster must be projectable */
 		if (!projectable(p_ptr->dun_depth, p_ptr->py, p_ptr->px, m_ptr->fy, m_ptr->fx)) return (FALSE);
@@ -3829,21 +3829,21 @@ static bool target_set_interactive_accept(player_type *p_ptr, int y, int x)
 	if (c_ptr->m_idx < 0)
 	{
 		/* Visible monsters */
-		if (p_ptr->play_vis[0 - c_ptr->m_idx]) return (TRUE);
+		if (vis_has(p_ptr->play_vis, 0 - c_ptr->m_idx)) return (TRUE);
 	}
 	
 	/* Visible monsters */
 	if (c_ptr->m_idx > 0)
 	{
 		/* Visible monsters */
-		if (p_ptr->mon_vis[c_ptr->m_idx]) return (TRUE);
+		if (vis_has(p_ptr->mon_vis, c_ptr->m_idx)) return (TRUE);
 	}
 	
 	/* Objects */
 	if (c_ptr->o_idx)
 	{
 		/* Memorized object */
-		if (p_ptr->obj_vis[c_ptr->o_idx]) return (TRUE);	
+		if (vis_has(p_ptr->obj_vis, c_ptr->o_idx)) return (TRUE);	
 	}
 #if 0
 	/* Scan all objects in the grid */
@@ -4067,7 +4067,7 @@ static void target_set_interactive_aux(player_type *p_ptr, int y, int x, int mod
 	}
 
 	/* Visible player */
-	else if (m_idx < 0 && p_ptr->play_vis[0 - m_idx])
+	else if (m_idx < 0 && vis_has(p_ptr->play_vis, 0 - m_idx))
 	{
 		player_type *q_ptr = Players[0 - m_idx];
 	
@@ -4104,7 +4104,7 @@ static void target_set_interactive_aux(player_type *p_ptr, int y, int x, int mod
 	}
 
 	/* Visible monster */
-	else if (m_idx > 0 && p_ptr->mon_vis[m_idx])
+	else if (m_idx > 0 && vis_has(p_ptr->mon_vis, m_idx))
 	{
 		monster_type *m_ptr = &m_list[m_idx];
 		char m_name[80];
@@ -4140,7 +4140,7 @@ static void target_set_interactive_aux(player_type *p_ptr, int y, int x, int mod
 	}
 
 	/* Visible Object */
-	else if (o_idx > 0 && p_ptr->obj_vis[o_idx])
+	else if (o_idx > 0 && vis_has(p_ptr->obj_vis, o_idx))
 	{
 		object_type *o_ptr = &o_list[o_idx];
 		
@@ -5112,24 +5112,28 @@ u32b level_speed(int Depth)
 	else return level_speeds[Depth]*5;
 }
 
-/* Hack -- return TRUE if there are monsters in LoS, FALSE otherwise. */
+/* Hack -- return TRUE if there are monsters in LoS, FALSE otherwise.
+ * The "mon_los_num"/"play_los_num" counters let us skip the scans when
+ * nothing at all is in view, otherwise only monsters on our level are
+ * checked (whether they are awake is not tracked by the counters). */
 bool monsters_in_los(player_type *p_ptr)
 {
 	int i;
 	bool los;
 	/* If nothing in LoS */
 	los = FALSE;
-	for (i = 1; i < m_max; i++)
+	if (p_ptr->mon_los_num)
+	for (i = m_depth_first[p_ptr->dun_depth]; i; i = m_depth_next[i])
 	{
 		/* Check this monster */
-		if ((p_ptr->mon_los[i] && !m_list[i].csleep))
+		if ((vis_has(p_ptr->mon_los, i) && !m_list[i].csleep))
 		{
 			los = TRUE;
 			break;
 		}
 	}
 	/* Hostile players count as monsters */
-	if (!los) for (i = 1; i <= NumPlayers; i++)
+	if (!los && p_ptr->play_los_num) for (i = 1; i <= NumPlayers; i++)
 	{
 		player_type *q_ptr = Players[i];
 		if (same_player(q_ptr, p_ptr)) continue; /* Skip self */
@@ -5137,7 +5141,7 @@ bool monsters_in_los(player_type *p_ptr)
 		if (p_ptr->conn <= -1) break; /* Can't check hostility */
 
 		/* Check this player */
-		if ((p_ptr->play_los[i]) && !q_ptr->paralyzed)
+		if ((vis_has(p_ptr->play_los, i)) && !q_ptr->paralyzed)
 		{
 			if (check_hostile(p_ptr, q_ptr))
 			{
@@ -5149,34 +5153,14 @@ bool monsters_in_los(player_type *p_ptr)
 	return los;
 }
 
-/* Determine the speed of a given players "time bubble" and return a percentage 
- * scaling factor which should be applied to any amount of energy granted to 
- * players/monsters within the bubble.
- * 
- * We check this player and then any other players recursively, the time of the
- * slowest bubble below normal time overrules other adjoining bubbles. This is 
- * to support the senario where a long chain of players may be stood just within 
- * each others range. Forming a time bubble chain. :)
- * 
- * When calling this function pass slowest as zero, which acts as a flag
- * that this is the main call, not a recursive call.
+/* Determine the speed of a given players own "time bubble" and return a
+ * percentage scaling factor, ignoring any other players around him.
+ * "los" is set if there is something dangerous in his line of sight.
  */
-int base_time_factor(player_type *p_ptr, int slowest)
+static int player_time_factor(player_type *p_ptr, bool *los)
 {
-	player_type * q_ptr;
-	int i, dist, health, timefactor;
-	bool los;
-	
-	/* If this is the initial call, reset all players time bubble check */
-	if(!slowest)
-	{
-		for (i = 1; i <= NumPlayers; i++)
-		{
-			q_ptr = Players[i];
-			if(q_ptr) q_ptr->bubble_checked = FALSE;
-		}		
-	}
-	
+	int health, timefactor;
+
 	/* Normal time scale */
 	timefactor = NORMAL_TIME;
 	
@@ -5195,57 +5179,125 @@ int base_time_factor(player_type *p_ptr, int slowest)
 #endif
 
 	/* If nothing in LoS */
-	los = monsters_in_los(p_ptr);
+	*los = monsters_in_los(p_ptr);
 
 	/* Hack -- prevent too much manual slowdown */
-	if (p_ptr->hitpoint_warn > 9 && !los) timefactor = NORMAL_TIME;
+	if (p_ptr->hitpoint_warn > 9 && !*los) timefactor = NORMAL_TIME;
 
 	/* Resting speeds up time disregarding health time scaling */
-	if (p_ptr->resting && !los) timefactor = MAX_TIME_SCALE;
+	if (p_ptr->resting && !*los) timefactor = MAX_TIME_SCALE;
 
 	/* Running speeds up time */
-	if (p_ptr->running && !los) timefactor = RUNNING_FACTOR;
+	if (p_ptr->running && !*los) timefactor = RUNNING_FACTOR;
 
-	
-	/* If this is a check for another player give way to their time
-	 * bubble if we aren't doing anything important */
-	if(slowest && (timefactor == NORMAL_TIME))
+	return timefactor;
+}
+
+/* Find the chain a player belongs to (see "update_time_bubbles()") */
+static int bubble_find(s16b *chain, int i)
+{
+	while (chain[i] != i)
 	{
-		if(!los)
-		{
-			/* We don't really care about our time */
-			timefactor = MAX_TIME_SCALE;
-		}
+		/* Halve the path as we go */
+		chain[i] = chain[chain[i]];
+		i = chain[i];
 	}
+	return i;
+}
 
-	/* We have checked our time bubble */
-	p_ptr->bubble_checked = TRUE;
+/* Determine the speed of every players "time bubble" for this turn and
+ * store the percentage scaling factor which should be applied to any amount
+ * of energy granted to players/monsters within the bubble.
+ * 
+ * The time of the slowest bubble below normal time overrules other adjoining
+ * bubbles. This is to support the senario where a long chain of players may
+ * be stood just within each others range. Forming a time bubble chain. :)
+ *
+ * The chains are found once per turn (players on the same level within
+ * MAX_SIGHT of each other are joined), and the result is cached in
+ * "bubble_factor" for "base_time_factor()".
+ */
+void update_time_bubbles(void)
+{
+	static s16b chain[MAX_PLAYERS + 1], slowest_who[MAX_PLAYERS + 1];
+	static s32b own[MAX_PLAYERS + 1], other[MAX_PLAYERS + 1];
+	static s32b slowest[MAX_PLAYERS + 1], second[MAX_PLAYERS + 1];
+	player_type *p_ptr, *q_ptr;
+	int i, j, r, dist;
+	bool los;
 
-	/* Check all other players within our range */
 	for (i = 1; i <= NumPlayers; i++)
 	{
-		q_ptr = Players[i];
-		/* Only check them if they haven't already been checked */
-		if(q_ptr && (!q_ptr->bubble_checked))
+		p_ptr = Players[i];
+
+		/* Our own time bubble */
+		own[i] = player_time_factor(p_ptr, &los);
+
+		/* When seen from another player give way to their time
+		 * bubble if we aren't doing anything important */
+		other[i] = own[i];
+		if ((own[i] == NORMAL_TIME) && !los) other[i] = MAX_TIME_SCALE;
+
+		/* Start out alone */
+		chain[i] = i;
+		slowest[i] = second[i] = MAX_TIME_SCALE;
+		slowest_who[i] = 0;
+	}
+
+	/* Join everyone within our range */
+	for (i = 1; i <= NumPlayers; i++)
+	{
+		p_ptr = Players[i];
+		for (j = i + 1; j <= NumPlayers; j++)
 		{
+			q_ptr = Players[j];
+
 			/* Skip him if he's on a different dungeon level */
 			if (q_ptr->dun_depth != p_ptr->dun_depth) continue;
-			
+
 			/* How far away is he? */
 			dist = distance(p_ptr->py, p_ptr->px, q_ptr->py, q_ptr->px);
-			
+
 			/* Skip him if he's too far away */
-			if(dist > MAX_SIGHT) continue;
-			
-			/* Find the slowest time bubble chain we are part of */
-			slowest = base_time_factor(q_ptr, timefactor);
-			
-			/* Use the slowest time bubble */
-			if(slowest < timefactor) timefactor = slowest;
+			if (dist > MAX_SIGHT) continue;
+
+			/* Same chain */
+			chain[bubble_find(chain, j)] = bubble_find(chain, i);
 		}
-	}		
-		
-	return timefactor;
+	}
+
+	/* Find the two slowest bubbles of each chain */
+	for (i = 1; i <= NumPlayers; i++)
+	{
+		r = bubble_find(chain, i);
+		if (other[i] < slowest[r])
+		{
+			second[r] = slowest[r];
+			slowest[r] = other[i];
+			slowest_who[r] = i;
+		}
+		else if (other[i] < second[r]) second[r] = other[i];
+	}
+
+	/* Use the slowest time bubble of everyone else in our chain */
+	for (i = 1; i <= NumPlayers; i++)
+	{
+		p_ptr = Players[i];
+		r = bubble_find(chain, i);
+		dist = (slowest_who[r] == i) ? second[r] : slowest[r];
+		p_ptr->bubble_factor = MIN(own[i], dist);
+		p_ptr->bubble_turn = turn;
+	}
+}
+
+/* Return the time factor of a given players "time bubble" chain for this
+ * turn, working it out if it wasn't yet (e.g. for a player who just joined).
+ */
+int base_time_factor(player_type *p_ptr)
+{
+	if (!ht_eq(&p_ptr->bubble_turn, &turn)) update_time_bubbles();
+
+	return p_ptr->bubble_factor;
 }
 
 /*
@@ -5263,7 +5315,7 @@ int time_factor(player_type *p_ptr)
 
 
 	/* Determine our time scaling factor */
-	timefactor = base_time_factor(p_ptr, 0);
+	timefactor = base_time_factor(p_ptr);
 	
 	/* Scale our time by our bubbles time factor */
 	scale = scale * ((float)timefactor / 100);
@@ -7172,14 +7224,22 @@ void master_new_hook_aux(player_type *p_ptr, byte hook_type, s16b oy, s16b ox)
 		{
 			vault_type *v_ptr = &v_info[p_ptr->master_args[hook_type]];
 			if (dm_flag_p(p_ptr, CAN_GENERATE))
-			build_vault(Depth, oy, ox, v_ptr->hgt, v_ptr->wid, v_text + v_ptr->text);
+			{
+				build_vault(Depth, oy, ox, v_ptr->hgt, v_ptr->wid, v_text + v_ptr->text);
+
+				/* The vault was built wall by wall */
+				forget_walls(Depth);
+			}
 			break;
 		}
 		case DM_PAGE_FEATURE:
 		{
 			cave_type *c_ptr = &cave[Depth][oy][ox];
 			if (dm_flag_p(p_ptr, CAN_BUILD))
-			c_ptr->feat = (byte)p_ptr->master_args[hook_type];
+			{
+				c_ptr->feat = (byte)p_ptr->master_args[hook_type];
+				update_wall_spot(Depth, oy, ox);
+			}
 			break;
 		}	
 		case DM_PAGE_MONSTER: